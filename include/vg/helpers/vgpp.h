@@ -32,6 +32,14 @@ public:
 
 	void BeginFrame(uint32_t canvasWidth, uint32_t canvasHeight, float devicePixelRatio);
 	void EndFrame();
+	void ResubmitFrame(uint16_t viewID, const float* viewMtx, const float* projMtx);
+	void TrimMemory();
+#if VG_CONFIG_RECORD_DRAW_CALLS
+	void SetDrawCallCallback(DrawCallCallback callback, void* userData);
+#endif
+#if VG_CONFIG_SOFTWARE_RASTERIZER
+	void SetRasterTarget(const RasterTarget* target, uint32_t numThreads);
+#endif
 
 	void BeginPath();
 	void MoveTo(float x, float y);
@@ -110,6 +118,8 @@ struct Shape
 	~Shape();
 
 	void Reset();
+	void Reserve(uint32_t cmdBytes, uint32_t stringBytes);
+	void ShrinkToFit();
 
 	void BeginPath();
 	void MoveTo(float x, float y);
@@ -193,6 +203,30 @@ inline void Renderer::EndFrame()
 	endFrame(m_Context);
 }
 
+inline void Renderer::ResubmitFrame(uint16_t viewID, const float* viewMtx, const float* projMtx)
+{
+	resubmitFrame(m_Context, viewID, viewMtx, projMtx);
+}
+
+inline void Renderer::TrimMemory()
+{
+	trimMemory(m_Context);
+}
+
+#if VG_CONFIG_RECORD_DRAW_CALLS
+inline void Renderer::SetDrawCallCallback(DrawCallCallback callback, void* userData)
+{
+	setDrawCallCallback(m_Context, callback, userData);
+}
+#endif
+
+#if VG_CONFIG_SOFTWARE_RASTERIZER
+inline void Renderer::SetRasterTarget(const RasterTarget* target, uint32_t numThreads)
+{
+	setRasterTarget(m_Context, target, numThreads);
+}
+#endif
+
 inline void Renderer::BeginPath()
 {
 	beginPath(m_Context);
@@ -503,6 +537,16 @@ inline void Shape::Reset()
 	clReset(m_CommandListRef);
 }
 
+inline void Shape::Reserve(uint32_t cmdBytes, uint32_t stringBytes)
+{
+	reserveCommandList(m_CommandListRef.m_Context, m_CommandListRef.m_Handle, cmdBytes, stringBytes);
+}
+
+inline void Shape::ShrinkToFit()
+{
+	shrinkCommandList(m_CommandListRef.m_Context, m_CommandListRef.m_Handle);
+}
+
 inline void Shape::BeginPath()
 {
 	clBeginPath(m_CommandListRef);
@@ -28,6 +28,59 @@
 #	define VG_CONFIG_UV_INT16 1
 #endif
 
+// If set to 1, vertex buffers are allocated directly from bgfx transient vertex buffers (and the index
+// buffer is copied into a transient index buffer in end()), instead of going through the pooled arrays and
+// bgfx dynamic buffers. Useful when the whole frame is rebuilt every time. begin() and end() must be called
+// within the same bgfx frame. If there isn't enough transient buffer space, the pooled arrays are used.
+#ifndef VG_CONFIG_TRANSIENT_BUFFERS
+#	define VG_CONFIG_TRANSIENT_BUFFERS 0
+#endif
+
+// If set to 1, the cached meshes of CommandListFlags::Cacheable command lists are uploaded once into static
+// bgfx buffers. Submitting a cached command list then issues one draw call per cached fill/stroke using the
+// current transform as the model matrix, instead of transforming and copying all cached vertices into the
+// frame's vertex buffer. Cached commands submitted inside beginClip()/endClip() still use the CPU path.
+// Requires VG_CONFIG_ENABLE_SHAPE_CACHING.
+#ifndef VG_CONFIG_STATIC_CACHED_GEOMETRY
+#	define VG_CONFIG_STATIC_CACHED_GEOMETRY 0
+#endif
+
+// If set to 1, fills, strokes, indexedTriList() and text are clipped against the scissor rect on the CPU
+// (interpolating positions, UVs and colors) instead of using a hardware scissor per draw call. This way
+// scissor changes (e.g. intersectScissor() for each item of a scrollable list) don't split draw commands.
+// Text uses the hardware scissor if the transform isn't axis-aligned. Clip masks (beginClip()/endClip())
+// and cached command lists in VG_CONFIG_STATIC_CACHED_GEOMETRY mode always use the hardware scissor.
+#ifndef VG_CONFIG_SOFTWARE_SCISSOR
+#	define VG_CONFIG_SOFTWARE_SCISSOR 0
+#endif
+
+// If set to 1, the index buffers submitted to bgfx use 32-bit indices and ContextConfig::m_MaxVBVertices
+// can be larger than 65536 (fewer vertex buffer splits and draw calls for large frames). Meshes generated
+// by the stroker and indexedTriList() indices remain uint16_t.
+#ifndef VG_CONFIG_UINT32_INDICES
+#	define VG_CONFIG_UINT32_INDICES 0
+#endif
+
+// If set to 1, linear gradients are rendered with the textured program using a per-frame gradient ramp
+// image (one row per gradient, indexed by the per-vertex UVs) instead of per-draw uniforms. Consecutive
+// linear gradient fills/strokes can then be merged into a single draw call. Box and radial gradients
+// always use the color gradient program. The ramp image doesn't count against ContextConfig::m_MaxImages.
+// With VG_CONFIG_UV_INT16 the ramp coordinate (0.25 + 0.5 * t) must stay in [-1, 1], so only meshes whose
+// vertices lie within 2.5 gradient lengths before the start point and 0.5 gradient lengths after the end
+// point are batched. The rest use the color gradient program.
+#ifndef VG_CONFIG_BATCH_LINEAR_GRADIENTS
+#	define VG_CONFIG_BATCH_LINEAR_GRADIENTS 1
+#endif
+
+// If set to 1, image pattern texture coordinates are calculated on the CPU and the meshes are rendered
+// with the textured program, so fills/strokes with different patterns of the same image can be merged
+// into a single draw call. With VG_CONFIG_UV_INT16 the UVs of each mesh must fit in [-1, 1]. For images
+// which repeat (no Clamp_U/Clamp_V) the UVs are shifted by whole periods first, so meshes covering up to
+// one repetition per axis are batched too. The rest use the image pattern program.
+#ifndef VG_CONFIG_BATCH_IMAGE_PATTERNS
+#	define VG_CONFIG_BATCH_IMAGE_PATTERNS 1
+#endif
+
 // If set to 1, submitCommandList() calls pustState()/popState() and resetClip() before and after
 // executing the commands. Otherwise, the state produced by the command list will affect the global
 // state after the execution of the commands.
@@ -35,6 +88,53 @@
 #	define VG_CONFIG_COMMAND_LIST_PRESERVE_STATE 0
 #endif
 
+// If set to 1, submitCommandList() compares the commands of lists without the CommandListFlags::Cacheable
+// flag with a copy from the previous submit and, if they haven't changed, caches and replays their geometry
+// as if the flag was set (i.e. unchanged lists which are reset and rebuilt every frame aren't retesselated).
+// Each such list keeps a copy of its command and string buffers for the comparison. Lists containing
+// setGlobalAlpha() commands, or submitted with a global alpha other than 1, aren't cached.
+// Like Cacheable lists, auto-cached lists ignore CommandListFlags::AllowCommandCulling.
+// Requires VG_CONFIG_ENABLE_SHAPE_CACHING.
+#ifndef VG_CONFIG_COMMAND_LIST_AUTO_CACHING
+#	define VG_CONFIG_COMMAND_LIST_AUTO_CACHING 0
+#endif
+
+// If set to 1, setDrawCallCallback() can be used to receive a copy of every draw call submitted to bgfx
+// by end() and resubmitFrame() (program, state, stencil, scissor, buffer ranges and uniforms). Combined
+// with bgfx's Noop renderer, it allows measuring draw call counts and batching quality without a GPU.
+#ifndef VG_CONFIG_RECORD_DRAW_CALLS
+#	define VG_CONFIG_RECORD_DRAW_CALLS 0
+#endif
+
+// If set to 1, setRasterTarget() can be used to also rasterize each frame on the CPU into an RGBA8 buffer
+// (e.g. thumbnails on machines without a GPU, combined with bgfx's Noop renderer). Images keep a CPU copy
+// of their texels. Cannot be combined with VG_CONFIG_STATIC_CACHED_GEOMETRY.
+#ifndef VG_CONFIG_SOFTWARE_RASTERIZER
+#	define VG_CONFIG_SOFTWARE_RASTERIZER 0
+#endif
+
+// If set to 1, command lists use 4-byte command headers (8-bit command type and 24-bit data size) and
+// 4-byte alignment, instead of 8-byte headers and 16-byte alignment. E.g. a lineTo() takes 12 bytes
+// instead of 32.
+#ifndef VG_CONFIG_COMPACT_COMMAND_LISTS
+#	define VG_CONFIG_COMPACT_COMMAND_LISTS 0
+#endif
+
+// If not 0, the coordinates of moveTo()/lineTo()/cubicTo()/quadraticTo()/polyline() commands recorded into
+// command lists are stored as int16 fixed point numbers with this many fractional bits (e.g. 4 for 1/16 of a
+// unit, limiting coordinates to +/-2048). Commands with coordinates outside that range are stored as floats.
+// Reduces the memory of path commands by half, and combined with VG_CONFIG_COMPACT_COMMAND_LISTS a lineTo()
+// takes 8 bytes.
+#ifndef VG_CONFIG_COMMAND_LIST_FIXED_POINT_BITS
+#	define VG_CONFIG_COMMAND_LIST_FIXED_POINT_BITS 0
+#endif
+
+// If set to 1, the time spent building paths, filling, stroking, rendering text and in end() is measured
+// with bx::getHPCounter() and reported by getStats() (Stats::m_XXXTime). Otherwise the times are always 0.
+#ifndef VG_CONFIG_ENABLE_TIMINGS
+#	define VG_CONFIG_ENABLE_TIMINGS 0
+#endif
+
 // NOTE: beginCommandList()/endCommandList() blocks require an indirect jump for each function/path command,
 // because they change the Context' vtable. If this is set to 0, all functions call their implementation 
 // directly (i.e. there will probably still be a jump there but it'll be unconditional/direct).
@@ -310,6 +410,12 @@ typedef int16_t uv_t;
 typedef float uv_t;
 #endif
 
+#if VG_CONFIG_UINT32_INDICES
+typedef uint32_t index_t;
+#else
+typedef uint16_t index_t;
+#endif
+
 VG_HANDLE32(GradientHandle);
 VG_HANDLE32(ImagePatternHandle);
 VG_HANDLE(ImageHandle);
@@ -330,16 +436,54 @@ struct ContextConfig
 	uint16_t m_MaxStateStackSize;   // default: 32
 	uint16_t m_MaxImages;           // default: 16
 	uint16_t m_MaxCommandLists;     // default: 256
-	uint32_t m_MaxVBVertices;       // default: 65536
+	uint32_t m_MaxVBVertices;       // default: 65536 (max 65536 unless VG_CONFIG_UINT32_INDICES is 1)
 	uint32_t m_FontAtlasImageFlags; // default: ImageFlags::Filter_Bilinear
 	uint32_t m_MaxCommandListDepth; // default: 16
 	bool m_ResetViewTransformOnEnd; // default: true
+	bool m_ReorderDrawCommands;     // default: false; merge non-overlapping draw commands with compatible earlier ones in end()
+	uint32_t m_MaxPoolIdleFrames;   // default: 120; pooled vertex buffers unused for that many frames are freed (0 = never)
+	uint32_t m_CommandListCacheBudget; // default: 0 (unlimited); bytes of all command list caches before begin() evicts the least recently used ones
 };
 
+// NOTE: Command list memory is accounted for when the command list is submitted, reset or destroyed.
+// Commands recorded after the last submitCommandList() call aren't included.
 struct Stats
 {
 	uint32_t m_CmdListMemoryTotal;
 	uint32_t m_CmdListMemoryUsed;
+	uint32_t m_NumPooledVertexStreams;     // Position/color/UV buffers allocated by the vertex data pools
+	uint32_t m_NumPooledVertexStreamsUsed; // Pooled vertex streams not yet released by bgfx
+	uint32_t m_NumPooledIndexBuffers;
+	uint32_t m_NumPooledIndexBuffersUsed;
+	uint32_t m_PooledVertexMemory;         // Bytes allocated by the vertex data pools
+	uint32_t m_PeakPooledVertexMemory;     // Max m_PooledVertexMemory since createContext()
+	uint32_t m_FrameArenaSize;             // Bytes allocated by the per-frame arena (draw commands and scratch buffers)
+	uint32_t m_FrameArenaUsed;             // Bytes of the frame arena used since begin()
+	uint32_t m_CmdListCacheMemory;         // Bytes held by the caches of command lists (see ContextConfig::m_CommandListCacheBudget)
+	uint32_t m_CmdListCacheMemoryEvicted;  // Bytes freed by cache evictions since createContext()
+	uint32_t m_NumCulledPaths;     // Fills/strokes skipped because they were outside the scissor rect (reset in begin())
+
+	// The following are reset in begin(). Draw calls include resubmitFrame().
+	uint32_t m_NumDrawCalls;       // Textured/gradient/image pattern draw calls submitted to bgfx
+	uint32_t m_NumClipDrawCalls;   // Stencil (clip mask and stencil clear) draw calls submitted to bgfx
+	uint32_t m_NumVertices;        // Vertices uploaded by end()
+	uint32_t m_NumIndices;         // Indices uploaded by end()
+	uint32_t m_NumVertexBuffers;   // Vertex buffers used by the frame
+	uint32_t m_NumFlattenedPaths;  // Paths transformed and tesselated by fills/strokes
+	uint32_t m_NumConcaveFills;    // Fills triangulated with libtess2
+	uint32_t m_NumCacheHits;       // Command list submits which replayed cached geometry
+	uint32_t m_NumCacheMisses;     // Command list caches rebuilt by submitCommandList() or tesselateCommandList()
+	uint32_t m_NumGlyphsBaked;     // Glyph bitmaps rasterized into the font atlas
+	uint32_t m_NumAtlasUploads;    // Font atlas texture updates
+	uint32_t m_NumAtlasResets;     // Font atlases filled up and replaced by a new one
+
+	// Milliseconds since begin() (see VG_CONFIG_ENABLE_TIMINGS)
+	float m_PathTime;              // beginPath() ... closePath()
+	float m_FillTime;              // fillPath()
+	float m_StrokeTime;            // strokePath()
+	float m_TextTime;              // text()/textBox() (incl. glyph baking)
+	float m_EndTime;               // end()
+	float m_RasterTime;            // Rasterization of the frame by end() (see setRasterTarget()); 1000 / m_RasterTime = images per second
 };
 
 struct TextConfig
@@ -396,7 +540,52 @@ struct FontFlags
 	};
 };
 
+#if VG_CONFIG_RECORD_DRAW_CALLS
+struct DrawCall
+{
+	struct Program
+	{
+		enum Enum : uint32_t
+		{
+			Textured = 0,
+			ColorGradient,
+			ImagePattern,
+			Stencil, // Clip mask or stencil clear quad
+		};
+	};
+
+	Program::Enum m_Program;
+	uint64_t m_State;                // BGFX_STATE_XXX
+	uint32_t m_Stencil;              // BGFX_STENCIL_XXX (front and back)
+	uint16_t m_ViewID;
+	uint16_t m_ScissorRect[4];       // { x, y, w, h } in canvas coordinates; all 0 => no scissor
+	uint16_t m_ImageHandle;          // Textured and ImagePattern draw calls; UINT16_MAX otherwise
+	uint32_t m_VertexBufferID;       // Index of the frame's vertex buffer (pooled or transient); UINT32_MAX for static cached geometry and stencil clear quads
+	uint32_t m_FirstVertexID;
+	uint32_t m_NumVertices;
+	uint32_t m_FirstIndexID;
+	uint32_t m_NumIndices;
+	float m_PaintMatrix[9];          // ColorGradient and ImagePattern draw calls
+	float m_ExtentRadiusFeather[4];  // ColorGradient draw calls
+	float m_InnerColor[4];           // ColorGradient draw calls
+	float m_OuterColor[4];           // ColorGradient draw calls
+};
+
+typedef void (*DrawCallCallback)(const DrawCall* drawCall, void* userData);
+#endif
+
+#if VG_CONFIG_SOFTWARE_RASTERIZER
+struct RasterTarget
+{
+	uint8_t* m_Data;  // RGBA8
+	uint32_t m_Pitch; // Bytes per row
+	uint16_t m_Width;
+	uint16_t m_Height;
+};
+#endif
+
 struct Context;
+struct Tesselator;
 
 // Context
 Context* createContext(bx::AllocatorI* allocator, const ContextConfig* cfg = nullptr);
@@ -405,7 +594,28 @@ void destroyContext(Context* ctx);
 void begin(Context* ctx, uint16_t viewID, uint16_t canvasWidth, uint16_t canvasHeight, float devicePixelRatio);
 void end(Context* ctx);
 void frame(Context* ctx);
+
+// Submits the draw commands generated by the last begin()/end() block to another view, reusing the
+// GPU buffers uploaded by end() (no retesselation or reupload). Must be called after end() and before
+// the next frame() or begin(), within the same bgfx frame. viewMtx and projMtx are passed to bgfx::setViewTransform()
+// (the view's transform is left unchanged if both are nullptr). Scissor rects are set in the original
+// canvas' pixels and aren't affected by the view transform. The view should clear its stencil buffer
+// if the frame uses clip masks.
+void resubmitFrame(Context* ctx, uint16_t viewID, const float* viewMtx, const float* projMtx);
+
 const Stats* getStats(Context* ctx);
+// Frees all pooled vertex and index memory which isn't used by the current frame or still referenced by bgfx.
+// Pools grow back on demand. Unused pooled vertex buffers are also freed automatically (see ContextConfig::m_MaxPoolIdleFrames).
+void trimMemory(Context* ctx);
+#if VG_CONFIG_RECORD_DRAW_CALLS
+void setDrawCallCallback(Context* ctx, DrawCallCallback callback, void* userData);
+#endif
+#if VG_CONFIG_SOFTWARE_RASTERIZER
+// The draw commands of every following end() are blended over the contents of target (canvas size * device
+// pixel ratio, not cleared by vg) before end() returns, using numThreads threads (including the calling one).
+// Images created from external bgfx textures are sampled as opaque white. Pass nullptr to disable.
+void setRasterTarget(Context* ctx, const RasterTarget* target, uint32_t numThreads);
+#endif
 
 void beginPath(Context* ctx);
 void moveTo(Context* ctx, float x, float y);
@@ -483,15 +693,43 @@ bool destroyImage(Context* ctx, ImageHandle img);
 bool isImageValid(Context* ctx, ImageHandle img);
 
 // Command lists
+// Threading: clXXX() functions only touch the command list passed to them, so different
+// command lists can be recorded concurrently from multiple threads without any locking (one
+// thread per command list). The allocator passed to createContext() must be thread-safe
+// in this case. All other functions, including createCommandList(), destroyCommandList(),
+// resetCommandList(), submitCommandList() and beginCommandList()/endCommandList(), must be
+// called from the thread which owns the context, while no other thread records into the
+// command list(s) involved. With VG_CONFIG_DEBUG, overlapping writes to the same command list
+// are reported via VG_CHECK. See README.md for an example.
 CommandListHandle createCommandList(Context* ctx, uint32_t flags);
 void destroyCommandList(Context* ctx, CommandListHandle handle);
 void resetCommandList(Context* ctx, CommandListHandle handle);
+// Command and string buffers grow geometrically while recording. reserveCommandList() preallocates room
+// for cmdBytes/stringBytes bytes (e.g. before recording a list of known size) and shrinkCommandList() frees
+// the unused part of both buffers of a list which has been completely recorded.
+void reserveCommandList(Context* ctx, CommandListHandle handle, uint32_t cmdBytes, uint32_t stringBytes);
+void shrinkCommandList(Context* ctx, CommandListHandle handle);
 void submitCommandList(Context* ctx, CommandListHandle handle);
 #if VG_CONFIG_COMMAND_LIST_BEGIN_END_API
 void beginCommandList(Context* ctx, CommandListHandle handle);
 void endCommandList(Context* ctx);
 #endif
 
+#if VG_CONFIG_ENABLE_SHAPE_CACHING
+// Parallel tesselation of CommandListFlags::Cacheable command lists.
+// tesselateCommandList() builds the cache of the command list for the specified transform (i.e. the
+// transform the command list will be submitted with) without generating any draw commands. The next
+// submitCommandList() with the same scale only transforms and copies the cached geometry, in submission
+// order. Use one Tesselator per thread. Different command lists can be tesselated concurrently, but
+// not while they are being recorded or submitted, or while begin() is executing (it might change the
+// canvas size). Cacheable child command lists are tesselated along with their parent. Work done by
+// tesselateCommandList() shows up in Stats after the next submitCommandList(). Returns false if the
+// command list isn't cacheable.
+Tesselator* createTesselator(Context* ctx);
+void destroyTesselator(Context* ctx, Tesselator* tess);
+bool tesselateCommandList(Context* ctx, Tesselator* tess, CommandListHandle handle, const float* mtx);
+#endif
+
 void clBeginPath(Context* ctx, CommandListHandle handle);
 void clMoveTo(Context* ctx, CommandListHandle handle, float x, float y);
 void clLineTo(Context* ctx, CommandListHandle handle, float x, float y);
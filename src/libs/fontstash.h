@@ -225,6 +225,7 @@ int fonsTextIterNext(FONScontext* stash, FONStextIter* iter, struct FONSquad* qu
 // Pull texture changes
 const unsigned char* fonsGetTextureData(FONScontext* stash, int* width, int* height);
 int fonsValidateTexture(FONScontext* s, int* dirty);
+int fonsGetNumRenderedGlyphs(FONScontext* s);
 
 // Strings
 void fonsInitString(FONSstring* str);
@@ -766,6 +767,7 @@ struct FONScontext
 	void (*handleError)(void* uptr, int error, int val);
 	void* errorUptr;
 	int atlasID; // JD: Counts how many times the atlas has been reset. Used for FONSstring baking.
+	int nrenderedGlyphs; // Counts how many glyph bitmaps have been rasterized into the atlas.
 };
 
 #if 0 // defined(STB_TRUETYPE_IMPLEMENTATION)
@@ -1505,6 +1507,7 @@ static FONSglyph* fons__getGlyph(FONScontext* stash, FONSfont* font, unsigned in
 	// Rasterize
 	dst = &stash->texData[(glyph->x0+pad) + (glyph->y0+pad) * stash->params.width];
 	fons__tt_renderGlyphBitmap(&renderFont->font, dst, gw-pad*2,gh-pad*2, stash->params.width, scale,scale, g);
+	stash->nrenderedGlyphs++;
 
 	// Make sure there is one pixel empty border.
 	dst = &stash->texData[glyph->x0 + glyph->y0 * stash->params.width];
@@ -2010,6 +2013,11 @@ int fonsValidateTexture(FONScontext* stash, int* dirty)
 	return 0;
 }
 
+int fonsGetNumRenderedGlyphs(FONScontext* stash)
+{
+	return stash->nrenderedGlyphs;
+}
+
 void fonsDeleteInternal(FONScontext* stash)
 {
 	int i;
@@ -2334,6 +2342,7 @@ static FONSglyph* fons__bakeGlyph(FONScontext* stash, FONSfont* font, int ascii_
 	// Rasterize
 	unsigned char* dst = &stash->texData[(glyph->x0 + pad) + (glyph->y0 + pad) * stash->params.width];
 	fons__tt_renderGlyphBitmap(&renderFont->font, dst, gw - pad * 2, gh - pad * 2, stash->params.width, scale, scale, ascii_to_glyph_index);
+	stash->nrenderedGlyphs++;
 
 	// Make sure there is one pixel empty border.
 	dst = &stash->texData[glyph->x0 + glyph->y0 * stash->params.width];
@@ -1,7 +1,4 @@
 // TODO:
-// - More than 254 clip regions: Either use another view (extra parameter in createContext)
-// or draw a fullscreen quad to reset the stencil buffer to 0.
-// - Recycle the memory of cached meshes so resetting a cached mesh is faster.
 // - Find a way to move stroker operations into separate functions (i.e. all strokePath 
 // functions differ only on the createDrawCommand_XXX() call; strokerXXX calls are the same
 // and the code is duplicated).
@@ -12,11 +9,16 @@
 #include <vg/path.h>
 #include <vg/stroker.h>
 #include "vg_util.h"
+#include "vg_raster.h"
 #include "libs/fontstash.h"
 #include <bx/allocator.h>
-#include <bx/mutex.h>
 #include <bx/handlealloc.h>
+#include <bx/hash.h>
 #include <bx/string.h>
+#include <bx/cpu.h>
+#if VG_CONFIG_ENABLE_TIMINGS
+#include <bx/timer.h>
+#endif
 #include <bgfx/bgfx.h>
 #include <bgfx/embedded_shader.h>
 
@@ -32,17 +34,61 @@
 
 BX_PRAGMA_DIAGNOSTIC_IGNORED_MSVC(4706) // assignment within conditional expression
 
+#if VG_CONFIG_STATIC_CACHED_GEOMETRY && !VG_CONFIG_ENABLE_SHAPE_CACHING
+#	error "VG_CONFIG_STATIC_CACHED_GEOMETRY requires VG_CONFIG_ENABLE_SHAPE_CACHING"
+#endif
+
+#if VG_CONFIG_COMMAND_LIST_AUTO_CACHING && !VG_CONFIG_ENABLE_SHAPE_CACHING
+#	error "VG_CONFIG_COMMAND_LIST_AUTO_CACHING requires VG_CONFIG_ENABLE_SHAPE_CACHING"
+#endif
+
+#if VG_CONFIG_SOFTWARE_RASTERIZER && VG_CONFIG_STATIC_CACHED_GEOMETRY
+#	error "VG_CONFIG_SOFTWARE_RASTERIZER cannot rasterize static cached geometry (no CPU copy)"
+#endif
+
 #define VG_CONFIG_MIN_FONT_SCALE                 0.1f
 #define VG_CONFIG_MAX_FONT_SCALE                 4.0f
 #define VG_CONFIG_MAX_FONT_IMAGES                4
 #define VG_CONFIG_MIN_FONT_ATLAS_SIZE            512
 #define VG_CONFIG_COMMAND_LIST_CACHE_STACK_SIZE  32
-#define VG_CONFIG_COMMAND_LIST_ALIGNMENT         16
+#if VG_CONFIG_COMPACT_COMMAND_LISTS
+#	define VG_CONFIG_COMMAND_LIST_ALIGNMENT      4
+#else
+#	define VG_CONFIG_COMMAND_LIST_ALIGNMENT      16
+#endif
+
+// Maximum number of draw command batches a draw command can be moved over while
+// trying to merge it with an earlier one (see ContextConfig::m_ReorderDrawCommands)
+#define VG_CONFIG_DRAW_COMMAND_REORDER_DISTANCE  16
+
+// Vertex buffers start with room for VG_CONFIG_MIN_VB_VERTICES vertices and double their
+// capacity (up to ContextConfig::m_MaxVBVertices) when they fill up. Each size class has
+// its own data pools.
+#define VG_CONFIG_MIN_VB_VERTICES                1024
+#define VG_CONFIG_MAX_VB_SIZE_CLASSES            16
+
+// Granularity (in bytes) of the memory blocks allocated by linear arenas (e.g. the per-frame
+// arena used for draw commands and scratch buffers)
+#define VG_CONFIG_ARENA_CHUNK_SIZE               (64 << 10)
+
+// Images created by the context for its own use (the gradient ramp), in addition to
+// ContextConfig::m_MaxImages
+#if VG_CONFIG_BATCH_LINEAR_GRADIENTS
+#	define VG_CONFIG_NUM_INTERNAL_IMAGES         1
+#else
+#	define VG_CONFIG_NUM_INTERNAL_IMAGES         0
+#endif
 
 // Minimum font size (after scaling with the current transformation matrix),
 // below which no text will be rendered.
 #define VG_CONFIG_MIN_FONT_SIZE              4.0f
 
+#if VG_CONFIG_ENABLE_TIMINGS
+#	define VG_SCOPED_TIMER(ctx, timer) ScopedTimer scopedTimer(&(ctx)->m_TimerTicks[timer])
+#else
+#	define VG_SCOPED_TIMER(ctx, timer) BX_NOOP()
+#endif
+
 namespace vg
 {
 static const bgfx::EmbeddedShader s_EmbeddedShaders[] =
@@ -89,6 +135,9 @@ struct Gradient
 	float m_Params[4]; // {Extent.x, Extent.y, Radius, Feather}
 	float m_InnerColor[4];
 	float m_OuterColor[4];
+#if VG_CONFIG_BATCH_LINEAR_GRADIENTS
+	bool m_IsLinear;
+#endif
 };
 
 struct ImagePattern
@@ -120,6 +169,15 @@ struct DrawCommand
 		};
 	};
 
+	struct StencilFlags
+	{
+		enum Enum : uint8_t
+		{
+			WriteClipMask = 1 << 0, // Render the clip commands into the stencil buffer before this command
+			Clear = 1 << 1,         // Reset the stencil buffer to 0 first (all stencil values are in use)
+		};
+	};
+
 	Type::Enum m_Type;
 	ClipState m_ClipState;
 	uint32_t m_VertexBufferID;
@@ -129,6 +187,18 @@ struct DrawCommand
 	uint32_t m_NumIndices;
 	uint16_t m_ScissorRect[4];
 	uint16_t m_HandleID; // Type::Textured => ImageHandle, Type::ColorGradient => GradientHandle, Type::ImagePattern => ImagePatternHandle
+	uint8_t m_StencilValue; // Stencil reference value of the clip state (0 => no clip state); assigned in end() by assignStencilValues()
+	uint8_t m_StencilFlags; // StencilFlags::XXX
+
+#if VG_CONFIG_STATIC_CACHED_GEOMETRY
+	// Valid only for draw commands of cached command lists (see submitCachedCommand()). The vertex/index ranges
+	// refer to these buffers instead of the frame's buffers, and the vertices are transformed by m_TransformMtx.
+	bgfx::VertexBufferHandle m_StaticPosBufferHandle;
+	bgfx::VertexBufferHandle m_StaticUVBufferHandle;
+	bgfx::VertexBufferHandle m_StaticColorBufferHandle;
+	bgfx::IndexBufferHandle m_StaticIndexBufferHandle;
+	float m_TransformMtx[6];
+#endif
 };
 
 struct GPUVertexBuffer
@@ -149,13 +219,70 @@ struct VertexBuffer
 	uv_t* m_UV;
 	uint32_t* m_Color;
 	uint32_t m_Count;
+	uint32_t m_Capacity;
+	uint8_t m_SizeClass; // Index of the data pools the streams have been allocated from
+#if VG_CONFIG_TRANSIENT_BUFFERS
+	bgfx::TransientVertexBuffer m_TransientPos;
+	bgfx::TransientVertexBuffer m_TransientUV;
+	bgfx::TransientVertexBuffer m_TransientColor;
+	bool m_IsTransient; // m_Pos/m_UV/m_Color point to the transient buffers' memory
+#endif
+};
+
+// Lock-free stack of released buffers (multiple producers, single consumer). Nodes are linked through
+// their first 8 bytes. Only the Context's thread pops, and it always takes the whole stack, so there's
+// no ABA problem.
+struct ReleasedList
+{
+	volatile uint64_t m_Head; // Address of the first node
+};
+
+// Fixed size vertex stream buffers. Buffers are allocated, reused and freed on the Context's thread, and
+// released from any thread (bgfx calls the makeRef() release callbacks on the render thread).
+struct DataPool
+{
+	void** m_Buffers;        // All buffers owned by the pool (Context's thread only)
+	uint32_t m_NumBuffers;
+	uint32_t m_Capacity;
+	uint32_t m_BufferSize;   // In bytes
+	void* m_FreeList;        // Context's thread only
+	ReleasedList m_Released;
+	volatile int32_t m_NumUsed;
+	uint32_t m_HighWater;    // Max m_NumUsed during the current frame
+	uint32_t m_WindowHighWater; // Max m_HighWater of the current idle window
+	uint32_t m_IdleFrames;   // Consecutive frames m_HighWater stayed below m_NumBuffers
+};
+
+// Linear allocator. Allocations cannot be freed individually; arenaReset() rewinds the whole arena.
+struct ArenaChunk
+{
+	ArenaChunk* m_Next; // Previously filled chunk
+	uint32_t m_Size;    // Usable bytes after the header
+	uint32_t m_Pos;
+};
+
+struct Arena
+{
+	ArenaChunk* m_Chunk;  // The chunk new allocations are made from
+	uint8_t* m_LastAlloc; // Can be grown in place by arenaRealloc()
+	uint32_t m_Size;      // Usable bytes in all chunks
+	uint32_t m_Used;      // Bytes allocated since the last reset
+};
+
+// Stable (never reallocated) part of an index buffer, passed to the bgfx release callback.
+struct IndexBufferNode
+{
+	uint64_t m_Next; // ReleasedList link
+	Context* m_Context;
+	uint16_t m_ID;
 };
 
 struct IndexBuffer
 {
-	uint16_t* m_Indices;
+	index_t* m_Indices;
 	uint32_t m_Count;
 	uint32_t m_Capacity;
+	IndexBufferNode* m_Node;
 };
 
 struct Image
@@ -165,6 +292,9 @@ struct Image
 	uint32_t m_Flags;
 	bgfx::TextureHandle m_bgfxHandle;
 	bool m_Owned;
+#if VG_CONFIG_SOFTWARE_RASTERIZER
+	uint32_t* m_RasterData; // CPU copy of the texture's RGBA8 texels (nullptr for external bgfx textures)
+#endif
 };
 
 struct FontData
@@ -192,6 +322,11 @@ struct CommandType
 		Circle,
 		Ellipse,
 		Polyline,
+		MoveToFixed,      // Coordinates in int16 fixed point (see VG_CONFIG_COMMAND_LIST_FIXED_POINT_BITS)
+		LineToFixed,
+		CubicToFixed,
+		QuadraticToFixed,
+		PolylineFixed,
 		ClosePath,
 		FirstPathCommand = BeginPath,
 		LastPathCommand = ClosePath,
@@ -240,11 +375,18 @@ struct CommandType
 	};
 };
 
+#if VG_CONFIG_COMPACT_COMMAND_LISTS
+// Compact command headers are a single uint32_t, with the command type in the low 8 bits and the
+// data size in the high 24 bits. Larger commands store kCompactCommandSizeEscape in the size bits
+// and their data size in the following uint32_t.
+static const uint32_t kCompactCommandSizeEscape = 0x00FFFFFF;
+#else
 struct CommandHeader
 {
 	CommandType::Enum m_Type;
 	uint32_t m_Size;
 };
+#endif
 
 struct CachedMesh
 {
@@ -253,6 +395,9 @@ struct CachedMesh
 	uint16_t* m_Indices;
 	uint32_t m_NumVertices;
 	uint32_t m_NumIndices;
+#if VG_CONFIG_STATIC_CACHED_GEOMETRY
+	uint32_t m_Color; // Color of all vertices if m_Colors is nullptr
+#endif
 };
 
 struct CachedCommand
@@ -260,15 +405,56 @@ struct CachedCommand
 	uint16_t m_FirstMeshID;
 	uint16_t m_NumMeshes;
 	float m_InvTransformMtx[6];
+#if VG_CONFIG_STATIC_CACHED_GEOMETRY
+	// Range of the command's meshes in the CachedGeometry buffers. Indices are relative to m_FirstVertexID.
+	uint32_t m_FirstVertexID;
+	uint32_t m_NumVertices;
+	uint32_t m_FirstIndexID;
+	uint32_t m_NumIndices;
+#endif
+};
+
+#if VG_CONFIG_STATIC_CACHED_GEOMETRY
+// All meshes of a CommandListCache in static bgfx buffers (positions in command list space).
+// Created by clCacheUpload() on the context's thread. clCacheReset() can be called from worker threads
+// (tesselateCommandList()) so it only marks the buffers as stale.
+struct CachedGeometry
+{
+	bgfx::VertexBufferHandle m_PosBufferHandle;
+	bgfx::VertexBufferHandle m_UVBufferHandle;
+	bgfx::VertexBufferHandle m_ColorBufferHandle;
+	bgfx::IndexBufferHandle m_IndexBufferHandle;
+	uv_t m_WhitePixelUV[2]; // The font atlas white pixel UV the UV buffer has been filled with
+	uint32_t m_NumVertices;
+	bool m_IsStale;
+};
+#endif
+
+// Meshes, commands and mesh data are allocated from m_Arena, which is rewound (not freed) by clCacheReset().
+// Work done by tesselateCommandList() on a CommandListCache. It's added to Context::m_Stats by the
+// next submitCommandList() because the Tesselator might run on another thread.
+struct CachedStats
+{
+	uint32_t m_NumRebuilds;
+	uint32_t m_NumFlattenedPaths;
+	uint32_t m_NumConcaveFills;
 };
 
 struct CommandListCache
 {
+	Arena m_Arena;
 	CachedMesh* m_Meshes;
 	uint32_t m_NumMeshes;
+	uint32_t m_MeshCapacity;
 	CachedCommand* m_Commands;
 	uint32_t m_NumCommands;
+	uint32_t m_CommandCapacity;
+	uint32_t m_LastUseFrame; // Context::m_FrameID of the last submit/tesselateCommandList()
 	float m_AvgScale;
+	CachedStats m_PendingStats;
+#if VG_CONFIG_STATIC_CACHED_GEOMETRY
+	CachedGeometry m_Geometry;
+#endif
 };
 
 struct CommandList
@@ -285,7 +471,54 @@ struct CommandList
 	uint16_t m_NumGradients;
 	uint16_t m_NumImagePatterns;
 
+	// Command buffer memory already accounted for in Context::m_Stats. clXXX() functions
+	// only touch the list itself (so they can be called from worker threads); the difference
+	// is merged into the context's stats on the owning thread (see clMergeStats()).
+	uint32_t m_MergedMemoryTotal;
+	uint32_t m_MergedMemoryUsed;
+
+#if VG_CONFIG_DEBUG
+	int32_t m_DebugNumWriters; // clAllocCommand() calls in flight; catches two threads recording into the same list
+#endif
+
 	CommandListCache* m_Cache;
+
+#if VG_CONFIG_COMMAND_LIST_AUTO_CACHING
+	// Copy of the command and string buffers at the last submitCommandList().
+	uint8_t* m_PrevContent;
+	uint32_t m_PrevContentCapacity;
+	uint32_t m_PrevCommandBufferSize;
+	uint32_t m_PrevStringBufferSize;
+#endif
+};
+
+#if VG_CONFIG_ENABLE_SHAPE_CACHING
+// Per-thread scratch data used by tesselateCommandList()
+struct Tesselator
+{
+	Path* m_Path;
+	Stroker* m_Stroker;
+	State* m_StateStack;
+	uint32_t m_StateStackTop;
+	float* m_TransformedVertices;
+	uint32_t m_TransformedVertexCapacity;
+	uint32_t m_SubmitCmdListRecursionDepth;
+	bool m_PathTransformed;
+	bool m_RecordClipCommands;
+};
+#endif
+
+// Receives the meshes generated by meshFillPath()/meshStrokePath(). The mesh is only valid until the
+// callback returns.
+typedef void (*PathMeshCallback)(void* userData, const Mesh* mesh, const uint32_t* colors, uint32_t numColors);
+
+// userData of ctxAddPathMesh()
+struct PathMeshTarget
+{
+	Context* m_Ctx;
+	DrawCommand::Type::Enum m_Type; // Textured for solid colors
+	uint16_t m_Handle;              // Gradient or image pattern index
+	bool m_HasCache;
 };
 
 #if VG_CONFIG_COMMAND_LIST_BEGIN_END_API
@@ -337,6 +570,39 @@ struct ContextVTable
 };
 #endif // VG_CONFIG_COMMAND_LIST_BEGIN_END_API
 
+struct Timer
+{
+	enum Enum : uint32_t
+	{
+		Path = 0,
+		Fill,
+		Stroke,
+		Text,
+		End,
+		Raster,
+
+		Count
+	};
+};
+
+#if VG_CONFIG_ENABLE_TIMINGS
+// Adds the time spent in the enclosing scope to the specified counter.
+struct ScopedTimer
+{
+	ScopedTimer(int64_t* counter) : m_Counter(counter), m_Start(bx::getHPCounter())
+	{
+	}
+
+	~ScopedTimer()
+	{
+		*m_Counter += bx::getHPCounter() - m_Start;
+	}
+
+	int64_t* m_Counter;
+	int64_t m_Start;
+};
+#endif
+
 struct Context
 {
 #if VG_CONFIG_COMMAND_LIST_BEGIN_END_API
@@ -345,6 +611,10 @@ struct Context
 
 	ContextConfig m_Config;
 	Stats m_Stats;
+#if VG_CONFIG_ENABLE_TIMINGS
+	int64_t m_TimerTicks[Timer::Count]; // bx::getHPCounter() ticks since begin(), converted to ms by getStats()
+#endif
+	uint32_t m_FirstRenderedGlyphCount; // fonsGetNumRenderedGlyphs() at begin()
 	bx::AllocatorI* m_Allocator;
 	uint16_t m_ViewID;
 	uint16_t m_CanvasWidth;
@@ -367,22 +637,25 @@ struct Context
 
 	IndexBuffer* m_IndexBuffers;
 	GPUIndexBuffer* m_GPUIndexBuffers;
+#if VG_CONFIG_TRANSIENT_BUFFERS
+	bgfx::TransientIndexBuffer m_TransientIndexBuffer; // Valid between the index buffer update and the end of end()
+	bool m_IsTransientIndexBuffer;
+#endif
 	uint32_t m_NumIndexBuffers;
 	uint16_t m_ActiveIndexBufferID;
 
-	float** m_Vec2DataPool;
-	uint32_t m_Vec2DataPoolCapacity;
-
-	uint32_t** m_Uint32DataPool;
-	uint32_t m_Uint32DataPoolCapacity;
+	IndexBufferNode* m_IndexBufferFreeList; // Context's thread only
+	ReleasedList m_ReleasedIndexBuffers;
+	volatile int32_t m_NumIndexBuffersUsed;
 
+	DataPool m_Vec2DataPools[VG_CONFIG_MAX_VB_SIZE_CLASSES];
+	DataPool m_Uint32DataPools[VG_CONFIG_MAX_VB_SIZE_CLASSES];
 #if VG_CONFIG_UV_INT16
-	int16_t** m_UVDataPool;
-	uint32_t m_UVDataPoolCapacity;
-#endif
-#if BX_CONFIG_SUPPORTS_THREADING
-	bx::Mutex* m_DataPoolMutex;
+	DataPool m_UVDataPools[VG_CONFIG_MAX_VB_SIZE_CLASSES];
 #endif
+	uint32_t m_NumVertexBufferSizeClasses;
+	uint32_t m_PooledVertexMemory;
+	uint32_t m_PeakPooledVertexMemory;
 
 	Image* m_Images;
 	uint32_t m_ImageCapacity;
@@ -394,12 +667,35 @@ struct Context
 #if VG_CONFIG_ENABLE_SHAPE_CACHING
 	CommandListCache* m_CmdListCacheStack[VG_CONFIG_COMMAND_LIST_CACHE_STACK_SIZE];
 	uint32_t m_CmdListCacheStackTop;
+	uint32_t m_CmdListCacheMemoryEvicted;
+#endif
+	uint32_t m_FrameID; // Incremented in begin()
+#if VG_CONFIG_STATIC_CACHED_GEOMETRY
+	// Static buffers of command list caches which have been reset or destroyed. They might still be
+	// referenced by the current frame's draw commands, so they are destroyed at the end of end().
+	CachedGeometry* m_StaleGeometry;
+	uint32_t m_NumStaleGeometry;
+	uint32_t m_StaleGeometryCapacity;
 #endif
 
 	float* m_TransformedVertices;
 	uint32_t m_TransformedVertexCapacity;
 	bool m_PathTransformed;
 
+#if VG_CONFIG_SOFTWARE_SCISSOR
+	float* m_ScissorClipPos;
+	uv_t* m_ScissorClipUV;
+	uint32_t* m_ScissorClipColors;
+	uint16_t* m_ScissorClipIndices;
+	uint32_t m_ScissorClipVertexCapacity;
+	uint32_t m_ScissorClipIndexCapacity;
+	bool m_ForceHardwareScissor; // The next draw command uses the scissor rect of the current state; consumed by allocDrawCommand()
+#endif
+
+	// Reset in begin(). Holds the draw/clip commands and the scratch buffers of the current frame, which
+	// stay valid until the next begin() (e.g. for resubmitFrame()).
+	Arena m_FrameArena;
+
 	DrawCommand* m_DrawCommands;
 	uint32_t m_NumDrawCommands;
 	uint32_t m_DrawCommandCapacity;
@@ -414,9 +710,23 @@ struct Context
 	bool m_RecordClipCommands;
 	bool m_ForceNewClipCommand;
 	bool m_ForceNewDrawCommand;
+	bool m_CanResubmitFrame; // The draw commands and GPU buffers of the last end() are still valid (see resubmitFrame())
+
+#if VG_CONFIG_RECORD_DRAW_CALLS
+	DrawCallCallback m_DrawCallCallback;
+	void* m_DrawCallCallbackUserData;
+#endif
+
+#if VG_CONFIG_SOFTWARE_RASTERIZER
+	Rasterizer* m_Rasterizer; // nullptr if there's no raster target
+#endif
 
 	Gradient* m_Gradients;
 	uint32_t m_NextGradientID;
+#if VG_CONFIG_BATCH_LINEAR_GRADIENTS
+	Color* m_GradientRampData; // 2 texels (inner, outer color) per gradient
+	ImageHandle m_GradientRampImage;
+#endif
 
 	ImagePattern* m_ImagePatterns;
 	uint32_t m_NextImagePatternID;
@@ -451,31 +761,65 @@ static void updateWhitePixelUV(Context* ctx);
 
 static float* allocTransformedVertices(Context* ctx, uint32_t numVertices);
 static const float* transformPath(Context* ctx);
-
-static VertexBuffer* allocVertexBuffer(Context* ctx);
-static float* allocVertexBufferData_Vec2(Context* ctx);
-static uint32_t* allocVertexBufferData_Uint32(Context* ctx);
-static void releaseVertexBufferData_Vec2(Context* ctx, float* data);
-static void releaseVertexBufferData_Uint32(Context* ctx, uint32_t* data);
-static void releaseVertexBufferDataCallback_Vec2(void* ptr, void* userData);
-static void releaseVertexBufferDataCallback_Uint32(void* ptr, void* userData);
+static bool cullPath(Context* ctx, const float* pathVertices, float extent);
+static float calcStrokeExtent(float strokeWidth, LineCap::Enum lineCap, LineJoin::Enum lineJoin);
+static bool calcStrokeParams(float width, uint32_t flags, float avgScale, float fringeWidth, float* strokeWidth, float* alphaScale);
+static void meshFillPath(Stroker* stroker, const Path* path, const float* pathVertices, uint32_t flags, Color col, bool aa, PathMeshCallback callback, void* userData);
+static void meshStrokePath(Stroker* stroker, const Path* path, const float* pathVertices, uint32_t flags, Color col, float strokeWidth, bool isThin, bool aa, PathMeshCallback callback, void* userData);
+
+static VertexBuffer* allocVertexBuffer(Context* ctx, uint32_t numVertices);
+static uint32_t getVertexBufferSizeClass(Context* ctx, uint32_t numVertices);
+static uint32_t getVertexBufferSizeClassCapacity(Context* ctx, uint32_t sizeClass);
+static void allocVertexBufferStreams(Context* ctx, VertexBuffer* vb, uint32_t sizeClass);
+static void releaseVertexBufferStreams(Context* ctx, VertexBuffer* vb);
+static void growVertexBuffer(Context* ctx, VertexBuffer* vb, uint32_t numVertices);
+static void setDrawCommandBuffers(Context* ctx, const DrawCommand* cmd);
+static void submitDrawCommands(Context* ctx, uint16_t viewID, const float* viewMtx, const float* projMtx);
+static void submitStencilClear(Context* ctx, uint16_t viewID, const float* viewMtx, const float* projMtx);
+#if VG_CONFIG_RECORD_DRAW_CALLS
+static void recordDrawCall(Context* ctx, uint16_t viewID, const DrawCommand* cmd, uint64_t state, uint32_t stencil, uint16_t imageHandle, const float* paintMtx, const Gradient* grad);
+#endif
+#if VG_CONFIG_SOFTWARE_RASTERIZER
+static void rasterizeDrawCommands(Context* ctx);
+#endif
+static void releasedListPush(ReleasedList* list, void* node);
+static void* releasedListPopAll(ReleasedList* list);
+static void arenaDestroy(bx::AllocatorI* allocator, Arena* arena);
+static void arenaReset(bx::AllocatorI* allocator, Arena* arena);
+static void* arenaAlloc(bx::AllocatorI* allocator, Arena* arena, uint32_t size);
+static void* arenaRealloc(bx::AllocatorI* allocator, Arena* arena, void* ptr, uint32_t oldSize, uint32_t newSize);
+static void dataPoolInit(DataPool* pool, uint32_t bufferSize);
+static void dataPoolDestroy(Context* ctx, DataPool* pool);
+static void* dataPoolAlloc(Context* ctx, DataPool* pool);
+static void dataPoolRelease(DataPool* pool, void* data);
+static void dataPoolTrim(Context* ctx, DataPool* pool, uint32_t maxBuffers);
+static void dataPoolDecay(Context* ctx, DataPool* pool, uint32_t maxIdleFrames);
+static void releaseVertexBufferDataCallback(void* ptr, void* userData);
 
 static uint16_t allocIndexBuffer(Context* ctx);
-static void releaseIndexBuffer(Context* ctx, uint16_t* data);
+static void releaseIndexBuffer(Context* ctx, IndexBufferNode* node);
 static void releaseIndexBufferCallback(void* ptr, void* userData);
 
-#if VG_CONFIG_UV_INT16
-static int16_t* allocVertexBufferData_UV(Context* ctx);
-static void releaseVertexBufferData_UV(Context* ctx, int16_t* data);
-static void releaseVertexBufferDataCallback_UV(void* ptr, void* userData);
-#endif
-
+static void growDrawCommandArray(Context* ctx, DrawCommand** commands, uint32_t* capacity);
 static DrawCommand* allocDrawCommand(Context* ctx, uint32_t numVertices, uint32_t numIndices, DrawCommand::Type::Enum type, uint16_t handle);
 static DrawCommand* allocClipCommand(Context* ctx, uint32_t numVertices, uint32_t numIndices);
 static void createDrawCommand_VertexColor(Context* ctx, const float* vtx, uint32_t numVertices, const uint32_t* colors, uint32_t numColors, const uint16_t* indices, uint32_t numIndices);
 static void createDrawCommand_ImagePattern(Context* ctx, ImagePatternHandle handle, const float* vtx, uint32_t numVertices, const uint32_t* colors, uint32_t numColors, const uint16_t* indices, uint32_t numIndices);
 static void createDrawCommand_ColorGradient(Context* ctx, GradientHandle handle, const float* vtx, uint32_t numVertices, const uint32_t* colors, uint32_t numColors, const uint16_t* indices, uint32_t numIndices);
 static void createDrawCommand_Clip(Context* ctx, const float* vtx, uint32_t numVertices, const uint16_t* indices, uint32_t numIndices);
+#if VG_CONFIG_SOFTWARE_SCISSOR
+static bool clipMeshToScissorRect(Context* ctx, const float** vtx, const uv_t** uv, uint32_t* numVertices, const uint32_t** colors, uint32_t* numColors, const uint16_t** indices, uint32_t* numIndices);
+static uint32_t clipTextQuadsToScissorRect(Context* ctx, FONSquad* quads, uint32_t numQuads, const float* mtx);
+#endif
+#if VG_CONFIG_BATCH_IMAGE_PATTERNS
+static bool createDrawCommand_ImagePatternUV(Context* ctx, ImagePatternHandle imgPatternHandle, const float* vtx, uint32_t numVertices, const uint32_t* colors, uint32_t numColors, const uint16_t* indices, uint32_t numIndices);
+#endif
+#if VG_CONFIG_BATCH_LINEAR_GRADIENTS
+static bool createDrawCommand_GradientRamp(Context* ctx, GradientHandle gradientHandle, const float* vtx, uint32_t numVertices, const uint32_t* colors, uint32_t numColors, const uint16_t* indices, uint32_t numIndices);
+static void flushGradientRamps(Context* ctx);
+#endif
+static void reorderDrawCommands(Context* ctx);
+static void assignStencilValues(Context* ctx);
 
 static ImageHandle allocImage(Context* ctx);
 static void resetImage(Image* img);
@@ -486,13 +830,29 @@ static void flushTextAtlas(Context* ctx);
 
 static CommandListHandle allocCommandList(Context* ctx);
 static bool isCommandListHandleValid(Context* ctx, CommandListHandle handle);
+static void clResizeCommandBuffer(Context* ctx, CommandList* cl, uint32_t capacity);
+static void clResizeStringBuffer(Context* ctx, CommandList* cl, uint32_t capacity);
 static uint8_t* clAllocCommand(Context* ctx, CommandList* cl, CommandType::Enum cmdType, uint32_t dataSize);
+static uint32_t clGetCommandHeaderSize(uint32_t dataSize);
+static const uint8_t* clReadCommandHeader(const uint8_t* cmd, CommandType::Enum* type, uint32_t* dataSize);
+#if VG_CONFIG_COMMAND_LIST_FIXED_POINT_BITS
+static bool clStoreFixedPointCommand(Context* ctx, CommandList* cl, CommandType::Enum cmdType, const float* coords, uint32_t numCoords);
+static bool quantizeCoords(int16_t* dst, const float* src, uint32_t numCoords);
+static void dequantizeCoords(float* dst, const int16_t* src, uint32_t numCoords);
+#endif
 static uint32_t clStoreString(Context* ctx, CommandList* cl, const char* str, uint32_t len);
+static void clMergeStats(Context* ctx, CommandList* cl);
 
 #if VG_CONFIG_ENABLE_SHAPE_CACHING
 static void clCacheRender(Context* ctx, CommandList* cl);
 static void clCacheReset(Context* ctx, CommandListCache* cache);
+static void clCacheEvict(Context* ctx, CommandListCache* cache);
+static uint32_t getCommandListCacheMemory(Context* ctx);
+static void evictCommandListCaches(Context* ctx);
 static CommandListCache* clGetCache(Context* ctx, CommandList* cl);
+#if VG_CONFIG_COMMAND_LIST_AUTO_CACHING
+static CommandListCache* clGetAutoCache(Context* ctx, CommandList* cl);
+#endif
 static CommandListCache* allocCommandListCache(Context* ctx);
 static void freeCommandListCache(Context* ctx, CommandListCache* cache);
 static void pushCommandListCache(Context* ctx, CommandListCache* cache);
@@ -501,9 +861,26 @@ static CommandListCache* getCommandListCacheStackTop(Context* ctx);
 static void beginCachedCommand(Context* ctx);
 static void endCachedCommand(Context* ctx);
 static void addCachedCommand(Context* ctx, const float* pos, uint32_t numVertices, const uint32_t* colors, uint32_t numColors, const uint16_t* indices, uint32_t numIndices);
+static void cacheBeginCommand(bx::AllocatorI* allocator, CommandListCache* cache, const float* transformMtx);
+static void cacheEndCommand(CommandListCache* cache);
+static void cacheAddMesh(bx::AllocatorI* allocator, CommandListCache* cache, const float* pos, uint32_t numVertices, const uint32_t* colors, uint32_t numColors, const uint16_t* indices, uint32_t numIndices);
+static void clCacheBuild(Context* ctx, Tesselator* tess, CommandList* cl, CommandListCache* cache);
+static void clCacheMergeStats(Context* ctx, CommandListCache* cache);
+static void tessSubmitCommandList(Context* ctx, Tesselator* tess, CommandList* cl);
+static const float* tessTransformPath(Context* ctx, Tesselator* tess, CommandListCache* cache);
+static void tessFillPath(Context* ctx, Tesselator* tess, CommandListCache* cache, uint32_t flags, Color col, bool aa);
+static void tessStrokePath(Context* ctx, Tesselator* tess, CommandListCache* cache, uint32_t flags, Color col, float strokeWidth, bool isThin, bool aa);
+static void tessAddPathMesh(void* userData, const Mesh* mesh, const uint32_t* colors, uint32_t numColors);
 static void submitCachedMesh(Context* ctx, Color col, const CachedMesh* meshList, uint32_t numMeshes);
 static void submitCachedMesh(Context* ctx, GradientHandle gradientHandle, const CachedMesh* meshList, uint32_t numMeshes);
 static void submitCachedMesh(Context* ctx, ImagePatternHandle imgPatter, Color color, const CachedMesh* meshList, uint32_t numMeshes);
+static bool submitCachedCommand(Context* ctx, const CommandListCache* cache, const CachedCommand* cachedCmd, DrawCommand::Type::Enum type, uint16_t handle);
+#if VG_CONFIG_STATIC_CACHED_GEOMETRY
+static void clCacheUpload(Context* ctx, CommandListCache* cache);
+static void clCacheDestroyGeometry(Context* ctx, CommandListCache* cache);
+static void destroyStaleCachedGeometry(Context* ctx);
+static void calcStaticPaintMatrix(const float* paintMtx, const float* modelMtx, float* res);
+#endif
 #endif
 
 static void ctxBeginPath(Context* ctx);
@@ -526,6 +903,9 @@ static void ctxFillPathImagePattern(Context* ctx, ImagePatternHandle imgPatternH
 static void ctxStrokePathColor(Context* ctx, Color color, float width, uint32_t flags);
 static void ctxStrokePathGradient(Context* ctx, GradientHandle gradientHandle, float width, uint32_t flags);
 static void ctxStrokePathImagePattern(Context* ctx, ImagePatternHandle imgPatternHandle, Color color, float width, uint32_t flags);
+static void ctxFillPath(Context* ctx, const PathMeshTarget* target, uint32_t flags, Color col, bool aa);
+static void ctxStrokePath(Context* ctx, const PathMeshTarget* target, uint32_t flags, Color col, float strokeWidth, bool isThin, bool aa);
+static void ctxAddPathMesh(void* userData, const Mesh* mesh, const uint32_t* colors, uint32_t numColors);
 static void ctxBeginClip(Context* ctx, ClipRule::Enum rule);
 static void ctxEndClip(Context* ctx);
 static void ctxResetClip(Context* ctx);
@@ -705,7 +1085,14 @@ inline bool isAligned(uint32_t sz, uint32_t alignment)
 	return (sz & (alignment - 1)) == 0;
 }
 
+#if !VG_CONFIG_COMPACT_COMMAND_LISTS
 static const uint32_t kAlignedCommandHeaderSize = alignSize(sizeof(CommandHeader), VG_CONFIG_COMMAND_LIST_ALIGNMENT);
+#endif
+#if VG_CONFIG_COMMAND_LIST_FIXED_POINT_BITS
+static const float kFixedPointScale = (float)(1 << VG_CONFIG_COMMAND_LIST_FIXED_POINT_BITS);
+static const float kInvFixedPointScale = 1.0f / kFixedPointScale;
+#endif
+static const uint32_t kAlignedArenaChunkHeaderSize = alignSize(sizeof(ArenaChunk), 16);
 
 inline bool isLocal(uint16_t handleFlags)      { return (handleFlags & HandleFlags::LocalHandle) != 0; }
 inline bool isLocal(GradientHandle handle)     { return isLocal(handle.flags); }
@@ -726,17 +1113,25 @@ Context* createContext(bx::AllocatorI* allocator, const ContextConfig* userCfg)
 		65536,                       // m_MaxVBVertices
 		ImageFlags::Filter_Bilinear, // m_FontAtlasImageFlags
 		16,                          // m_MaxCommandListDepth
-		true                         // m_ResetViewTransformOnEnd
+		true,                        // m_ResetViewTransformOnEnd
+		false,                       // m_ReorderDrawCommands
+		120,                         // m_MaxPoolIdleFrames
+		0                            // m_CommandListCacheBudget
 	};
 
 	const ContextConfig* cfg = userCfg ? userCfg : &defaultConfig;
 
-	VG_CHECK(cfg->m_MaxVBVertices <= 65536, "Vertex buffers cannot be larger than 64k vertices because indices are always uint16");
+#if !VG_CONFIG_UINT32_INDICES
+	VG_CHECK(cfg->m_MaxVBVertices <= 65536, "Vertex buffers cannot be larger than 64k vertices because indices are uint16 (see VG_CONFIG_UINT32_INDICES)");
+#endif
 
 	const uint32_t alignment = 8;
 	const uint32_t totalMem = 0
 		+ alignSize(sizeof(Context), alignment)
 		+ alignSize(sizeof(Gradient) * cfg->m_MaxGradients, alignment)
+#if VG_CONFIG_BATCH_LINEAR_GRADIENTS
+		+ alignSize(sizeof(Color) * 2 * cfg->m_MaxGradients, alignment)
+#endif
 		+ alignSize(sizeof(ImagePattern) * cfg->m_MaxImagePatterns, alignment)
 		+ alignSize(sizeof(State) * cfg->m_MaxStateStackSize, alignment)
 		+ alignSize(sizeof(FontData) * cfg->m_MaxFonts, alignment)
@@ -747,6 +1142,9 @@ Context* createContext(bx::AllocatorI* allocator, const ContextConfig* userCfg)
 
 	Context* ctx = (Context*)mem;              mem += alignSize(sizeof(Context), alignment);
 	ctx->m_Gradients = (Gradient*)mem;         mem += alignSize(sizeof(Gradient) * cfg->m_MaxGradients, alignment);
+#if VG_CONFIG_BATCH_LINEAR_GRADIENTS
+	ctx->m_GradientRampData = (Color*)mem;     mem += alignSize(sizeof(Color) * 2 * cfg->m_MaxGradients, alignment);
+#endif
 	ctx->m_ImagePatterns = (ImagePattern*)mem; mem += alignSize(sizeof(ImagePattern) * cfg->m_MaxImagePatterns, alignment);
 	ctx->m_StateStack = (State*)mem;           mem += alignSize(sizeof(State) * cfg->m_MaxStateStackSize, alignment);
 	ctx->m_FontData = (FontData*)mem;          mem += alignSize(sizeof(FontData) * cfg->m_MaxFonts, alignment);
@@ -772,13 +1170,25 @@ Context* createContext(bx::AllocatorI* allocator, const ContextConfig* userCfg)
 	ctx->m_CmdListCacheStackTop = ~0u;
 #endif
 
-#if BX_CONFIG_SUPPORTS_THREADING
-	ctx->m_DataPoolMutex = BX_NEW(allocator, bx::Mutex)();
+	uint32_t numSizeClasses = 1;
+	while (getVertexBufferSizeClassCapacity(ctx, numSizeClasses - 1) < ctx->m_Config.m_MaxVBVertices) {
+		++numSizeClasses;
+	}
+	VG_CHECK(numSizeClasses <= VG_CONFIG_MAX_VB_SIZE_CLASSES, "Too many vertex buffer size classes. Increase VG_CONFIG_MAX_VB_SIZE_CLASSES");
+	ctx->m_NumVertexBufferSizeClasses = numSizeClasses;
+
+	for (uint32_t i = 0; i < numSizeClasses; ++i) {
+		const uint32_t numVertices = getVertexBufferSizeClassCapacity(ctx, i);
+		dataPoolInit(&ctx->m_Vec2DataPools[i], sizeof(float) * 2 * numVertices);
+		dataPoolInit(&ctx->m_Uint32DataPools[i], sizeof(uint32_t) * numVertices);
+#if VG_CONFIG_UV_INT16
+		dataPoolInit(&ctx->m_UVDataPools[i], sizeof(int16_t) * 2 * numVertices);
 #endif
+	}
 	ctx->m_Path = createPath(allocator);
 	ctx->m_Stroker = createStroker(allocator);
 
-	ctx->m_ImageHandleAlloc = bx::createHandleAlloc(allocator, cfg->m_MaxImages);
+	ctx->m_ImageHandleAlloc = bx::createHandleAlloc(allocator, (uint16_t)(cfg->m_MaxImages + VG_CONFIG_NUM_INTERNAL_IMAGES));
 	ctx->m_CmdListHandleAlloc = bx::createHandleAlloc(allocator, cfg->m_MaxCommandLists);
 
 	// bgfx setup
@@ -854,6 +1264,12 @@ Context* createContext(bx::AllocatorI* allocator, const ContextConfig* userCfg)
 	ctx->m_FontImageID = 0;
 	updateWhitePixelUV(ctx);
 
+#if VG_CONFIG_BATCH_LINEAR_GRADIENTS
+	// Uses the extra image slot reserved by VG_CONFIG_NUM_INTERNAL_IMAGES.
+	ctx->m_GradientRampImage = createImage(ctx, 2, cfg->m_MaxGradients, ImageFlags::Filter_Bilinear | ImageFlags::Clamp_UV, nullptr);
+	VG_CHECK(isValid(ctx->m_GradientRampImage), "Failed to initialize gradient ramp texture");
+#endif
+
 	fonsInitString(&ctx->m_TextString);
 
 	return ctx;
@@ -915,6 +1331,9 @@ void destroyContext(Context* ctx)
         }
 		ib->m_Capacity = 0;
 		ib->m_Count = 0;
+
+		bx::free(allocator, ib->m_Node);
+		ib->m_Node = nullptr;
 	}
 	bx::free(allocator, ctx->m_GPUIndexBuffers);
 	bx::free(allocator, ctx->m_IndexBuffers);
@@ -922,55 +1341,23 @@ void destroyContext(Context* ctx)
 	ctx->m_IndexBuffers = nullptr;
 	ctx->m_ActiveIndexBufferID = UINT16_MAX;
 
-	for (uint32_t i = 0; i < ctx->m_Vec2DataPoolCapacity; ++i) {
-		float* buffer = ctx->m_Vec2DataPool[i];
-		if (!buffer) {
-			continue;
-		}
-
-		if ((uintptr_t)buffer & 1) {
-			buffer = (float*)((uintptr_t)buffer & ~1);
-			bx::alignedFree(allocator, buffer, 16);
-		}
-	}
-	bx::free(allocator, ctx->m_Vec2DataPool);
-	ctx->m_Vec2DataPoolCapacity = 0;
-
-	for (uint32_t i = 0; i < ctx->m_Uint32DataPoolCapacity; ++i) {
-		uint32_t* buffer = ctx->m_Uint32DataPool[i];
-		if (!buffer) {
-			continue;
-		}
-
-		if ((uintptr_t)buffer & 1) {
-			buffer = (uint32_t*)((uintptr_t)buffer & ~1);
-			bx::alignedFree(allocator, buffer, 16);
-		}
-	}
-	bx::free(allocator, ctx->m_Uint32DataPool);
-	ctx->m_Uint32DataPoolCapacity = 0;
+	ctx->m_IndexBufferFreeList = nullptr;
+	ctx->m_ReleasedIndexBuffers.m_Head = 0;
 
+	for (uint32_t i = 0; i < ctx->m_NumVertexBufferSizeClasses; ++i) {
+		dataPoolDestroy(ctx, &ctx->m_Vec2DataPools[i]);
+		dataPoolDestroy(ctx, &ctx->m_Uint32DataPools[i]);
 #if VG_CONFIG_UV_INT16
-	for (uint32_t i = 0; i < ctx->m_UVDataPoolCapacity; ++i) {
-		int16_t* buffer = ctx->m_UVDataPool[i];
-		if (!buffer) {
-			continue;
-		}
-
-		if ((uintptr_t)buffer & 1) {
-			buffer = (int16_t*)((uintptr_t)buffer & ~1);
-			bx::alignedFree(allocator, buffer, 16);
-		}
-	}
-	bx::free(allocator, ctx->m_UVDataPool);
-	ctx->m_UVDataPoolCapacity = 0;
+		dataPoolDestroy(ctx, &ctx->m_UVDataPools[i]);
 #endif
+	}
 
-	bx::free(allocator, ctx->m_DrawCommands);
+	arenaDestroy(allocator, &ctx->m_FrameArena);
 	ctx->m_DrawCommands = nullptr;
-
-	bx::free(allocator, ctx->m_ClipCommands);
 	ctx->m_ClipCommands = nullptr;
+	ctx->m_TextQuads = nullptr;
+	ctx->m_TextVertices = nullptr;
+	ctx->m_TransformedVertices = nullptr;
 
 	// Font data
 	for (int i = 0; i < cfg->m_MaxFonts; ++i) {
@@ -993,6 +1380,9 @@ void destroyContext(Context* ctx)
 		if (bgfx::isValid(img->m_bgfxHandle)) {
 			bgfx::destroy(img->m_bgfxHandle);
 		}
+#if VG_CONFIG_SOFTWARE_RASTERIZER
+		bx::free(allocator, img->m_RasterData);
+#endif
 	}
 	bx::free(allocator, ctx->m_Images);
 	ctx->m_Images = nullptr;
@@ -1003,29 +1393,37 @@ void destroyContext(Context* ctx)
 	bx::destroyHandleAlloc(allocator, ctx->m_CmdListHandleAlloc);
 	ctx->m_CmdListHandleAlloc = nullptr;
 
+#if VG_CONFIG_STATIC_CACHED_GEOMETRY
+	destroyStaleCachedGeometry(ctx);
+	bx::free(allocator, ctx->m_StaleGeometry);
+	ctx->m_StaleGeometry = nullptr;
+	ctx->m_StaleGeometryCapacity = 0;
+#endif
+
+#if VG_CONFIG_SOFTWARE_RASTERIZER
+	if (ctx->m_Rasterizer) {
+		destroyRasterizer(ctx->m_Rasterizer);
+		ctx->m_Rasterizer = nullptr;
+	}
+#endif
+
 	destroyPath(ctx->m_Path);
 	ctx->m_Path = nullptr;
 
 	destroyStroker(ctx->m_Stroker);
 	ctx->m_Stroker = nullptr;
 
-    if (ctx->m_TextQuads) {
-        bx::alignedFree(allocator, ctx->m_TextQuads, 16);
-        ctx->m_TextQuads = nullptr;
-    }
-
-    if (ctx->m_TextVertices) {
-        bx::alignedFree(allocator, ctx->m_TextVertices, 16);
-        ctx->m_TextVertices = nullptr;
-    }
-
-    if (ctx->m_TransformedVertices) {
-        bx::alignedFree(allocator, ctx->m_TransformedVertices, 16);
-        ctx->m_TransformedVertices = nullptr;
-    }
-
-#if BX_CONFIG_SUPPORTS_THREADING
-	bx::deleteObject(allocator, ctx->m_DataPoolMutex);
+#if VG_CONFIG_SOFTWARE_SCISSOR
+	bx::alignedFree(allocator, ctx->m_ScissorClipPos, 16);
+	bx::alignedFree(allocator, ctx->m_ScissorClipUV, 16);
+	bx::alignedFree(allocator, ctx->m_ScissorClipColors, 16);
+	bx::alignedFree(allocator, ctx->m_ScissorClipIndices, 16);
+	ctx->m_ScissorClipPos = nullptr;
+	ctx->m_ScissorClipUV = nullptr;
+	ctx->m_ScissorClipColors = nullptr;
+	ctx->m_ScissorClipIndices = nullptr;
+	ctx->m_ScissorClipVertexCapacity = 0;
+	ctx->m_ScissorClipIndexCapacity = 0;
 #endif
 
 	bx::alignedFree(allocator, ctx, 8);
@@ -1048,20 +1446,53 @@ void begin(Context* ctx, uint16_t viewID, uint16_t canvasWidth, uint16_t canvasH
 
 #if VG_CONFIG_ENABLE_SHAPE_CACHING
 	ctx->m_CmdListCacheStackTop = ~0u;
+
+	if (ctx->m_Config.m_CommandListCacheBudget != 0) {
+		evictCommandListCaches(ctx);
+	}
+#endif
+	ctx->m_FrameID++;
+
+#if VG_CONFIG_STATIC_CACHED_GEOMETRY
+	// The previous frame's draw calls (including resubmitFrame()) have been submitted, and bgfx keeps
+	// the buffers alive until they have been rendered.
+	destroyStaleCachedGeometry(ctx);
 #endif
 
 	VG_CHECK(ctx->m_StateStackTop == 0, "State stack hasn't been properly reset in the previous frame");
 	resetScissor(ctx);
 	transformIdentity(ctx);
 
+	// Return the pooled buffers which haven't been needed for a while to the allocator.
+	const uint32_t maxIdleFrames = ctx->m_Config.m_MaxPoolIdleFrames;
+	for (uint32_t i = 0; i < ctx->m_NumVertexBufferSizeClasses; ++i) {
+		dataPoolDecay(ctx, &ctx->m_Vec2DataPools[i], maxIdleFrames);
+		dataPoolDecay(ctx, &ctx->m_Uint32DataPools[i], maxIdleFrames);
+#if VG_CONFIG_UV_INT16
+		dataPoolDecay(ctx, &ctx->m_UVDataPools[i], maxIdleFrames);
+#endif
+	}
+
+	// The frame arrays keep their capacity from the previous frame, so in a steady state they are
+	// carved out of the frame arena once, without any copies.
+	bx::AllocatorI* allocator = ctx->m_Allocator;
+	Arena* frameArena = &ctx->m_FrameArena;
+	arenaReset(allocator, frameArena);
+	ctx->m_DrawCommands = (DrawCommand*)arenaAlloc(allocator, frameArena, sizeof(DrawCommand) * ctx->m_DrawCommandCapacity);
+	ctx->m_ClipCommands = (DrawCommand*)arenaAlloc(allocator, frameArena, sizeof(DrawCommand) * ctx->m_ClipCommandCapacity);
+	ctx->m_TransformedVertices = (float*)arenaAlloc(allocator, frameArena, sizeof(float) * 2 * ctx->m_TransformedVertexCapacity);
+	ctx->m_TextQuads = (FONSquad*)arenaAlloc(allocator, frameArena, sizeof(FONSquad) * ctx->m_TextQuadCapacity);
+	ctx->m_TextVertices = (float*)arenaAlloc(allocator, frameArena, sizeof(float) * 2 * (ctx->m_TextQuadCapacity * 4));
+
 	ctx->m_FirstVertexBufferID = ctx->m_NumVertexBuffers;
-	allocVertexBuffer(ctx);
+	allocVertexBuffer(ctx, 0);
 
 	ctx->m_ActiveIndexBufferID = allocIndexBuffer(ctx);
 	VG_CHECK(ctx->m_IndexBuffers[ctx->m_ActiveIndexBufferID].m_Count == 0, "Not empty index buffer");
 
 	ctx->m_NumDrawCommands = 0;
 	ctx->m_ForceNewDrawCommand = true;
+	ctx->m_CanResubmitFrame = false;
 
 	ctx->m_NumClipCommands = 0;
 	ctx->m_ForceNewClipCommand = true;
@@ -1071,36 +1502,83 @@ void begin(Context* ctx, uint16_t viewID, uint16_t canvasWidth, uint16_t canvasH
 
 	ctx->m_NextGradientID = 0;
 	ctx->m_NextImagePatternID = 0;
+
+	Stats* stats = &ctx->m_Stats;
+	stats->m_NumCulledPaths = 0;
+	stats->m_NumDrawCalls = 0;
+	stats->m_NumClipDrawCalls = 0;
+	stats->m_NumVertices = 0;
+	stats->m_NumIndices = 0;
+	stats->m_NumVertexBuffers = 0;
+	stats->m_NumFlattenedPaths = 0;
+	stats->m_NumConcaveFills = 0;
+	stats->m_NumCacheHits = 0;
+	stats->m_NumCacheMisses = 0;
+	stats->m_NumGlyphsBaked = 0;
+	stats->m_NumAtlasUploads = 0;
+	stats->m_NumAtlasResets = 0;
+	ctx->m_FirstRenderedGlyphCount = (uint32_t)fonsGetNumRenderedGlyphs(ctx->m_FontStashContext);
+#if VG_CONFIG_ENABLE_TIMINGS
+	bx::memSet(ctx->m_TimerTicks, 0, sizeof(ctx->m_TimerTicks));
+#endif
 }
 
 void end(Context* ctx)
 {
+	VG_SCOPED_TIMER(ctx, Timer::End);
 	VG_CHECK(ctx->m_StateStackTop == 0, "pushState()/popState() mismatch");
 	VG_CHECK(!isValid(ctx->m_ActiveCommandList), "endCommandList() hasn't been called");
 
+	if (ctx->m_Config.m_ReorderDrawCommands) {
+		reorderDrawCommands(ctx);
+	}
+
+	ctx->m_CanResubmitFrame = true;
+
 	const uint32_t numDrawCommands = ctx->m_NumDrawCommands;
 	if (numDrawCommands == 0) {
-		// Release the vertex buffer allocated in beginFrame()
-		VertexBuffer* vb = &ctx->m_VertexBuffers[ctx->m_FirstVertexBufferID];
-		releaseVertexBufferData_Vec2(ctx, vb->m_Pos);
-		releaseVertexBufferData_Uint32(ctx, vb->m_Color);
+		// Release the vertex and index buffers allocated in begin()
+		releaseIndexBuffer(ctx, ctx->m_IndexBuffers[ctx->m_ActiveIndexBufferID].m_Node);
 
-#if VG_CONFIG_UV_INT16
-		releaseVertexBufferData_UV(ctx, vb->m_UV);
-#else
-		releaseVertexBufferData_Vec2(ctx, vb->m_UV);
-#endif
+		releaseVertexBufferStreams(ctx, &ctx->m_VertexBuffers[ctx->m_FirstVertexBufferID]);
 
 		return;
 	}
 
 	flushTextAtlas(ctx);
+#if VG_CONFIG_BATCH_LINEAR_GRADIENTS
+	flushGradientRamps(ctx);
+#endif
+
+	Stats* stats = &ctx->m_Stats;
+	stats->m_NumGlyphsBaked = (uint32_t)fonsGetNumRenderedGlyphs(ctx->m_FontStashContext) - ctx->m_FirstRenderedGlyphCount;
+	stats->m_NumVertexBuffers = ctx->m_NumVertexBuffers - ctx->m_FirstVertexBufferID;
+	stats->m_NumIndices = ctx->m_IndexBuffers[ctx->m_ActiveIndexBufferID].m_Count;
+
+	// NOTE: Reads the clip commands' vertices so it must be called before the vertex buffers are submitted.
+	assignStencilValues(ctx);
+
+#if VG_CONFIG_SOFTWARE_RASTERIZER
+	// NOTE: Reads the vertex and index buffers so it must be called before they are submitted.
+	if (ctx->m_Rasterizer) {
+		rasterizeDrawCommands(ctx);
+	}
+#endif
 
 	// Update bgfx vertex buffers...
 	const uint32_t numVertexBuffers = ctx->m_NumVertexBuffers;
 	for (uint32_t iVB = ctx->m_FirstVertexBufferID; iVB < numVertexBuffers; ++iVB) {
 		VertexBuffer* vb = &ctx->m_VertexBuffers[iVB];
 		GPUVertexBuffer* gpuvb = &ctx->m_GPUVertexBuffers[iVB];
+
+		stats->m_NumVertices += vb->m_Count;
+
+#if VG_CONFIG_TRANSIENT_BUFFERS
+		if (vb->m_IsTransient) {
+			// Already in bgfx memory.
+			continue;
+		}
+#endif
 		
 		const uint32_t maxVBVertices = ctx->m_Config.m_MaxVBVertices;
 		if (!bgfx::isValid(gpuvb->m_PosBufferHandle)) {
@@ -1113,12 +1591,13 @@ void end(Context* ctx)
 			gpuvb->m_ColorBufferHandle = bgfx::createDynamicVertexBuffer(maxVBVertices, ctx->m_ColorVertexDecl, 0);
 		}
 
-		const bgfx::Memory* posMem = bgfx::makeRef(vb->m_Pos, sizeof(float) * 2 * vb->m_Count, releaseVertexBufferDataCallback_Vec2, ctx);
-		const bgfx::Memory* colorMem = bgfx::makeRef(vb->m_Color, sizeof(uint32_t) * vb->m_Count, releaseVertexBufferDataCallback_Uint32, ctx);
+		const uint32_t sizeClass = vb->m_SizeClass;
+		const bgfx::Memory* posMem = bgfx::makeRef(vb->m_Pos, sizeof(float) * 2 * vb->m_Count, releaseVertexBufferDataCallback, &ctx->m_Vec2DataPools[sizeClass]);
+		const bgfx::Memory* colorMem = bgfx::makeRef(vb->m_Color, sizeof(uint32_t) * vb->m_Count, releaseVertexBufferDataCallback, &ctx->m_Uint32DataPools[sizeClass]);
 #if VG_CONFIG_UV_INT16
-		const bgfx::Memory* uvMem = bgfx::makeRef(vb->m_UV, sizeof(int16_t) * 2 * vb->m_Count, releaseVertexBufferDataCallback_UV, ctx);
+		const bgfx::Memory* uvMem = bgfx::makeRef(vb->m_UV, sizeof(int16_t) * 2 * vb->m_Count, releaseVertexBufferDataCallback, &ctx->m_UVDataPools[sizeClass]);
 #else
-		const bgfx::Memory* uvMem = bgfx::makeRef(vb->m_UV, sizeof(float) * 2 * vb->m_Count, releaseVertexBufferDataCallback_Vec2, ctx);
+		const bgfx::Memory* uvMem = bgfx::makeRef(vb->m_UV, sizeof(float) * 2 * vb->m_Count, releaseVertexBufferDataCallback, &ctx->m_Vec2DataPools[sizeClass]);
 #endif
 
 		bgfx::update(gpuvb->m_PosBufferHandle, 0, posMem);
@@ -1133,177 +1612,78 @@ void end(Context* ctx)
 	// Update bgfx index buffer...
 	IndexBuffer* ib = &ctx->m_IndexBuffers[ctx->m_ActiveIndexBufferID];
 	GPUIndexBuffer* gpuib = &ctx->m_GPUIndexBuffers[ctx->m_ActiveIndexBufferID];
-	const bgfx::Memory* indexMem = bgfx::makeRef(&ib->m_Indices[0], sizeof(uint16_t) * ib->m_Count, releaseIndexBufferCallback, ctx);
-	if (!bgfx::isValid(gpuib->m_bgfxHandle)) {
-		gpuib->m_bgfxHandle = bgfx::createDynamicIndexBuffer(indexMem, BGFX_BUFFER_ALLOW_RESIZE);
-	} else {
-		bgfx::update(gpuib->m_bgfxHandle, 0, indexMem);
+	bool transientIB = false;
+#if VG_CONFIG_TRANSIENT_BUFFERS
+	const bool isIndex32 = sizeof(index_t) == sizeof(uint32_t);
+	if (ib->m_Count != 0 && bgfx::getAvailTransientIndexBuffer(ib->m_Count, isIndex32) >= ib->m_Count) {
+		bgfx::allocTransientIndexBuffer(&ctx->m_TransientIndexBuffer, ib->m_Count, isIndex32);
+		bx::memCopy(ctx->m_TransientIndexBuffer.data, ib->m_Indices, sizeof(index_t) * ib->m_Count);
+		releaseIndexBuffer(ctx, ib->m_Node);
+		transientIB = true;
+	}
+	ctx->m_IsTransientIndexBuffer = transientIB;
+#endif
+
+	// NOTE: The index buffer is empty if all draw commands reference the static buffers of cached command lists.
+	if (!transientIB && ib->m_Count == 0) {
+		releaseIndexBuffer(ctx, ib->m_Node);
+	} else if (!transientIB) {
+		const bgfx::Memory* indexMem = bgfx::makeRef(&ib->m_Indices[0], sizeof(index_t) * ib->m_Count, releaseIndexBufferCallback, ib->m_Node);
+		if (!bgfx::isValid(gpuib->m_bgfxHandle)) {
+#if VG_CONFIG_UINT32_INDICES
+			gpuib->m_bgfxHandle = bgfx::createDynamicIndexBuffer(indexMem, BGFX_BUFFER_ALLOW_RESIZE | BGFX_BUFFER_INDEX32);
+#else
+			gpuib->m_bgfxHandle = bgfx::createDynamicIndexBuffer(indexMem, BGFX_BUFFER_ALLOW_RESIZE);
+#endif
+		} else {
+			bgfx::update(gpuib->m_bgfxHandle, 0, indexMem);
+		}
 	}
 
 	const uint16_t viewID = ctx->m_ViewID;
-	const uint16_t canvasWidth = ctx->m_CanvasWidth;
-	const uint16_t canvasHeight = ctx->m_CanvasHeight;
-	const float devicePixelRatio = ctx->m_DevicePixelRatio;
-
 	if (ctx->m_Config.m_ResetViewTransformOnEnd) {
 		float viewMtx[16];
 		float projMtx[16];
 		bx::mtxIdentity(viewMtx);
-		bx::mtxOrtho(projMtx, 0.0f, (float)canvasWidth, (float)canvasHeight, 0.0f, 0.0f, 1.0f, 0.0f, bgfx::getCaps()->homogeneousDepth);
+		bx::mtxOrtho(projMtx, 0.0f, (float)ctx->m_CanvasWidth, (float)ctx->m_CanvasHeight, 0.0f, 0.0f, 1.0f, 0.0f, bgfx::getCaps()->homogeneousDepth);
 		bgfx::setViewTransform(viewID, viewMtx, projMtx);
+		submitDrawCommands(ctx, viewID, viewMtx, projMtx);
+	} else {
+		submitDrawCommands(ctx, viewID, nullptr, nullptr);
 	}
+}
 
-	uint16_t prevScissorRect[4] = { 0, 0, canvasWidth, canvasHeight};
-	uint16_t prevScissorID = UINT16_MAX;
-	uint32_t prevClipCmdID = UINT32_MAX;
-	uint32_t stencilState = BGFX_STENCIL_NONE;
-	uint8_t nextStencilValue = 1;
+void resubmitFrame(Context* ctx, uint16_t viewID, const float* viewMtx, const float* projMtx)
+{
+	VG_CHECK(ctx->m_CanResubmitFrame, "resubmitFrame() must be called between end() and the next frame()/begin()");
 
-	for (uint32_t iCmd = 0; iCmd < numDrawCommands; ++iCmd) {
-		DrawCommand* cmd = &ctx->m_DrawCommands[iCmd];
+	if (viewMtx || projMtx) {
+		bgfx::setViewTransform(viewID, viewMtx, projMtx);
+	}
 
-		const ClipState* cmdClipState = &cmd->m_ClipState;
-		if (cmdClipState->m_FirstCmdID != prevClipCmdID) {
-			prevClipCmdID = cmdClipState->m_FirstCmdID;
-			const uint32_t numClipCommands = cmdClipState->m_NumCmds;
-			if (numClipCommands) {
-				for (uint32_t iClip = 0; iClip < numClipCommands; ++iClip) {
-					VG_CHECK(cmdClipState->m_FirstCmdID + iClip < ctx->m_NumClipCommands, "Invalid clip command index");
+	submitDrawCommands(ctx, viewID, viewMtx, projMtx);
+}
 
-					DrawCommand* clipCmd = &ctx->m_ClipCommands[cmdClipState->m_FirstCmdID + iClip];
+void frame(Context* ctx)
+{
+	ctx->m_NumVertexBuffers = 0;
 
-					GPUVertexBuffer* gpuvb = &ctx->m_GPUVertexBuffers[clipCmd->m_VertexBufferID];
-					bgfx::setVertexBuffer(0, gpuvb->m_PosBufferHandle, clipCmd->m_FirstVertexID, clipCmd->m_NumVertices);
-					bgfx::setIndexBuffer(gpuib->m_bgfxHandle, clipCmd->m_FirstIndexID, clipCmd->m_NumIndices);
+	// The last frame's transient and makeRef'd buffers are gone after bgfx::frame().
+	ctx->m_CanResubmitFrame = false;
 
-					// Set scissor.
-					{
-						const uint16_t* cmdScissorRect = &clipCmd->m_ScissorRect[0];
-						if (!bx::memCmp(cmdScissorRect, &prevScissorRect[0], sizeof(uint16_t) * 4)) {
-							bgfx::setScissor(prevScissorID);
-						} else {
-							prevScissorID = bgfx::setScissor(cmdScissorRect[0] * devicePixelRatio, cmdScissorRect[1] * devicePixelRatio, cmdScissorRect[2] * devicePixelRatio, cmdScissorRect[3] * devicePixelRatio);
-							bx::memCopy(prevScissorRect, cmdScissorRect, sizeof(uint16_t) * 4);
-						}
-					}
+	if (ctx->m_FontImageID != 0) {
+		ImageHandle fontImage = ctx->m_FontImages[ctx->m_FontImageID];
 
-					VG_CHECK(clipCmd->m_Type == DrawCommand::Type::Clip, "Invalid clip command");
-					VG_CHECK(clipCmd->m_HandleID == UINT16_MAX, "Invalid clip command image handle");
+		// delete images that smaller than current one
+		if (isValid(fontImage)) {
+			uint16_t iw, ih;
+			getImageSize(ctx, fontImage, &iw, &ih);
 
-					bgfx::setState(0);
-					bgfx::setStencil(0
-						| BGFX_STENCIL_TEST_ALWAYS                // pass always
-						| BGFX_STENCIL_FUNC_REF(nextStencilValue) // value = nextStencilValue
-						| BGFX_STENCIL_FUNC_RMASK(0xff)
-						| BGFX_STENCIL_OP_FAIL_S_REPLACE
-						| BGFX_STENCIL_OP_FAIL_Z_REPLACE
-						| BGFX_STENCIL_OP_PASS_Z_REPLACE, BGFX_STENCIL_NONE);
-
-					// TODO: Check if it's better to use Type_TexturedVertexColor program here to avoid too many 
-					// state switches.
-					bgfx::submit(viewID, ctx->m_ProgramHandle[DrawCommand::Type::Clip]);
-				}
-
-				stencilState = 0
-					| (cmdClipState->m_Rule == ClipRule::In ? BGFX_STENCIL_TEST_EQUAL : BGFX_STENCIL_TEST_NOTEQUAL)
-					| BGFX_STENCIL_FUNC_REF(nextStencilValue)
-					| BGFX_STENCIL_FUNC_RMASK(0xff)
-					| BGFX_STENCIL_OP_FAIL_S_KEEP
-					| BGFX_STENCIL_OP_FAIL_Z_KEEP
-					| BGFX_STENCIL_OP_PASS_Z_KEEP;
-
-				++nextStencilValue;
-			} else {
-				stencilState = BGFX_STENCIL_NONE;
-			}
-		}
-
-		GPUVertexBuffer* gpuvb = &ctx->m_GPUVertexBuffers[cmd->m_VertexBufferID];
-		bgfx::setVertexBuffer(0, gpuvb->m_PosBufferHandle, cmd->m_FirstVertexID, cmd->m_NumVertices);
-		bgfx::setVertexBuffer(1, gpuvb->m_ColorBufferHandle, cmd->m_FirstVertexID, cmd->m_NumVertices);
-		bgfx::setIndexBuffer(gpuib->m_bgfxHandle, cmd->m_FirstIndexID, cmd->m_NumIndices);
-
-		// Set scissor.
-		{
-			const uint16_t* cmdScissorRect = &cmd->m_ScissorRect[0];
-			if (!bx::memCmp(cmdScissorRect, &prevScissorRect[0], sizeof(uint16_t) * 4)) {
-				bgfx::setScissor(prevScissorID);
-			} else {
-				prevScissorID = bgfx::setScissor(cmdScissorRect[0] * devicePixelRatio, cmdScissorRect[1] * devicePixelRatio, cmdScissorRect[2] * devicePixelRatio, cmdScissorRect[3] * devicePixelRatio);
-				bx::memCopy(prevScissorRect, cmdScissorRect, sizeof(uint16_t) * 4);
-			}
-		}
-
-		if (cmd->m_Type == DrawCommand::Type::Textured) {
-			VG_CHECK(cmd->m_HandleID != UINT16_MAX, "Invalid image handle");
-			Image* tex = &ctx->m_Images[cmd->m_HandleID];
-
-			bgfx::setVertexBuffer(2, gpuvb->m_UVBufferHandle, cmd->m_FirstVertexID, cmd->m_NumVertices);
-			bgfx::setTexture(0, ctx->m_TexUniform, tex->m_bgfxHandle, tex->m_Flags);
-
-			bgfx::setState(0
-				| BGFX_STATE_WRITE_A
-				| BGFX_STATE_WRITE_RGB
-				| BGFX_STATE_BLEND_FUNC_SEPARATE(BGFX_STATE_BLEND_SRC_ALPHA, BGFX_STATE_BLEND_INV_SRC_ALPHA, BGFX_STATE_BLEND_ONE, BGFX_STATE_BLEND_INV_SRC_ALPHA));
-			bgfx::setStencil(stencilState);
-
-			bgfx::submit(viewID, ctx->m_ProgramHandle[DrawCommand::Type::Textured]);
-		} else if (cmd->m_Type == DrawCommand::Type::ColorGradient) {
-			VG_CHECK(cmd->m_HandleID != UINT16_MAX, "Invalid gradient handle");
-			Gradient* grad = &ctx->m_Gradients[cmd->m_HandleID];
-
-			bgfx::setUniform(ctx->m_PaintMatUniform, grad->m_Matrix, 1);
-			bgfx::setUniform(ctx->m_ExtentRadiusFeatherUniform, grad->m_Params, 1);
-			bgfx::setUniform(ctx->m_InnerColorUniform, grad->m_InnerColor, 1);
-			bgfx::setUniform(ctx->m_OuterColorUniform, grad->m_OuterColor, 1);
-
-			bgfx::setState(0
-				| BGFX_STATE_WRITE_A
-				| BGFX_STATE_WRITE_RGB
-				| BGFX_STATE_BLEND_FUNC_SEPARATE(BGFX_STATE_BLEND_SRC_ALPHA, BGFX_STATE_BLEND_INV_SRC_ALPHA, BGFX_STATE_BLEND_ONE, BGFX_STATE_BLEND_INV_SRC_ALPHA));
-			bgfx::setStencil(stencilState);
-
-			bgfx::submit(viewID, ctx->m_ProgramHandle[DrawCommand::Type::ColorGradient]);
-		} else if(cmd->m_Type == DrawCommand::Type::ImagePattern) {
-			VG_CHECK(cmd->m_HandleID != UINT16_MAX, "Invalid image pattern handle");
-			ImagePattern* imgPattern = &ctx->m_ImagePatterns[cmd->m_HandleID];
-
-			VG_CHECK(isValid(imgPattern->m_ImageHandle), "Invalid image handle in pattern");
-			Image* tex = &ctx->m_Images[imgPattern->m_ImageHandle.idx];
-
-			bgfx::setTexture(0, ctx->m_TexUniform, tex->m_bgfxHandle, tex->m_Flags);
-			bgfx::setUniform(ctx->m_PaintMatUniform, imgPattern->m_Matrix, 1);
-
-			bgfx::setState(0
-				| BGFX_STATE_WRITE_A
-				| BGFX_STATE_WRITE_RGB
-				| BGFX_STATE_BLEND_FUNC_SEPARATE(BGFX_STATE_BLEND_SRC_ALPHA, BGFX_STATE_BLEND_INV_SRC_ALPHA, BGFX_STATE_BLEND_ONE, BGFX_STATE_BLEND_INV_SRC_ALPHA));
-			bgfx::setStencil(stencilState);
-
-			bgfx::submit(viewID, ctx->m_ProgramHandle[DrawCommand::Type::ImagePattern]);
-		} else {
-			VG_CHECK(false, "Unknown draw command type");
-		}
-	}
-}
-
-void frame(Context* ctx)
-{
-	ctx->m_NumVertexBuffers = 0;
-
-	if (ctx->m_FontImageID != 0) {
-		ImageHandle fontImage = ctx->m_FontImages[ctx->m_FontImageID];
-
-		// delete images that smaller than current one
-		if (isValid(fontImage)) {
-			uint16_t iw, ih;
-			getImageSize(ctx, fontImage, &iw, &ih);
-
-			uint32_t j = 0;
-			for (uint32_t i = 0; i < ctx->m_FontImageID; i++) {
-				if (isValid(ctx->m_FontImages[i])) {
-					uint16_t nw, nh;
-					getImageSize(ctx, ctx->m_FontImages[i], &nw, &nh);
+			uint32_t j = 0;
+			for (uint32_t i = 0; i < ctx->m_FontImageID; i++) {
+				if (isValid(ctx->m_FontImages[i])) {
+					uint16_t nw, nh;
+					getImageSize(ctx, ctx->m_FontImages[i], &nw, &nh);
 
 					if (nw < iw || nh < ih) {
 						destroyImage(ctx, ctx->m_FontImages[i]);
@@ -1329,9 +1709,100 @@ void frame(Context* ctx)
 
 const Stats* getStats(Context* ctx)
 {
+	Stats* stats = &ctx->m_Stats;
+	stats->m_NumPooledVertexStreams = 0;
+	stats->m_NumPooledVertexStreamsUsed = 0;
+	for (uint32_t i = 0; i < ctx->m_NumVertexBufferSizeClasses; ++i) {
+		stats->m_NumPooledVertexStreams += ctx->m_Vec2DataPools[i].m_NumBuffers + ctx->m_Uint32DataPools[i].m_NumBuffers;
+		stats->m_NumPooledVertexStreamsUsed += (uint32_t)(ctx->m_Vec2DataPools[i].m_NumUsed + ctx->m_Uint32DataPools[i].m_NumUsed);
+#if VG_CONFIG_UV_INT16
+		stats->m_NumPooledVertexStreams += ctx->m_UVDataPools[i].m_NumBuffers;
+		stats->m_NumPooledVertexStreamsUsed += (uint32_t)ctx->m_UVDataPools[i].m_NumUsed;
+#endif
+	}
+	stats->m_PooledVertexMemory = ctx->m_PooledVertexMemory;
+	stats->m_PeakPooledVertexMemory = ctx->m_PeakPooledVertexMemory;
+	stats->m_FrameArenaSize = ctx->m_FrameArena.m_Size;
+	stats->m_FrameArenaUsed = ctx->m_FrameArena.m_Used;
+#if VG_CONFIG_ENABLE_SHAPE_CACHING
+	stats->m_CmdListCacheMemory = getCommandListCacheMemory(ctx);
+	stats->m_CmdListCacheMemoryEvicted = ctx->m_CmdListCacheMemoryEvicted;
+#endif
+	stats->m_NumPooledIndexBuffers = ctx->m_NumIndexBuffers;
+	stats->m_NumPooledIndexBuffersUsed = (uint32_t)ctx->m_NumIndexBuffersUsed;
+
+#if VG_CONFIG_ENABLE_TIMINGS
+	const double toMs = 1000.0 / (double)bx::getHPFrequency();
+	stats->m_PathTime = (float)(ctx->m_TimerTicks[Timer::Path] * toMs);
+	stats->m_FillTime = (float)(ctx->m_TimerTicks[Timer::Fill] * toMs);
+	stats->m_StrokeTime = (float)(ctx->m_TimerTicks[Timer::Stroke] * toMs);
+	stats->m_TextTime = (float)(ctx->m_TimerTicks[Timer::Text] * toMs);
+	stats->m_EndTime = (float)(ctx->m_TimerTicks[Timer::End] * toMs);
+	stats->m_RasterTime = (float)(ctx->m_TimerTicks[Timer::Raster] * toMs);
+#endif
+
 	return &ctx->m_Stats;
 }
 
+void trimMemory(Context* ctx)
+{
+	for (uint32_t i = 0; i < ctx->m_NumVertexBufferSizeClasses; ++i) {
+		dataPoolTrim(ctx, &ctx->m_Vec2DataPools[i], UINT32_MAX);
+		dataPoolTrim(ctx, &ctx->m_Uint32DataPools[i], UINT32_MAX);
+#if VG_CONFIG_UV_INT16
+		dataPoolTrim(ctx, &ctx->m_UVDataPools[i], UINT32_MAX);
+#endif
+	}
+
+	// Free the index arrays of the index buffers which aren't in use. Their IDs (and bgfx buffers) stay
+	// valid and the arrays are reallocated on demand by allocIndices().
+	IndexBufferNode* node = (IndexBufferNode*)releasedListPopAll(&ctx->m_ReleasedIndexBuffers);
+	while (node) {
+		IndexBufferNode* next = (IndexBufferNode*)(uintptr_t)node->m_Next;
+		node->m_Next = (uint64_t)(uintptr_t)ctx->m_IndexBufferFreeList;
+		ctx->m_IndexBufferFreeList = node;
+		node = next;
+	}
+
+	for (node = ctx->m_IndexBufferFreeList; node; node = (IndexBufferNode*)(uintptr_t)node->m_Next) {
+		IndexBuffer* ib = &ctx->m_IndexBuffers[node->m_ID];
+		bx::alignedFree(ctx->m_Allocator, ib->m_Indices, 16);
+		ib->m_Indices = nullptr;
+		ib->m_Capacity = 0;
+	}
+}
+
+#if VG_CONFIG_RECORD_DRAW_CALLS
+void setDrawCallCallback(Context* ctx, DrawCallCallback callback, void* userData)
+{
+	ctx->m_DrawCallCallback = callback;
+	ctx->m_DrawCallCallbackUserData = userData;
+}
+#endif
+
+#if VG_CONFIG_SOFTWARE_RASTERIZER
+void setRasterTarget(Context* ctx, const RasterTarget* target, uint32_t numThreads)
+{
+	VG_CHECK(!target || target->m_Data, "Invalid raster target");
+	VG_CHECK(!target || target->m_Pitch >= (uint32_t)target->m_Width * 4, "Invalid raster target pitch");
+
+	if (!target) {
+		if (ctx->m_Rasterizer) {
+			destroyRasterizer(ctx->m_Rasterizer);
+			ctx->m_Rasterizer = nullptr;
+		}
+
+		return;
+	}
+
+	if (!ctx->m_Rasterizer) {
+		ctx->m_Rasterizer = createRasterizer(ctx->m_Allocator);
+	}
+
+	rasterizerSetTarget(ctx->m_Rasterizer, target, numThreads);
+}
+#endif
+
 void beginPath(Context* ctx)
 {
 #if VG_CONFIG_COMMAND_LIST_BEGIN_END_API
@@ -2234,6 +2705,16 @@ ImageHandle createImage(Context* ctx, uint16_t w, uint16_t h, uint32_t flags, co
 		bgfx::updateTexture2D(tex->m_bgfxHandle, 0, 0, 0, 0, tex->m_Width, tex->m_Height, mem);
 	}
 
+#if VG_CONFIG_SOFTWARE_RASTERIZER
+	const uint32_t rasterDataSize = sizeof(uint32_t) * tex->m_Width * tex->m_Height;
+	tex->m_RasterData = (uint32_t*)bx::alloc(ctx->m_Allocator, rasterDataSize);
+	if (data) {
+		bx::memCopy(tex->m_RasterData, data, rasterDataSize);
+	} else {
+		bx::memSet(tex->m_RasterData, 0, rasterDataSize);
+	}
+#endif
+
 	return handle;
 }
 
@@ -2289,6 +2770,14 @@ bool updateImage(Context* ctx, ImageHandle image, uint16_t x, uint16_t y, uint16
 
 	bgfx::updateTexture2D(tex->m_bgfxHandle, 0, 0, x, y, w, h, mem, UINT16_MAX);
 
+#if VG_CONFIG_SOFTWARE_RASTERIZER
+	if (tex->m_RasterData) {
+		for (uint32_t row = 0; row < h; ++row) {
+			bx::memCopy(&tex->m_RasterData[(y + row) * tex->m_Width + x], data + (y + row) * pitch + x * bytesPerPixel, w * bytesPerPixel);
+		}
+	}
+#endif
+
 	return true;
 }
 
@@ -2303,6 +2792,9 @@ bool destroyImage(Context* ctx, ImageHandle img)
 		VG_CHECK(bgfx::isValid(tex->m_bgfxHandle), "Invalid texture handle");
 		bgfx::destroy(tex->m_bgfxHandle);
 	}
+#if VG_CONFIG_SOFTWARE_RASTERIZER
+	bx::free(ctx->m_Allocator, tex->m_RasterData);
+#endif
 	resetImage(tex);
 
 	ctx->m_ImageHandleAlloc->free(img.idx);
@@ -2343,6 +2835,7 @@ void destroyCommandList(Context* ctx, CommandListHandle handle)
 	bx::AllocatorI* allocator = ctx->m_Allocator;
 
 	CommandList* cl = &ctx->m_CmdLists[handle.idx];
+	VG_CHECK(bx::atomicFetchAndAdd<int32_t>(&cl->m_DebugNumWriters, 0) == 0, "Command list is still being recorded on another thread");
 
 #if VG_CONFIG_ENABLE_SHAPE_CACHING
 	if (cl->m_Cache) {
@@ -2350,11 +2843,14 @@ void destroyCommandList(Context* ctx, CommandListHandle handle)
 	}
 #endif
 
-	ctx->m_Stats.m_CmdListMemoryTotal -= cl->m_CommandBufferCapacity;
-	ctx->m_Stats.m_CmdListMemoryUsed -= cl->m_CommandBufferPos;
+	ctx->m_Stats.m_CmdListMemoryTotal -= cl->m_MergedMemoryTotal;
+	ctx->m_Stats.m_CmdListMemoryUsed -= cl->m_MergedMemoryUsed;
 
 	bx::alignedFree(allocator, cl->m_CommandBuffer, VG_CONFIG_COMMAND_LIST_ALIGNMENT);
 	bx::free(allocator, cl->m_StringBuffer);
+#if VG_CONFIG_COMMAND_LIST_AUTO_CACHING
+	bx::free(allocator, cl->m_PrevContent);
+#endif
 	bx::memSet(cl, 0, sizeof(CommandList));
 
 	ctx->m_CmdListHandleAlloc->free(handle.idx);
@@ -2366,18 +2862,49 @@ void resetCommandList(Context* ctx, CommandListHandle handle)
 	CommandList* cl = &ctx->m_CmdLists[handle.idx];
 
 #if VG_CONFIG_ENABLE_SHAPE_CACHING
-	if (cl->m_Cache) {
+	// Automatic caches are validated against the list's content hash on the next submit.
+	if (cl->m_Cache && (cl->m_Flags & CommandListFlags::Cacheable) != 0) {
 		clCacheReset(ctx, cl->m_Cache);
 	}
-#else
-	BX_UNUSED(ctx);
 #endif
 
-	ctx->m_Stats.m_CmdListMemoryUsed -= cl->m_CommandBufferPos;
 	cl->m_CommandBufferPos = 0;
 	cl->m_StringBufferPos = 0;
 	cl->m_NumImagePatterns = 0;
 	cl->m_NumGradients = 0;
+	clMergeStats(ctx, cl);
+}
+
+void reserveCommandList(Context* ctx, CommandListHandle handle, uint32_t cmdBytes, uint32_t stringBytes)
+{
+	VG_CHECK(isValid(handle), "Invalid command list handle");
+	CommandList* cl = &ctx->m_CmdLists[handle.idx];
+
+	if (cmdBytes > cl->m_CommandBufferCapacity) {
+		clResizeCommandBuffer(ctx, cl, cmdBytes);
+	}
+
+	if (stringBytes > cl->m_StringBufferCapacity) {
+		clResizeStringBuffer(ctx, cl, stringBytes);
+	}
+
+	clMergeStats(ctx, cl);
+}
+
+void shrinkCommandList(Context* ctx, CommandListHandle handle)
+{
+	VG_CHECK(isValid(handle), "Invalid command list handle");
+	CommandList* cl = &ctx->m_CmdLists[handle.idx];
+
+	if (cl->m_CommandBufferPos != cl->m_CommandBufferCapacity) {
+		clResizeCommandBuffer(ctx, cl, cl->m_CommandBufferPos);
+	}
+
+	if (cl->m_StringBufferPos != cl->m_StringBufferCapacity) {
+		clResizeStringBuffer(ctx, cl, cl->m_StringBufferPos);
+	}
+
+	clMergeStats(ctx, cl);
 }
 
 #if VG_CONFIG_COMMAND_LIST_BEGIN_END_API
@@ -2400,6 +2927,59 @@ void endCommandList(Context* ctx)
 }
 #endif
 
+#if VG_CONFIG_ENABLE_SHAPE_CACHING
+Tesselator* createTesselator(Context* ctx)
+{
+	bx::AllocatorI* allocator = ctx->m_Allocator;
+
+	Tesselator* tess = (Tesselator*)bx::alloc(allocator, sizeof(Tesselator));
+	bx::memSet(tess, 0, sizeof(Tesselator));
+
+	tess->m_Path = createPath(allocator);
+	tess->m_Stroker = createStroker(allocator);
+	tess->m_StateStack = (State*)bx::alloc(allocator, sizeof(State) * ctx->m_Config.m_MaxStateStackSize);
+
+	return tess;
+}
+
+void destroyTesselator(Context* ctx, Tesselator* tess)
+{
+	bx::AllocatorI* allocator = ctx->m_Allocator;
+
+	destroyPath(tess->m_Path);
+	destroyStroker(tess->m_Stroker);
+	bx::free(allocator, tess->m_StateStack);
+	bx::alignedFree(allocator, tess->m_TransformedVertices, 16);
+	bx::free(allocator, tess);
+}
+
+bool tesselateCommandList(Context* ctx, Tesselator* tess, CommandListHandle handle, const float* mtx)
+{
+	VG_CHECK(isValid(handle), "Invalid command list handle");
+	CommandList* cl = &ctx->m_CmdLists[handle.idx];
+
+	CommandListCache* cache = clGetCache(ctx, cl);
+	if (!cache) {
+		return false;
+	}
+
+	State* state = &tess->m_StateStack[0];
+	bx::memSet(state, 0, sizeof(State));
+	bx::memCopy(state->m_TransformMtx, mtx, sizeof(float) * 6);
+	state->m_GlobalAlpha = 1.0f;
+	updateState(state);
+
+	tess->m_StateStackTop = 0;
+	tess->m_SubmitCmdListRecursionDepth = 0;
+	tess->m_PathTransformed = false;
+	tess->m_RecordClipCommands = false;
+
+	tessSubmitCommandList(ctx, tess, cl);
+
+	return true;
+}
+#endif
+
 void clBeginPath(Context* ctx, CommandListHandle handle)
 {
 	VG_CHECK(isValid(handle), "Invalid command list handle");
@@ -2413,6 +2993,13 @@ void clMoveTo(Context* ctx, CommandListHandle handle, float x, float y)
 	VG_CHECK(isValid(handle), "Invalid command list handle");
 	CommandList* cl = &ctx->m_CmdLists[handle.idx];
 
+#if VG_CONFIG_COMMAND_LIST_FIXED_POINT_BITS
+	const float coords[2] = { x, y };
+	if (clStoreFixedPointCommand(ctx, cl, CommandType::MoveToFixed, coords, 2)) {
+		return;
+	}
+#endif
+
 	uint8_t* ptr = clAllocCommand(ctx, cl, CommandType::MoveTo, sizeof(float) * 2);
 	CMD_WRITE(ptr, float, x);
 	CMD_WRITE(ptr, float, y);
@@ -2423,6 +3010,13 @@ void clLineTo(Context* ctx, CommandListHandle handle, float x, float y)
 	VG_CHECK(isValid(handle), "Invalid command list handle");
 	CommandList* cl = &ctx->m_CmdLists[handle.idx];
 
+#if VG_CONFIG_COMMAND_LIST_FIXED_POINT_BITS
+	const float coords[2] = { x, y };
+	if (clStoreFixedPointCommand(ctx, cl, CommandType::LineToFixed, coords, 2)) {
+		return;
+	}
+#endif
+
 	uint8_t* ptr = clAllocCommand(ctx, cl, CommandType::LineTo, sizeof(float) * 2);
 	CMD_WRITE(ptr, float, x);
 	CMD_WRITE(ptr, float, y);
@@ -2433,6 +3027,13 @@ void clCubicTo(Context* ctx, CommandListHandle handle, float c1x, float c1y, flo
 	VG_CHECK(isValid(handle), "Invalid command list handle");
 	CommandList* cl = &ctx->m_CmdLists[handle.idx];
 
+#if VG_CONFIG_COMMAND_LIST_FIXED_POINT_BITS
+	const float coords[6] = { c1x, c1y, c2x, c2y, x, y };
+	if (clStoreFixedPointCommand(ctx, cl, CommandType::CubicToFixed, coords, 6)) {
+		return;
+	}
+#endif
+
 	uint8_t* ptr = clAllocCommand(ctx, cl, CommandType::CubicTo, sizeof(float) * 6);
 	CMD_WRITE(ptr, float, c1x);
 	CMD_WRITE(ptr, float, c1y);
@@ -2447,6 +3048,13 @@ void clQuadraticTo(Context* ctx, CommandListHandle handle, float cx, float cy, f
 	VG_CHECK(isValid(handle), "Invalid command list handle");
 	CommandList* cl = &ctx->m_CmdLists[handle.idx];
 
+#if VG_CONFIG_COMMAND_LIST_FIXED_POINT_BITS
+	const float coords[4] = { cx, cy, x, y };
+	if (clStoreFixedPointCommand(ctx, cl, CommandType::QuadraticToFixed, coords, 4)) {
+		return;
+	}
+#endif
+
 	uint8_t* ptr = clAllocCommand(ctx, cl, CommandType::QuadraticTo, sizeof(float) * 4);
 	CMD_WRITE(ptr, float, cx);
 	CMD_WRITE(ptr, float, cy);
@@ -2550,6 +3158,12 @@ void clPolyline(Context* ctx, CommandListHandle handle, const float* coords, uin
 	VG_CHECK(isValid(handle), "Invalid command list handle");
 	CommandList* cl = &ctx->m_CmdLists[handle.idx];
 
+#if VG_CONFIG_COMMAND_LIST_FIXED_POINT_BITS
+	if (clStoreFixedPointCommand(ctx, cl, CommandType::PolylineFixed, coords, numPoints * 2)) {
+		return;
+	}
+#endif
+
 	uint8_t* ptr = clAllocCommand(ctx, cl, CommandType::Polyline, sizeof(uint32_t) + sizeof(float) * 2 * numPoints);
 	CMD_WRITE(ptr, uint32_t, numPoints);
 	bx::memCopy(ptr, coords, sizeof(float) * 2 * numPoints);
@@ -2968,6 +3582,7 @@ void clSubmitCommandList(Context* ctx, CommandListHandle parent, CommandListHand
 // Context
 static void ctxBeginPath(Context* ctx)
 {
+	VG_SCOPED_TIMER(ctx, Timer::Path);
 	const State* state = getState(ctx);
 	const float avgScale = state->m_AvgScale;
 	const float testTol = ctx->m_TesselationTolerance;
@@ -2982,84 +3597,98 @@ static void ctxBeginPath(Context* ctx)
 
 static void ctxMoveTo(Context* ctx, float x, float y)
 {
+	VG_SCOPED_TIMER(ctx, Timer::Path);
 	VG_CHECK(!ctx->m_PathTransformed, "Call beginPath() before starting a new path");
 	pathMoveTo(ctx->m_Path, x, y);
 }
 
 static void ctxLineTo(Context* ctx, float x, float y)
 {
+	VG_SCOPED_TIMER(ctx, Timer::Path);
 	VG_CHECK(!ctx->m_PathTransformed, "Call beginPath() before starting a new path");
 	pathLineTo(ctx->m_Path, x, y);
 }
 
 static void ctxCubicTo(Context* ctx, float c1x, float c1y, float c2x, float c2y, float x, float y)
 {
+	VG_SCOPED_TIMER(ctx, Timer::Path);
 	VG_CHECK(!ctx->m_PathTransformed, "Call beginPath() before starting a new path");
 	pathCubicTo(ctx->m_Path, c1x, c1y, c2x, c2y, x, y);
 }
 
 static void ctxQuadraticTo(Context* ctx, float cx, float cy, float x, float y)
 {
+	VG_SCOPED_TIMER(ctx, Timer::Path);
 	VG_CHECK(!ctx->m_PathTransformed, "Call beginPath() before starting a new path");
 	pathQuadraticTo(ctx->m_Path, cx, cy, x, y);
 }
 
 static void ctxArc(Context* ctx, float cx, float cy, float r, float a0, float a1, Winding::Enum dir)
 {
+	VG_SCOPED_TIMER(ctx, Timer::Path);
 	VG_CHECK(!ctx->m_PathTransformed, "Call beginPath() before starting a new path");
 	pathArc(ctx->m_Path, cx, cy, r, a0, a1, dir);
 }
 
 static void ctxArcTo(Context* ctx, float x1, float y1, float x2, float y2, float r)
 {
+	VG_SCOPED_TIMER(ctx, Timer::Path);
 	VG_CHECK(!ctx->m_PathTransformed, "Call beginPath() before starting a new path");
 	pathArcTo(ctx->m_Path, x1, y1, x2, y2, r);
 }
 
 static void ctxRect(Context* ctx, float x, float y, float w, float h)
 {
+	VG_SCOPED_TIMER(ctx, Timer::Path);
 	VG_CHECK(!ctx->m_PathTransformed, "Call beginPath() before starting a new path");
 	pathRect(ctx->m_Path, x, y, w, h);
 }
 
 static void ctxRoundedRect(Context* ctx, float x, float y, float w, float h, float r)
 {
+	VG_SCOPED_TIMER(ctx, Timer::Path);
 	VG_CHECK(!ctx->m_PathTransformed, "Call beginPath() before starting a new path");
 	pathRoundedRect(ctx->m_Path, x, y, w, h, r);
 }
 
 static void ctxRoundedRectVarying(Context* ctx, float x, float y, float w, float h, float rtl, float rtr, float rbr, float rbl)
 {
+	VG_SCOPED_TIMER(ctx, Timer::Path);
 	VG_CHECK(!ctx->m_PathTransformed, "Call beginPath() before starting a new path");
 	pathRoundedRectVarying(ctx->m_Path, x, y, w, h, rtl, rtr, rbr, rbl);
 }
 
 static void ctxCircle(Context* ctx, float cx, float cy, float radius)
 {
+	VG_SCOPED_TIMER(ctx, Timer::Path);
 	VG_CHECK(!ctx->m_PathTransformed, "Call beginPath() before starting a new path");
 	pathCircle(ctx->m_Path, cx, cy, radius);
 }
 
 static void ctxEllipse(Context* ctx, float cx, float cy, float rx, float ry)
 {
+	VG_SCOPED_TIMER(ctx, Timer::Path);
 	VG_CHECK(!ctx->m_PathTransformed, "Call beginPath() before starting a new path");
 	pathEllipse(ctx->m_Path, cx, cy, rx, ry);
 }
 
 static void ctxPolyline(Context* ctx, const float* coords, uint32_t numPoints)
 {
+	VG_SCOPED_TIMER(ctx, Timer::Path);
 	VG_CHECK(!ctx->m_PathTransformed, "Call beginPath() before starting a new path");
 	pathPolyline(ctx->m_Path, coords, numPoints);
 }
 
 static void ctxClosePath(Context* ctx)
 {
+	VG_SCOPED_TIMER(ctx, Timer::Path);
 	VG_CHECK(!ctx->m_PathTransformed, "Call beginPath() before starting a new path");
 	pathClose(ctx->m_Path);
 }
 
 static void ctxFillPathColor(Context* ctx, Color color, uint32_t flags)
 {
+	VG_SCOPED_TIMER(ctx, Timer::Fill);
 	const bool recordClipCommands = ctx->m_RecordClipCommands;
 #if VG_CONFIG_ENABLE_SHAPE_CACHING
 	const bool hasCache = getCommandListCacheStackTop(ctx) != nullptr;
@@ -3074,218 +3703,138 @@ static void ctxFillPathColor(Context* ctx, Color color, uint32_t flags)
 		return;
 	}
 
-	const float* pathVertices = transformPath(ctx);
-
 #if VG_CONFIG_FORCE_AA_OFF
 	const bool aa = false;
 #else
 	const bool aa = recordClipCommands ? false : VG_FILL_FLAGS_AA(flags);
 #endif
-	const PathType::Enum pathType = VG_FILL_FLAGS_PATH_TYPE(flags);
-	const FillRule::Enum fillRule = VG_FILL_FLAGS_RULE(flags);
 
-	const Path* path = ctx->m_Path;
-	const uint32_t numSubPaths = pathGetNumSubPaths(path);
-	const SubPath* subPaths = pathGetSubPaths(path);
-	Stroker* stroker = ctx->m_Stroker;
+	const PathMeshTarget target = { ctx, recordClipCommands ? DrawCommand::Type::Clip : DrawCommand::Type::Textured, 0, hasCache };
+	ctxFillPath(ctx, &target, flags, col, aa);
+}
+
+static void ctxFillPathGradient(Context* ctx, GradientHandle gradientHandle, uint32_t flags)
+{
+	VG_SCOPED_TIMER(ctx, Timer::Fill);
+	VG_CHECK(!ctx->m_RecordClipCommands, "Only fillPath(Color) is supported inside BeginClip()/EndClip()");
+	VG_CHECK(isValid(gradientHandle), "Invalid gradient handle");
+	VG_CHECK(!isLocal(gradientHandle), "Invalid gradient handle");
 
 #if VG_CONFIG_ENABLE_SHAPE_CACHING
-	if (hasCache) {
-		beginCachedCommand(ctx);
-	}
+	const bool hasCache = getCommandListCacheStackTop(ctx) != nullptr;
+#else
+	const bool hasCache = false;
 #endif
 
-	if (pathType == PathType::Convex) {
-		for (uint32_t i = 0; i < numSubPaths; ++i) {
-			const SubPath* subPath = &subPaths[i];
-			if (subPath->m_NumVertices < 3) {
-				continue;
-			}
+	// Cached gradient geometry is always opaque black (see submitCachedMesh()).
+	const State* state = getState(ctx);
+	const Color black = hasCache ? Colors::Black : colorSetAlpha(Colors::Black, (uint8_t)(0xff * state->m_GlobalAlpha));
 
-			const float* vtx = &pathVertices[subPath->m_FirstVertexID << 1];
-			const uint32_t numPathVertices = subPath->m_NumVertices;
+#if VG_CONFIG_FORCE_AA_OFF
+	const bool aa = false;
+#else
+	const bool aa = VG_FILL_FLAGS_AA(flags);
+#endif
 
-			Mesh mesh;
-			const uint32_t* colors = &col;
-			uint32_t numColors = 1;
+	const PathMeshTarget target = { ctx, DrawCommand::Type::ColorGradient, gradientHandle.idx, hasCache };
+	ctxFillPath(ctx, &target, flags, black, aa);
+}
 
-			if (aa) {
-				strokerConvexFillAA(stroker, &mesh, vtx, numPathVertices, col);
-				colors = mesh.m_ColorBuffer;
-				numColors = mesh.m_NumVertices;
-			} else {
-				strokerConvexFill(stroker, &mesh, vtx, numPathVertices);
-			}
+static void ctxFillPathImagePattern(Context* ctx, ImagePatternHandle imgPatternHandle, Color color, uint32_t flags)
+{
+	VG_SCOPED_TIMER(ctx, Timer::Fill);
+	VG_CHECK(!ctx->m_RecordClipCommands, "Only fillPath(Color) is supported inside BeginClip()/EndClip()");
+	VG_CHECK(isValid(imgPatternHandle), "Invalid image pattern handle");
+	VG_CHECK(!isLocal(imgPatternHandle), "Invalid gradient handle");
 
 #if VG_CONFIG_ENABLE_SHAPE_CACHING
-			if (hasCache) {
-				addCachedCommand(ctx, mesh.m_PosBuffer, mesh.m_NumVertices, colors, numColors, mesh.m_IndexBuffer, mesh.m_NumIndices);
-			}
+	const bool hasCache = getCommandListCacheStackTop(ctx) != nullptr;
+#else
+	const bool hasCache = false;
 #endif
 
-			if (recordClipCommands) {
-				createDrawCommand_Clip(ctx, mesh.m_PosBuffer, mesh.m_NumVertices, mesh.m_IndexBuffer, mesh.m_NumIndices);
-			} else {
-				createDrawCommand_VertexColor(ctx, mesh.m_PosBuffer, mesh.m_NumVertices, colors, numColors, mesh.m_IndexBuffer, mesh.m_NumIndices);
-			}
-		}
-	} else if (pathType == PathType::Concave) {
-		strokerConcaveFillBegin(stroker);
-		for (uint32_t i = 0; i < numSubPaths; ++i) {
-			const SubPath* subPath = &subPaths[i];
-			if (subPath->m_NumVertices < 3) {
-				return;
-			}
-
-			const float* vtx = &pathVertices[subPath->m_FirstVertexID << 1];
-			const uint32_t numPathVertices = subPath->m_NumVertices;
-			strokerConcaveFillAddContour(stroker, vtx, numPathVertices);
-		}
-
-		Mesh mesh;
-		const uint32_t* colors = &col;
-		uint32_t numColors = 1;
-
-		bool decomposed = false;
-		if (aa) {
-			decomposed = strokerConcaveFillEndAA(stroker, &mesh, col, fillRule);
-			colors = mesh.m_ColorBuffer;
-			numColors = mesh.m_NumVertices;
-		} else {
-			decomposed = strokerConcaveFillEnd(stroker, &mesh, fillRule);
-		}
-
-		VG_WARN(decomposed, "Failed to triangulate concave polygon");
-		if (decomposed) {
-#if VG_CONFIG_ENABLE_SHAPE_CACHING
-			if (hasCache) {
-				addCachedCommand(ctx, mesh.m_PosBuffer, mesh.m_NumVertices, colors, numColors, mesh.m_IndexBuffer, mesh.m_NumIndices);
-			}
-#endif
-
-			if (recordClipCommands) {
-				createDrawCommand_Clip(ctx, mesh.m_PosBuffer, mesh.m_NumVertices, mesh.m_IndexBuffer, mesh.m_NumIndices);
-			} else {
-				createDrawCommand_VertexColor(ctx, mesh.m_PosBuffer, mesh.m_NumVertices, colors, numColors, mesh.m_IndexBuffer, mesh.m_NumIndices);
-			}
-		}
+	const State* state = getState(ctx);
+	const float globalAlpha = hasCache ? 1.0f : state->m_GlobalAlpha;
+	const Color col = colorSetAlpha(color, (uint8_t)(globalAlpha * colorGetAlpha(color)));
+	if (!hasCache && colorGetAlpha(col) == 0) {
+		return;
 	}
 
-#if VG_CONFIG_ENABLE_SHAPE_CACHING
-	if (hasCache) {
-		endCachedCommand(ctx);
-	}
+#if VG_CONFIG_FORCE_AA_OFF
+	const bool aa = false;
+#else
+	const bool aa = VG_FILL_FLAGS_AA(flags);
 #endif
+
+	const PathMeshTarget target = { ctx, DrawCommand::Type::ImagePattern, imgPatternHandle.idx, hasCache };
+	ctxFillPath(ctx, &target, flags, col, aa);
 }
 
-static void ctxFillPathGradient(Context* ctx, GradientHandle gradientHandle, uint32_t flags)
+static void ctxStrokePathColor(Context* ctx, Color color, float width, uint32_t flags)
 {
-	VG_CHECK(!ctx->m_RecordClipCommands, "Only fillPath(Color) is supported inside BeginClip()/EndClip()");
-	VG_CHECK(isValid(gradientHandle), "Invalid gradient handle");
-	VG_CHECK(!isLocal(gradientHandle), "Invalid gradient handle");
+	VG_SCOPED_TIMER(ctx, Timer::Stroke);
+	const bool recordClipCommands = ctx->m_RecordClipCommands;
 
 #if VG_CONFIG_ENABLE_SHAPE_CACHING
 	const bool hasCache = getCommandListCacheStackTop(ctx) != nullptr;
+#else
+	const bool hasCache = false;
 #endif
 
-	const float* pathVertices = transformPath(ctx);
+	const State* state = getState(ctx);
+	const float globalAlpha = hasCache ? 1.0f : state->m_GlobalAlpha;
+
+	float strokeWidth, alphaScale;
+	const bool isThin = calcStrokeParams(width, flags, state->m_AvgScale, ctx->m_FringeWidth, &strokeWidth, &alphaScale);
+
+	const Color col = recordClipCommands ? Colors::Black : colorSetAlpha(color, (uint8_t)(globalAlpha * alphaScale * colorGetAlpha(color)));
+	if (!hasCache && colorGetAlpha(col) == 0) {
+		return;
+	}
 
-	const PathType::Enum pathType = VG_FILL_FLAGS_PATH_TYPE(flags);
-	const FillRule::Enum fillRule = VG_FILL_FLAGS_RULE(flags);
 #if VG_CONFIG_FORCE_AA_OFF
 	const bool aa = false;
 #else
-	const bool aa = VG_FILL_FLAGS_AA(flags);
-#endif
-
-	Stroker* stroker = ctx->m_Stroker;
-	const Path* path = ctx->m_Path;
-	const uint32_t numSubPaths = pathGetNumSubPaths(path);
-	const SubPath* subPaths = pathGetSubPaths(path);
-
-#if VG_CONFIG_ENABLE_SHAPE_CACHING
-	if (hasCache) {
-		beginCachedCommand(ctx);
-	}
+	const bool aa = recordClipCommands ? false : VG_STROKE_FLAGS_AA(flags);
 #endif
 
+	const PathMeshTarget target = { ctx, recordClipCommands ? DrawCommand::Type::Clip : DrawCommand::Type::Textured, 0, hasCache };
+	ctxStrokePath(ctx, &target, flags, col, strokeWidth, isThin, aa);
+}
 
-	const State *state = getState(ctx);
-	const Color black = colorSetAlpha(Colors::Black, 0xff * state->m_GlobalAlpha);
-	Mesh mesh;
-	const uint32_t* colors = &black;
-	uint32_t numColors = 1;
-
-	if (pathType == PathType::Convex) {
-		for (uint32_t i = 0; i < numSubPaths; ++i) {
-			const SubPath* subPath = &subPaths[i];
-			if (subPath->m_NumVertices < 3) {
-				continue;
-			}
-
-			const float* vtx = &pathVertices[subPath->m_FirstVertexID << 1];
-			const uint32_t numPathVertices = subPath->m_NumVertices;
-
-			if (aa) {
-				strokerConvexFillAA(stroker, &mesh, vtx, numPathVertices, Colors::Black);
-				colors = mesh.m_ColorBuffer;
-				numColors = mesh.m_NumVertices;
-			} else {
-				strokerConvexFill(stroker, &mesh, vtx, numPathVertices);
-			}
+static void ctxStrokePathGradient(Context* ctx, GradientHandle gradientHandle, float width, uint32_t flags)
+{
+	VG_SCOPED_TIMER(ctx, Timer::Stroke);
+	VG_CHECK(!ctx->m_RecordClipCommands, "Only strokePath(Color) is supported inside BeginClip()/EndClip()");
+	VG_CHECK(isValid(gradientHandle), "Invalid gradient handle");
+	VG_CHECK(!isLocal(gradientHandle), "Invalid gradient handle");
 
 #if VG_CONFIG_ENABLE_SHAPE_CACHING
-			if (hasCache) {
-				addCachedCommand(ctx, mesh.m_PosBuffer, mesh.m_NumVertices, colors, numColors, mesh.m_IndexBuffer, mesh.m_NumIndices);
-			}
+	const bool hasCache = getCommandListCacheStackTop(ctx) != nullptr;
+#else
+	const bool hasCache = false;
 #endif
 
-			createDrawCommand_ColorGradient(ctx, gradientHandle, mesh.m_PosBuffer, mesh.m_NumVertices, colors, numColors, mesh.m_IndexBuffer, mesh.m_NumIndices);
-		}
-	} else if (pathType == PathType::Concave) {
-		strokerConcaveFillBegin(stroker);
-		for (uint32_t i = 0; i < numSubPaths; ++i) {
-			const SubPath* subPath = &subPaths[i];
-			if (subPath->m_NumVertices < 3) {
-				return;
-			}
-
-			const float* vtx = &pathVertices[subPath->m_FirstVertexID << 1];
-			const uint32_t numPathVertices = subPath->m_NumVertices;
-			strokerConcaveFillAddContour(stroker, vtx, numPathVertices);
-		}
+	const State* state = getState(ctx);
+	const Color black = hasCache ? Colors::Black : colorSetAlpha(Colors::Black, (uint8_t)(0xff * state->m_GlobalAlpha));
 
-		bool decomposed = false;
-		if (aa) {
-			decomposed = strokerConcaveFillEndAA(stroker, &mesh, black, fillRule);
-			colors = mesh.m_ColorBuffer;
-			numColors = mesh.m_NumVertices;
-		} else {
-			decomposed = strokerConcaveFillEnd(stroker, &mesh, fillRule);
-		}
+	float strokeWidth, alphaScale;
+	const bool isThin = calcStrokeParams(width, flags, state->m_AvgScale, ctx->m_FringeWidth, &strokeWidth, &alphaScale);
 
-		VG_WARN(decomposed, "Failed to triangulate concave polygon");
-		if (decomposed) {
-#if VG_CONFIG_ENABLE_SHAPE_CACHING
-			if (hasCache) {
-				addCachedCommand(ctx, mesh.m_PosBuffer, mesh.m_NumVertices, colors, numColors, mesh.m_IndexBuffer, mesh.m_NumIndices);
-			}
+#if VG_CONFIG_FORCE_AA_OFF
+	const bool aa = false;
+#else
+	const bool aa = VG_STROKE_FLAGS_AA(flags);
 #endif
 
-			createDrawCommand_ColorGradient(ctx, gradientHandle, mesh.m_PosBuffer, mesh.m_NumVertices, colors, numColors, mesh.m_IndexBuffer, mesh.m_NumIndices);
-		}
-	}
-
-#if VG_CONFIG_ENABLE_SHAPE_CACHING
-	if (hasCache) {
-		endCachedCommand(ctx);
-	}
-#endif
+	const PathMeshTarget target = { ctx, DrawCommand::Type::ColorGradient, gradientHandle.idx, hasCache };
+	ctxStrokePath(ctx, &target, flags, black, strokeWidth, isThin, aa);
 }
 
-static void ctxFillPathImagePattern(Context* ctx, ImagePatternHandle imgPatternHandle, Color color, uint32_t flags)
+static void ctxStrokePathImagePattern(Context* ctx, ImagePatternHandle imgPatternHandle, Color color, float width, uint32_t flags)
 {
-	VG_CHECK(!ctx->m_RecordClipCommands, "Only fillPath(Color) is supported inside BeginClip()/EndClip()");
+	VG_SCOPED_TIMER(ctx, Timer::Stroke);
+	VG_CHECK(!ctx->m_RecordClipCommands, "Only strokePath(Color) is supported inside BeginClip()/EndClip()");
 	VG_CHECK(isValid(imgPatternHandle), "Invalid image pattern handle");
 	VG_CHECK(!isLocal(imgPatternHandle), "Invalid gradient handle");
 
@@ -3297,386 +3846,118 @@ static void ctxFillPathImagePattern(Context* ctx, ImagePatternHandle imgPatternH
 
 	const State* state = getState(ctx);
 	const float globalAlpha = hasCache ? 1.0f : state->m_GlobalAlpha;
-	const Color col = colorSetAlpha(color, (uint8_t)(globalAlpha * colorGetAlpha(color)));
+
+	float strokeWidth, alphaScale;
+	const bool isThin = calcStrokeParams(width, flags, state->m_AvgScale, ctx->m_FringeWidth, &strokeWidth, &alphaScale);
+
+	const Color col = colorSetAlpha(color, (uint8_t)(globalAlpha * alphaScale * colorGetAlpha(color)));
 	if (!hasCache && colorGetAlpha(col) == 0) {
 		return;
 	}
 
-	const PathType::Enum pathType = VG_FILL_FLAGS_PATH_TYPE(flags);
-	const FillRule::Enum fillRule = VG_FILL_FLAGS_RULE(flags);
 #if VG_CONFIG_FORCE_AA_OFF
 	const bool aa = false;
 #else
-	const bool aa = VG_FILL_FLAGS_AA(flags);
+	const bool aa = VG_STROKE_FLAGS_AA(flags);
 #endif
 
+	const PathMeshTarget target = { ctx, DrawCommand::Type::ImagePattern, imgPatternHandle.idx, hasCache };
+	ctxStrokePath(ctx, &target, flags, col, strokeWidth, isThin, aa);
+}
+
+static void ctxFillPath(Context* ctx, const PathMeshTarget* target, uint32_t flags, Color col, bool aa)
+{
 	const float* pathVertices = transformPath(ctx);
+	if (cullPath(ctx, pathVertices, ctx->m_FringeWidth)) {
+		return;
+	}
 
-	Stroker* stroker = ctx->m_Stroker;
-	const Path* path = ctx->m_Path;
-	const uint32_t numSubPaths = pathGetNumSubPaths(path);
-	const SubPath* subPaths = pathGetSubPaths(path);
+	if (VG_FILL_FLAGS_PATH_TYPE(flags) == PathType::Concave) {
+		ctx->m_Stats.m_NumConcaveFills++;
+	}
 
 #if VG_CONFIG_ENABLE_SHAPE_CACHING
-	if (hasCache) {
+	if (target->m_HasCache) {
 		beginCachedCommand(ctx);
 	}
 #endif
 
-	if (pathType == PathType::Convex) {
-		for (uint32_t i = 0; i < numSubPaths; ++i) {
-			const SubPath* subPath = &subPaths[i];
-			if (subPath->m_NumVertices < 3) {
-				continue;
-			}
-
-			const float* vtx = &pathVertices[subPath->m_FirstVertexID << 1];
-			const uint32_t numPathVertices = subPath->m_NumVertices;
-
-			Mesh mesh;
-			const uint32_t* colors = &col;
-			uint32_t numColors = 1;
-
-			if (aa) {
-				strokerConvexFillAA(stroker, &mesh, vtx, numPathVertices, col);
-				colors = mesh.m_ColorBuffer;
-				numColors = mesh.m_NumVertices;
-			} else {
-				strokerConvexFill(stroker, &mesh, vtx, numPathVertices);
-			}
+	meshFillPath(ctx->m_Stroker, ctx->m_Path, pathVertices, flags, col, aa, ctxAddPathMesh, (void*)target);
 
 #if VG_CONFIG_ENABLE_SHAPE_CACHING
-			if (hasCache) {
-				addCachedCommand(ctx, mesh.m_PosBuffer, mesh.m_NumVertices, colors, numColors, mesh.m_IndexBuffer, mesh.m_NumIndices);
-			}
+	if (target->m_HasCache) {
+		endCachedCommand(ctx);
+	}
 #endif
+}
 
-			createDrawCommand_ImagePattern(ctx, imgPatternHandle, mesh.m_PosBuffer, mesh.m_NumVertices, colors, numColors, mesh.m_IndexBuffer, mesh.m_NumIndices);
-		}
-	} else if (pathType == PathType::Concave) {
-		strokerConcaveFillBegin(stroker);
-		for (uint32_t i = 0; i < numSubPaths; ++i) {
-			const SubPath* subPath = &subPaths[i];
-			if (subPath->m_NumVertices < 3) {
-				return;
-			}
-
-			const float* vtx = &pathVertices[subPath->m_FirstVertexID << 1];
-			const uint32_t numPathVertices = subPath->m_NumVertices;
-			strokerConcaveFillAddContour(stroker, vtx, numPathVertices);
-		}
-
-		Mesh mesh;
-		const uint32_t* colors = &col;
-		uint32_t numColors = 1;
+static void ctxStrokePath(Context* ctx, const PathMeshTarget* target, uint32_t flags, Color col, float strokeWidth, bool isThin, bool aa)
+{
+	const LineJoin::Enum lineJoin = VG_STROKE_FLAGS_LINE_JOIN(flags);
+	const LineCap::Enum lineCap = VG_STROKE_FLAGS_LINE_CAP(flags);
 
-		bool decomposed = false;
-		if (aa) {
-			decomposed = strokerConcaveFillEndAA(stroker, &mesh, col, fillRule);
-			colors = mesh.m_ColorBuffer;
-			numColors = mesh.m_NumVertices;
-		} else {
-			decomposed = strokerConcaveFillEnd(stroker, &mesh, fillRule);
-		}
+	const float* pathVertices = transformPath(ctx);
+	if (cullPath(ctx, pathVertices, calcStrokeExtent(strokeWidth, lineCap, lineJoin) + ctx->m_FringeWidth)) {
+		return;
+	}
 
-		VG_WARN(decomposed, "Failed to triangulate concave polygon");
-		if (decomposed) {
 #if VG_CONFIG_ENABLE_SHAPE_CACHING
-			if (hasCache) {
-				addCachedCommand(ctx, mesh.m_PosBuffer, mesh.m_NumVertices, colors, numColors, mesh.m_IndexBuffer, mesh.m_NumIndices);
-			}
+	if (target->m_HasCache) {
+		beginCachedCommand(ctx);
+	}
 #endif
 
-			createDrawCommand_ImagePattern(ctx, imgPatternHandle, mesh.m_PosBuffer, mesh.m_NumVertices, colors, numColors, mesh.m_IndexBuffer, mesh.m_NumIndices);
-		}
-	}
+	meshStrokePath(ctx->m_Stroker, ctx->m_Path, pathVertices, flags, col, strokeWidth, isThin, aa, ctxAddPathMesh, (void*)target);
 
 #if VG_CONFIG_ENABLE_SHAPE_CACHING
-	if (hasCache) {
+	if (target->m_HasCache) {
 		endCachedCommand(ctx);
 	}
 #endif
 }
 
-static void ctxStrokePathColor(Context* ctx, Color color, float width, uint32_t flags)
+static void ctxAddPathMesh(void* userData, const Mesh* mesh, const uint32_t* colors, uint32_t numColors)
 {
-	const bool recordClipCommands = ctx->m_RecordClipCommands;
+	const PathMeshTarget* target = (const PathMeshTarget*)userData;
+	Context* ctx = target->m_Ctx;
 
 #if VG_CONFIG_ENABLE_SHAPE_CACHING
-	const bool hasCache = getCommandListCacheStackTop(ctx) != nullptr;
-#else
-	const bool hasCache = false;
+	if (target->m_HasCache) {
+		addCachedCommand(ctx, mesh->m_PosBuffer, mesh->m_NumVertices, colors, numColors, mesh->m_IndexBuffer, mesh->m_NumIndices);
+	}
 #endif
 
-	const State* state = getState(ctx);
-	const float avgScale = state->m_AvgScale;
-	const float globalAlpha = hasCache ? 1.0f : state->m_GlobalAlpha;
-	const float fringeWidth = ctx->m_FringeWidth;
-
-	const float scaledStrokeWidth = ((flags & StrokeFlags::FixedWidth) != 0) ? width : bx::clamp<float>(width * avgScale, 0.0f, 200.0f);
-	const bool isThin = scaledStrokeWidth <= fringeWidth;
-
-	const float alphaScale = !isThin ? globalAlpha : globalAlpha * bx::square(bx::clamp<float>(scaledStrokeWidth, 0.0f, fringeWidth));
-	const Color col = recordClipCommands ? Colors::Black : colorSetAlpha(color, (uint8_t)(alphaScale * colorGetAlpha(color)));
-	if (!hasCache && colorGetAlpha(col) == 0) {
-		return;
+	switch (target->m_Type) {
+	case DrawCommand::Type::Textured: {
+		createDrawCommand_VertexColor(ctx, mesh->m_PosBuffer, mesh->m_NumVertices, colors, numColors, mesh->m_IndexBuffer, mesh->m_NumIndices);
+	} break;
+	case DrawCommand::Type::ColorGradient: {
+		const GradientHandle gradientHandle = { target->m_Handle, 0 };
+		createDrawCommand_ColorGradient(ctx, gradientHandle, mesh->m_PosBuffer, mesh->m_NumVertices, colors, numColors, mesh->m_IndexBuffer, mesh->m_NumIndices);
+	} break;
+	case DrawCommand::Type::ImagePattern: {
+		const ImagePatternHandle imgPatternHandle = { target->m_Handle, 0 };
+		createDrawCommand_ImagePattern(ctx, imgPatternHandle, mesh->m_PosBuffer, mesh->m_NumVertices, colors, numColors, mesh->m_IndexBuffer, mesh->m_NumIndices);
+	} break;
+	case DrawCommand::Type::Clip: {
+		createDrawCommand_Clip(ctx, mesh->m_PosBuffer, mesh->m_NumVertices, mesh->m_IndexBuffer, mesh->m_NumIndices);
+	} break;
+	default: {
+		VG_CHECK(false, "Unknown draw command type");
+	} break;
 	}
+}
 
-	const LineJoin::Enum lineJoin = VG_STROKE_FLAGS_LINE_JOIN(flags);
-	const LineCap::Enum lineCap = VG_STROKE_FLAGS_LINE_CAP(flags);
-#if VG_CONFIG_FORCE_AA_OFF
-	const bool aa = false;
-#else
-	const bool aa = recordClipCommands ? false : VG_STROKE_FLAGS_AA(flags);
-#endif
+static void ctxBeginClip(Context* ctx, ClipRule::Enum rule)
+{
+	VG_CHECK(!ctx->m_RecordClipCommands, "Already inside beginClip()/endClip() block");
 
-	const float strokeWidth = isThin ? fringeWidth : scaledStrokeWidth;
+	ClipState* clipState = &ctx->m_ClipState;
+	const uint32_t nextClipCmdID = ctx->m_NumClipCommands;
 
-	const float* pathVertices = transformPath(ctx);
-
-	const Path* path = ctx->m_Path;
-	const uint32_t numSubPaths = pathGetNumSubPaths(path);
-	const SubPath* subPaths = pathGetSubPaths(path);
-	Stroker* stroker = ctx->m_Stroker;
-
-#if VG_CONFIG_ENABLE_SHAPE_CACHING
-	if (hasCache) {
-		beginCachedCommand(ctx);
-	}
-#endif
-
-	for (uint32_t iSubPath = 0; iSubPath < numSubPaths; ++iSubPath) {
-		const SubPath* subPath = &subPaths[iSubPath];
-		if (subPath->m_NumVertices < 2) {
-			continue;
-		}
-
-		const float* vtx = &pathVertices[subPath->m_FirstVertexID << 1];
-		const uint32_t numPathVertices = subPath->m_NumVertices;
-		const bool isClosed = subPath->m_IsClosed;
-
-		Mesh mesh;
-		const uint32_t* colors = &col;
-		uint32_t numColors = 1;
-		if (aa) {
-			if (isThin) {
-				strokerPolylineStrokeAAThin(stroker, &mesh, vtx, numPathVertices, isClosed, col, lineCap, lineJoin);
-			} else {
-				strokerPolylineStrokeAA(stroker, &mesh, vtx, numPathVertices, isClosed, col, strokeWidth, lineCap, lineJoin);
-			}
-
-			colors = mesh.m_ColorBuffer;
-			numColors = mesh.m_NumVertices;
-		} else {
-			strokerPolylineStroke(stroker, &mesh, vtx, numPathVertices, isClosed, strokeWidth, lineCap, lineJoin);
-		}
-
-#if VG_CONFIG_ENABLE_SHAPE_CACHING
-		if (hasCache) {
-			addCachedCommand(ctx, mesh.m_PosBuffer, mesh.m_NumVertices, colors, numColors, mesh.m_IndexBuffer, mesh.m_NumIndices);
-		}
-#endif
-
-		if (recordClipCommands) {
-			createDrawCommand_Clip(ctx, mesh.m_PosBuffer, mesh.m_NumVertices, mesh.m_IndexBuffer, mesh.m_NumIndices);
-		} else {
-			createDrawCommand_VertexColor(ctx, mesh.m_PosBuffer, mesh.m_NumVertices, colors, numColors, mesh.m_IndexBuffer, mesh.m_NumIndices);
-		}
-	}
-
-#if VG_CONFIG_ENABLE_SHAPE_CACHING
-	if (hasCache) {
-		endCachedCommand(ctx);
-	}
-#endif
-}
-
-static void ctxStrokePathGradient(Context* ctx, GradientHandle gradientHandle, float width, uint32_t flags)
-{
-	VG_CHECK(!ctx->m_RecordClipCommands, "Only strokePath(Color) is supported inside BeginClip()/EndClip()");
-	VG_CHECK(isValid(gradientHandle), "Invalid gradient handle");
-	VG_CHECK(!isLocal(gradientHandle), "Invalid gradient handle");
-
-#if VG_CONFIG_ENABLE_SHAPE_CACHING
-	const bool hasCache = getCommandListCacheStackTop(ctx) != nullptr;
-#endif
-
-	const LineJoin::Enum lineJoin = VG_STROKE_FLAGS_LINE_JOIN(flags);
-	const LineCap::Enum lineCap = VG_STROKE_FLAGS_LINE_CAP(flags);
-#if VG_CONFIG_FORCE_AA_OFF
-	const bool aa = false;
-#else
-	const bool aa = VG_STROKE_FLAGS_AA(flags);
-#endif
-
-	const float* pathVertices = transformPath(ctx);
-
-	const State* state = getState(ctx);
-	const float avgScale = state->m_AvgScale;
-	float strokeWidth = ((flags & StrokeFlags::FixedWidth) != 0) ? width : bx::clamp<float>(width * avgScale, 0.0f, 200.0f);
-	bool isThin = false;
-	if (strokeWidth <= ctx->m_FringeWidth) {
-		strokeWidth = ctx->m_FringeWidth;
-		isThin = true;
-	}
-
-	Stroker* stroker = ctx->m_Stroker;
-	const Path* path = ctx->m_Path;
-	const uint32_t numSubPaths = pathGetNumSubPaths(path);
-	const SubPath* subPaths = pathGetSubPaths(path);
-
-#if VG_CONFIG_ENABLE_SHAPE_CACHING
-	if (hasCache) {
-		beginCachedCommand(ctx);
-	}
-#endif
-
-	for (uint32_t iSubPath = 0; iSubPath < numSubPaths; ++iSubPath) {
-		const SubPath* subPath = &subPaths[iSubPath];
-		if (subPath->m_NumVertices < 2) {
-			continue;
-		}
-
-		const float* vtx = &pathVertices[subPath->m_FirstVertexID << 1];
-		const uint32_t numPathVertices = subPath->m_NumVertices;
-		const bool isClosed = subPath->m_IsClosed;
-
-		Mesh mesh;
-		const uint32_t black = colorSetAlpha(Colors::Black, 0xff * state->m_GlobalAlpha);
-		const uint32_t* colors = &black;
-		uint32_t numColors = 1;
-
-		if (aa) {
-			if (isThin) {
-				strokerPolylineStrokeAAThin(stroker, &mesh, vtx, numPathVertices, isClosed, vg::Colors::Black, lineCap, lineJoin);
-			} else {
-				strokerPolylineStrokeAA(stroker, &mesh, vtx, numPathVertices, isClosed, vg::Colors::Black, strokeWidth, lineCap, lineJoin);
-			}
-
-			colors = mesh.m_ColorBuffer;
-			numColors = mesh.m_NumVertices;
-		} else {
-			strokerPolylineStroke(stroker, &mesh, vtx, numPathVertices, isClosed, strokeWidth, lineCap, lineJoin);
-		}
-
-#if VG_CONFIG_ENABLE_SHAPE_CACHING
-		if (hasCache) {
-			addCachedCommand(ctx, mesh.m_PosBuffer, mesh.m_NumVertices, colors, numColors, mesh.m_IndexBuffer, mesh.m_NumIndices);
-		}
-#endif
-
-		createDrawCommand_ColorGradient(ctx, gradientHandle, mesh.m_PosBuffer, mesh.m_NumVertices, colors, numColors, mesh.m_IndexBuffer, mesh.m_NumIndices);
-	}
-
-#if VG_CONFIG_ENABLE_SHAPE_CACHING
-	if (hasCache) {
-		endCachedCommand(ctx);
-	}
-#endif
-}
-
-static void ctxStrokePathImagePattern(Context* ctx, ImagePatternHandle imgPatternHandle, Color color, float width, uint32_t flags)
-{
-	VG_CHECK(!ctx->m_RecordClipCommands, "Only strokePath(Color) is supported inside BeginClip()/EndClip()");
-	VG_CHECK(isValid(imgPatternHandle), "Invalid image pattern handle");
-	VG_CHECK(!isLocal(imgPatternHandle), "Invalid gradient handle");
-
-#if VG_CONFIG_ENABLE_SHAPE_CACHING
-	const bool hasCache = getCommandListCacheStackTop(ctx) != nullptr;
-#else
-	const bool hasCache = false;
-#endif
-
-	const State* state = getState(ctx);
-	const float avgScale = state->m_AvgScale;
-	const float globalAlpha = hasCache ? 1.0f : state->m_GlobalAlpha;
-	const float fringeWidth = ctx->m_FringeWidth;
-
-	const float scaledStrokeWidth = ((flags & StrokeFlags::FixedWidth) != 0) ? width : bx::clamp<float>(width * avgScale, 0.0f, 200.0f);
-	const bool isThin = scaledStrokeWidth <= fringeWidth;
-
-	const float alphaScale = isThin ? globalAlpha : globalAlpha * bx::square(bx::clamp<float>(scaledStrokeWidth, 0.0f, fringeWidth));
-	const Color col = colorSetAlpha(color, (uint8_t)(alphaScale * colorGetAlpha(color)));
-	if (!hasCache && colorGetAlpha(col) == 0) {
-		return;
-	}
-
-	const LineJoin::Enum lineJoin = VG_STROKE_FLAGS_LINE_JOIN(flags);
-	const LineCap::Enum lineCap = VG_STROKE_FLAGS_LINE_CAP(flags);
-#if VG_CONFIG_FORCE_AA_OFF
-	const bool aa = false;
-#else
-	const bool aa = VG_STROKE_FLAGS_AA(flags);
-#endif
-
-	const float strokeWidth = isThin ? fringeWidth : scaledStrokeWidth;
-
-	const float* pathVertices = transformPath(ctx);
-
-	Stroker* stroker = ctx->m_Stroker;
-	const Path* path = ctx->m_Path;
-	const uint32_t numSubPaths = pathGetNumSubPaths(path);
-	const SubPath* subPaths = pathGetSubPaths(path);
-
-#if VG_CONFIG_ENABLE_SHAPE_CACHING
-	if (hasCache) {
-		beginCachedCommand(ctx);
-	}
-#endif
-
-	for (uint32_t iSubPath = 0; iSubPath < numSubPaths; ++iSubPath) {
-		const SubPath* subPath = &subPaths[iSubPath];
-		if (subPath->m_NumVertices < 2) {
-			continue;
-		}
-
-		const float* vtx = &pathVertices[subPath->m_FirstVertexID << 1];
-		const uint32_t numPathVertices = subPath->m_NumVertices;
-		const bool isClosed = subPath->m_IsClosed;
-
-		Mesh mesh;
-		const uint32_t* colors = &col;
-		uint32_t numColors = 1;
-
-		if (aa) {
-			if (isThin) {
-				strokerPolylineStrokeAAThin(stroker, &mesh, vtx, numPathVertices, isClosed, col, lineCap, lineJoin);
-			} else {
-				strokerPolylineStrokeAA(stroker, &mesh, vtx, numPathVertices, isClosed, col, strokeWidth, lineCap, lineJoin);
-			}
-
-			colors = mesh.m_ColorBuffer;
-			numColors = mesh.m_NumVertices;
-		} else {
-			strokerPolylineStroke(stroker, &mesh, vtx, numPathVertices, isClosed, strokeWidth, lineCap, lineJoin);
-		}
-
-#if VG_CONFIG_ENABLE_SHAPE_CACHING
-		if (hasCache) {
-			addCachedCommand(ctx, mesh.m_PosBuffer, mesh.m_NumVertices, colors, numColors, mesh.m_IndexBuffer, mesh.m_NumIndices);
-		}
-#endif
-
-		createDrawCommand_ImagePattern(ctx, imgPatternHandle, mesh.m_PosBuffer, mesh.m_NumVertices, colors, numColors, mesh.m_IndexBuffer, mesh.m_NumIndices);
-	}
-
-#if VG_CONFIG_ENABLE_SHAPE_CACHING
-	if (hasCache) {
-		endCachedCommand(ctx);
-	}
-#endif
-}
-
-static void ctxBeginClip(Context* ctx, ClipRule::Enum rule)
-{
-	VG_CHECK(!ctx->m_RecordClipCommands, "Already inside beginClip()/endClip() block");
-
-	ClipState* clipState = &ctx->m_ClipState;
-	const uint32_t nextClipCmdID = ctx->m_NumClipCommands;
-
-	clipState->m_Rule = rule;
-	clipState->m_FirstCmdID = nextClipCmdID;
-	clipState->m_NumCmds = 0;
+	clipState->m_Rule = rule;
+	clipState->m_FirstCmdID = nextClipCmdID;
+	clipState->m_NumCmds = 0;
 
 	ctx->m_RecordClipCommands = true;
 	ctx->m_ForceNewClipCommand = true;
@@ -3760,6 +4041,11 @@ static GradientHandle ctxCreateLinearGradient(Context* ctx, float sx, float sy,
 	grad->m_Params[1] = large + d * 0.5f;
 	grad->m_Params[2] = 0.0f;
 	grad->m_Params[3] = bx::max<float>(1.0f, d);
+#if VG_CONFIG_BATCH_LINEAR_GRADIENTS
+	grad->m_IsLinear = true;
+	ctx->m_GradientRampData[handle.idx * 2 + 0] = icol;
+	ctx->m_GradientRampData[handle.idx * 2 + 1] = ocol;
+#endif
 	grad->m_InnerColor[0] = colorGetRed(icol) / 255.0f;
 	grad->m_InnerColor[1] = colorGetGreen(icol) / 255.0f;
 	grad->m_InnerColor[2] = colorGetBlue(icol) / 255.0f;
@@ -3811,6 +4097,9 @@ static GradientHandle ctxCreateBoxGradient(Context* ctx, float x, float y, float
 	grad->m_Params[1] = h * 0.5f;
 	grad->m_Params[2] = r;
 	grad->m_Params[3] = bx::max<float>(1.0f, f);
+#if VG_CONFIG_BATCH_LINEAR_GRADIENTS
+	grad->m_IsLinear = false;
+#endif
 	grad->m_InnerColor[0] = colorGetRed(icol) / 255.0f;
 	grad->m_InnerColor[1] = colorGetGreen(icol) / 255.0f;
 	grad->m_InnerColor[2] = colorGetBlue(icol) / 255.0f;
@@ -3865,6 +4154,9 @@ static GradientHandle ctxCreateRadialGradient(Context* ctx, float cx, float cy,
 	grad->m_Params[1] = r;
 	grad->m_Params[2] = r;
 	grad->m_Params[3] = bx::max<float>(1.0f, f);
+#if VG_CONFIG_BATCH_LINEAR_GRADIENTS
+	grad->m_IsLinear = false;
+#endif
 	grad->m_InnerColor[0] = colorGetRed(icol) / 255.0f;
 	grad->m_InnerColor[1] = colorGetGreen(icol) / 255.0f;
 	grad->m_InnerColor[2] = colorGetBlue(icol) / 255.0f;
@@ -3959,7 +4251,9 @@ static void ctxPopState(Context* ctx)
 			lastScissor[1] != (uint16_t)stateScissor[1] ||
 			lastScissor[2] != (uint16_t)stateScissor[2] ||
 			lastScissor[3] != (uint16_t)stateScissor[3]) {
+#if !VG_CONFIG_SOFTWARE_SCISSOR
 			ctx->m_ForceNewDrawCommand = true;
+#endif
 			ctx->m_ForceNewClipCommand = true;
 		}
 	}
@@ -3971,7 +4265,9 @@ static void ctxResetScissor(Context* ctx)
 	state->m_ScissorRect[0] = state->m_ScissorRect[1] = 0.0f;
 	state->m_ScissorRect[2] = (float)ctx->m_CanvasWidth;
 	state->m_ScissorRect[3] = (float)ctx->m_CanvasHeight;
+#if !VG_CONFIG_SOFTWARE_SCISSOR
 	ctx->m_ForceNewDrawCommand = true;
+#endif
 	ctx->m_ForceNewClipCommand = true;
 }
 
@@ -3995,7 +4291,9 @@ static void ctxSetScissor(Context* ctx, float x, float y, float w, float h)
 	state->m_ScissorRect[1] = miny;
 	state->m_ScissorRect[2] = maxx - minx;
 	state->m_ScissorRect[3] = maxy - miny;
+#if !VG_CONFIG_SOFTWARE_SCISSOR
 	ctx->m_ForceNewDrawCommand = true;
+#endif
 	ctx->m_ForceNewClipCommand = true;
 }
 
@@ -4022,7 +4320,9 @@ static bool ctxIntersectScissor(Context* ctx, float x, float y, float w, float h
 	state->m_ScissorRect[2] = newRectWidth;
 	state->m_ScissorRect[3] = newRectHeight;
 
+#if !VG_CONFIG_SOFTWARE_SCISSOR
 	ctx->m_ForceNewDrawCommand = true;
+#endif
 	ctx->m_ForceNewClipCommand = true;
 
 	return newRectWidth >= 1.0f && newRectHeight >= 1.0f;
@@ -4135,6 +4435,18 @@ static void ctxIndexedTriList(Context* ctx, const float* pos, const uv_t* uv, ui
 	const State* state = getState(ctx);
 	const float* stateTransform = state->m_TransformMtx;
 
+#if VG_CONFIG_SOFTWARE_SCISSOR
+	// Clipping works in screen space so transform the positions first.
+	float* transformedPos = allocTransformedVertices(ctx, numVertices);
+	vgutil::batchTransformPositions(pos, numVertices, transformedPos, stateTransform);
+	ctx->m_PathTransformed = false;
+
+	const float* vtx = transformedPos;
+	if (!clipMeshToScissorRect(ctx, &vtx, &uv, &numVertices, &colors, &numColors, &indices, &numIndices)) {
+		return;
+	}
+#endif
+
 	DrawCommand* cmd = allocDrawCommand(ctx, numVertices, numIndices, DrawCommand::Type::Textured, img.idx);
 
 	// Vertex buffer
@@ -4142,7 +4454,11 @@ static void ctxIndexedTriList(Context* ctx, const float* pos, const uv_t* uv, ui
 	const uint32_t vbOffset = cmd->m_FirstVertexID + cmd->m_NumVertices;
 
 	float* dstPos = &vb->m_Pos[vbOffset << 1];
+#if VG_CONFIG_SOFTWARE_SCISSOR
+	bx::memCopy(dstPos, vtx, sizeof(float) * 2 * numVertices);
+#else
 	vgutil::batchTransformPositions(pos, numVertices, dstPos, stateTransform);
+#endif
 
 	uv_t* dstUV = &vb->m_UV[vbOffset << 1];
 	if (uv) {
@@ -4167,8 +4483,8 @@ static void ctxIndexedTriList(Context* ctx, const float* pos, const uv_t* uv, ui
 
 	// Index buffer
 	IndexBuffer* ib = &ctx->m_IndexBuffers[ctx->m_ActiveIndexBufferID];
-	uint16_t* dstIndex = &ib->m_Indices[cmd->m_FirstIndexID + cmd->m_NumIndices];
-	vgutil::batchTransformDrawIndices(indices, numIndices, dstIndex, (uint16_t)cmd->m_NumVertices);
+	index_t* dstIndex = &ib->m_Indices[cmd->m_FirstIndexID + cmd->m_NumIndices];
+	vgutil::batchTransformDrawIndices(indices, numIndices, dstIndex, (index_t)cmd->m_NumVertices);
 
 	cmd->m_NumVertices += numVertices;
 	cmd->m_NumIndices += numIndices;
@@ -4176,6 +4492,7 @@ static void ctxIndexedTriList(Context* ctx, const float* pos, const uv_t* uv, ui
 
 static void ctxText(Context* ctx, const TextConfig& cfg, float x, float y, const char* str, const char* end)
 {
+	VG_SCOPED_TIMER(ctx, Timer::Text);
 	VG_CHECK(isValid(cfg.m_FontHandle), "Invalid font handle");
 
 	const State* state = getState(ctx);
@@ -4215,9 +4532,10 @@ static void ctxText(Context* ctx, const TextConfig& cfg, float x, float y, const
 	if (ctx->m_TextQuadCapacity < (uint32_t)numBakedChars) {
 		bx::AllocatorI* allocator = ctx->m_Allocator;
 
+		// NOTE: Scratch buffers; their contents don't have to be preserved.
 		ctx->m_TextQuadCapacity = (uint32_t)numBakedChars;
-		ctx->m_TextQuads = (FONSquad*)bx::alignedRealloc(allocator, ctx->m_TextQuads, sizeof(FONSquad) * ctx->m_TextQuadCapacity, 16);
-		ctx->m_TextVertices = (float*)bx::alignedRealloc(allocator, ctx->m_TextVertices, sizeof(float) * 2 * (ctx->m_TextQuadCapacity * 4), 16);
+		ctx->m_TextQuads = (FONSquad*)arenaAlloc(allocator, &ctx->m_FrameArena, sizeof(FONSquad) * ctx->m_TextQuadCapacity);
+		ctx->m_TextVertices = (float*)arenaAlloc(allocator, &ctx->m_FrameArena, sizeof(float) * 2 * (ctx->m_TextQuadCapacity * 4));
 	}
 
 	bx::memCopy(ctx->m_TextQuads, vgs->m_Quads, sizeof(FONSquad) * numBakedChars);
@@ -4275,6 +4593,8 @@ static void ctxSubmitCommandList(Context* ctx, CommandListHandle handle)
 	VG_CHECK(isCommandListHandleValid(ctx, handle), "Invalid command list handle");
 	CommandList* cl = &ctx->m_CmdLists[handle.idx];
 
+	clMergeStats(ctx, cl);
+
 	if (ctx->m_SubmitCmdListRecursionDepth >= ctx->m_Config.m_MaxCommandListDepth) {
 		VG_CHECK(false, "SubmitCommandList recursion depth limit reached.");
 		return;
@@ -4283,19 +4603,30 @@ static void ctxSubmitCommandList(Context* ctx, CommandListHandle handle)
 
 #if VG_CONFIG_ENABLE_SHAPE_CACHING
 	CommandListCache* clCache = clGetCache(ctx, cl);
+#if VG_CONFIG_COMMAND_LIST_AUTO_CACHING
+	if (!clCache) {
+		clCache = clGetAutoCache(ctx, cl);
+	}
+#endif
 	if(clCache) {
+		clCacheMergeStats(ctx, clCache);
+
 		const State* state = getState(ctx);
 
 		const float cachedScale = clCache->m_AvgScale;
 		const float stateScale = state->m_AvgScale;
 		if (cachedScale == stateScale) {
+			ctx->m_Stats.m_NumCacheHits++;
+			clCache->m_LastUseFrame = ctx->m_FrameID;
 			clCacheRender(ctx, cl);
 			--ctx->m_SubmitCmdListRecursionDepth;
 			return;
 		} else {
+			ctx->m_Stats.m_NumCacheMisses++;
 			clCacheReset(ctx, clCache);
 
 			clCache->m_AvgScale = stateScale;
+			clCache->m_LastUseFrame = ctx->m_FrameID;
 		}
 	}
 #else
@@ -4330,17 +4661,18 @@ static void ctxSubmitCommandList(Context* ctx, CommandListHandle handle)
 #endif
 
 	while (cmd < cmdListEnd) {
-		const CommandHeader* cmdHeader = (CommandHeader*)cmd;
-		cmd += kAlignedCommandHeaderSize;
+		CommandType::Enum cmdType;
+		uint32_t cmdSize;
+		cmd = clReadCommandHeader(cmd, &cmdType, &cmdSize);
 
-		const uint8_t* nextCmd = cmd + cmdHeader->m_Size;
+		const uint8_t* nextCmd = cmd + cmdSize;
 		
-		if (skipCmds && cmdHeader->m_Type >= CommandType::FirstStrokerCommand && cmdHeader->m_Type <= CommandType::LastStrokerCommand) {
+		if (skipCmds && cmdType >= CommandType::FirstStrokerCommand && cmdType <= CommandType::LastStrokerCommand) {
 			cmd = nextCmd;
 			continue;
 		}
 
-		switch (cmdHeader->m_Type) {
+		switch (cmdType) {
 		case CommandType::BeginPath: {
 			ctxBeginPath(ctx);
 		} break;
@@ -4409,6 +4741,42 @@ static void ctxSubmitCommandList(Context* ctx, CommandListHandle handle)
 			cmd += sizeof(float) * 2 * numPoints;
 			ctxPolyline(ctx, coords, numPoints);
 		} break;
+#if VG_CONFIG_COMMAND_LIST_FIXED_POINT_BITS
+		case CommandType::MoveToFixed: {
+			float coords[2];
+			dequantizeCoords(coords, (const int16_t*)cmd, 2);
+			ctxMoveTo(ctx, coords[0], coords[1]);
+		} break;
+		case CommandType::LineToFixed: {
+			float coords[2];
+			dequantizeCoords(coords, (const int16_t*)cmd, 2);
+			ctxLineTo(ctx, coords[0], coords[1]);
+		} break;
+		case CommandType::CubicToFixed: {
+			float coords[6];
+			dequantizeCoords(coords, (const int16_t*)cmd, 6);
+			ctxCubicTo(ctx, coords[0], coords[1], coords[2], coords[3], coords[4], coords[5]);
+		} break;
+		case CommandType::QuadraticToFixed: {
+			float coords[4];
+			dequantizeCoords(coords, (const int16_t*)cmd, 4);
+			ctxQuadraticTo(ctx, coords[0], coords[1], coords[2], coords[3]);
+		} break;
+		case CommandType::PolylineFixed: {
+			uint32_t numPoints = CMD_READ(cmd, uint32_t);
+			const int16_t* fixedCoords = (const int16_t*)cmd;
+
+			// Convert the points in batches to avoid allocating scratch memory.
+			float coords[128];
+			while (numPoints != 0) {
+				const uint32_t n = bx::min<uint32_t>(numPoints, 64);
+				dequantizeCoords(coords, fixedCoords, n * 2);
+				ctxPolyline(ctx, coords, n);
+				fixedCoords += n * 2;
+				numPoints -= n;
+			}
+		} break;
+#endif
 		case CommandType::FillPathColor: {
 			const uint32_t flags = CMD_READ(cmd, uint32_t);
 			const Color color = CMD_READ(cmd, Color);
@@ -4947,7 +5315,7 @@ static float* allocTransformedVertices(Context* ctx, uint32_t numVertices)
 {
 	if (numVertices > ctx->m_TransformedVertexCapacity) {
 		bx::AllocatorI* allocator = ctx->m_Allocator;
-		ctx->m_TransformedVertices = (float*)bx::alignedRealloc(allocator, ctx->m_TransformedVertices, sizeof(float) * 2 * numVertices, 16);
+		ctx->m_TransformedVertices = (float*)arenaRealloc(allocator, &ctx->m_FrameArena, ctx->m_TransformedVertices, sizeof(float) * 2 * ctx->m_TransformedVertexCapacity, sizeof(float) * 2 * numVertices);
 		ctx->m_TransformedVertexCapacity = numVertices;
 	}
 
@@ -4970,874 +5338,3209 @@ static const float* transformPath(Context* ctx)
 	const float* pathVertices = pathGetVertices(path);
 	vgutil::batchTransformPositions(pathVertices, numPathVertices, transformedVertices, stateTransform);
 	ctx->m_PathTransformed = true;
+	ctx->m_Stats.m_NumFlattenedPaths++;
 
 	return transformedVertices;
 }
 
-static VertexBuffer* allocVertexBuffer(Context* ctx)
+// Returns true (and counts the path in Stats::m_NumCulledPaths) if the AABB of the transformed path,
+// expanded by extent, lies completely outside the current scissor rect. Paths recorded into a
+// command list cache are never culled because the cached geometry is replayed with different
+// transforms.
+static bool cullPath(Context* ctx, const float* pathVertices, float extent)
 {
-	if (ctx->m_NumVertexBuffers + 1 > ctx->m_VertexBufferCapacity) {
-		ctx->m_VertexBufferCapacity++;
-		ctx->m_VertexBuffers = (VertexBuffer*)bx::realloc(ctx->m_Allocator, ctx->m_VertexBuffers, sizeof(VertexBuffer) * ctx->m_VertexBufferCapacity);
-		ctx->m_GPUVertexBuffers = (GPUVertexBuffer*)bx::realloc(ctx->m_Allocator, ctx->m_GPUVertexBuffers, sizeof(GPUVertexBuffer) * ctx->m_VertexBufferCapacity);
+#if VG_CONFIG_ENABLE_SHAPE_CACHING
+	if (getCommandListCacheStackTop(ctx) != nullptr) {
+		return false;
+	}
+#endif
 
-		GPUVertexBuffer* gpuvb = &ctx->m_GPUVertexBuffers[ctx->m_VertexBufferCapacity - 1];
+	const uint32_t numPathVertices = pathGetNumVertices(ctx->m_Path);
+	if (numPathVertices == 0) {
+		return false;
+	}
 
-		gpuvb->m_PosBufferHandle = BGFX_INVALID_HANDLE;
-		gpuvb->m_UVBufferHandle = BGFX_INVALID_HANDLE;
-		gpuvb->m_ColorBufferHandle = BGFX_INVALID_HANDLE;
+	float bounds[4] = { pathVertices[0], pathVertices[1], pathVertices[0], pathVertices[1] };
+	for (uint32_t i = 1; i < numPathVertices; ++i) {
+		const float x = pathVertices[i * 2 + 0];
+		const float y = pathVertices[i * 2 + 1];
+		bounds[0] = bx::min<float>(bounds[0], x);
+		bounds[1] = bx::min<float>(bounds[1], y);
+		bounds[2] = bx::max<float>(bounds[2], x);
+		bounds[3] = bx::max<float>(bounds[3], y);
 	}
 
-	VertexBuffer* vb = &ctx->m_VertexBuffers[ctx->m_NumVertexBuffers++];
-	vb->m_Pos = allocVertexBufferData_Vec2(ctx);
-#if VG_CONFIG_UV_INT16
-	vb->m_UV = allocVertexBufferData_UV(ctx);
-#else
-	vb->m_UV = allocVertexBufferData_Vec2(ctx);
-#endif
-	vb->m_Color = allocVertexBufferData_Uint32(ctx);
-	vb->m_Count = 0;
+	const float* scissorRect = getState(ctx)->m_ScissorRect;
+	const bool culled = false
+		|| bounds[2] + extent <= scissorRect[0]
+		|| bounds[3] + extent <= scissorRect[1]
+		|| bounds[0] - extent >= scissorRect[0] + scissorRect[2]
+		|| bounds[1] - extent >= scissorRect[1] + scissorRect[3]
+		;
 
-	return vb;
+	if (culled) {
+		ctx->m_Stats.m_NumCulledPaths++;
+	}
+
+	return culled;
 }
 
-static uint16_t allocIndexBuffer(Context* ctx)
+// Maximum distance of the stroker's generated vertices from the path.
+static float calcStrokeExtent(float strokeWidth, LineCap::Enum lineCap, LineJoin::Enum lineJoin)
 {
-#if BX_CONFIG_SUPPORTS_THREADING
-	bx::MutexScope ms(*ctx->m_DataPoolMutex);
-#endif
+	// calcExtrusionVector() limits the cross product of the 2 segment directions to 1/100 so
+	// a miter can extend up to 200 half stroke widths away from the path point.
+	const float hsw = strokeWidth * 0.5f;
+	const float joinExtent = lineJoin == LineJoin::Miter ? hsw * 200.0f : hsw;
+	const float capExtent = lineCap == LineCap::Square ? hsw * 1.41421356f : hsw;
+	return bx::max<float>(joinExtent, capExtent);
+}
 
-	uint16_t ibID = UINT16_MAX;
-	const uint32_t numIB = ctx->m_NumIndexBuffers;
-	for (uint32_t i = 0; i < numIB; ++i) {
-		if (ctx->m_IndexBuffers[i].m_Count == 0) {
-			ibID = (uint16_t)i;
-			break;
-		}
+// Calculates the width of the stroke geometry. Strokes thinner than the fringe are generated
+// fringe-wide and faded out by alphaScale instead. Returns true for such thin strokes.
+static bool calcStrokeParams(float width, uint32_t flags, float avgScale, float fringeWidth, float* strokeWidth, float* alphaScale)
+{
+	const float scaledStrokeWidth = ((flags & StrokeFlags::FixedWidth) != 0) ? width : bx::clamp<float>(width * avgScale, 0.0f, 200.0f);
+	if (scaledStrokeWidth <= fringeWidth) {
+		*strokeWidth = fringeWidth;
+		*alphaScale = bx::square(bx::clamp<float>(scaledStrokeWidth, 0.0f, fringeWidth));
+		return true;
 	}
 
-	if (ibID == UINT16_MAX) {
-		ctx->m_NumIndexBuffers++;
-		ctx->m_IndexBuffers = (IndexBuffer*)bx::realloc(ctx->m_Allocator, ctx->m_IndexBuffers, sizeof(IndexBuffer) * ctx->m_NumIndexBuffers);
-		ctx->m_GPUIndexBuffers = (GPUIndexBuffer*)bx::realloc(ctx->m_Allocator, ctx->m_GPUIndexBuffers, sizeof(GPUIndexBuffer) * ctx->m_NumIndexBuffers);
+	*strokeWidth = scaledStrokeWidth;
+	*alphaScale = 1.0f;
+	return false;
+}
 
-		ibID = (uint16_t)(ctx->m_NumIndexBuffers - 1);
+// Tesselates the (already transformed) path and passes each mesh to the callback. Shared by the
+// fillPath() functions and the Tesselator.
+static void meshFillPath(Stroker* stroker, const Path* path, const float* pathVertices, uint32_t flags, Color col, bool aa, PathMeshCallback callback, void* userData)
+{
+	const PathType::Enum pathType = VG_FILL_FLAGS_PATH_TYPE(flags);
+	const FillRule::Enum fillRule = VG_FILL_FLAGS_RULE(flags);
 
-		IndexBuffer* ib = &ctx->m_IndexBuffers[ibID];
-		ib->m_Capacity = 0;
-		ib->m_Count = 0;
-		ib->m_Indices = nullptr;
+	const uint32_t numSubPaths = pathGetNumSubPaths(path);
+	const SubPath* subPaths = pathGetSubPaths(path);
 
-		GPUIndexBuffer* gpuib = &ctx->m_GPUIndexBuffers[ibID];
-		gpuib->m_bgfxHandle = BGFX_INVALID_HANDLE;
-	}
+	if (pathType == PathType::Convex) {
+		for (uint32_t i = 0; i < numSubPaths; ++i) {
+			const SubPath* subPath = &subPaths[i];
+			if (subPath->m_NumVertices < 3) {
+				continue;
+			}
 
-	return ibID;
-}
+			const float* vtx = &pathVertices[subPath->m_FirstVertexID << 1];
+			const uint32_t numPathVertices = subPath->m_NumVertices;
 
-static float* allocVertexBufferData_Vec2(Context* ctx)
-{
-#if BX_CONFIG_SUPPORTS_THREADING
-	bx::MutexScope ms(*ctx->m_DataPoolMutex);
-#endif
+			Mesh mesh;
+			const uint32_t* colors = &col;
+			uint32_t numColors = 1;
 
-	bx::AllocatorI* allocator = ctx->m_Allocator;
+			if (aa) {
+				strokerConvexFillAA(stroker, &mesh, vtx, numPathVertices, col);
+				colors = mesh.m_ColorBuffer;
+				numColors = mesh.m_NumVertices;
+			} else {
+				strokerConvexFill(stroker, &mesh, vtx, numPathVertices);
+			}
 
-	const uint32_t capacity = ctx->m_Vec2DataPoolCapacity;
-	for (uint32_t i = 0; i < capacity; ++i) {
-		float* data = ctx->m_Vec2DataPool[i];
-		// If LSB of pointer is set it means that the ptr is valid and the buffer is free for reuse.
-		if (((uintptr_t)data) & 1) {
-			// Remove the free flag
-			data = (float*)((uintptr_t)data & ~1);;
-			ctx->m_Vec2DataPool[i] = data;
-			return data;
-		} else if (data == nullptr) {
-			data = (float*)bx::alignedAlloc(allocator, sizeof(float) * 2 * ctx->m_Config.m_MaxVBVertices, 16);
-			ctx->m_Vec2DataPool[i] = data;
-			return data;
+			callback(userData, &mesh, colors, numColors);
 		}
-	}
-
-	ctx->m_Vec2DataPoolCapacity += 8;
-	ctx->m_Vec2DataPool = (float**)bx::realloc(allocator, ctx->m_Vec2DataPool, sizeof(float*) * ctx->m_Vec2DataPoolCapacity);
-	bx::memSet(&ctx->m_Vec2DataPool[capacity], 0, sizeof(float*) * (ctx->m_Vec2DataPoolCapacity - capacity));
+	} else if (pathType == PathType::Concave) {
+		strokerConcaveFillBegin(stroker);
+		for (uint32_t i = 0; i < numSubPaths; ++i) {
+			const SubPath* subPath = &subPaths[i];
+			if (subPath->m_NumVertices < 3) {
+				return;
+			}
 
-	ctx->m_Vec2DataPool[capacity] = (float*)bx::alignedAlloc(allocator, sizeof(float) * 2 * ctx->m_Config.m_MaxVBVertices, 16);
-	return ctx->m_Vec2DataPool[capacity];
-}
+			const float* vtx = &pathVertices[subPath->m_FirstVertexID << 1];
+			const uint32_t numPathVertices = subPath->m_NumVertices;
+			strokerConcaveFillAddContour(stroker, vtx, numPathVertices);
+		}
 
-static uint32_t* allocVertexBufferData_Uint32(Context* ctx)
-{
-#if BX_CONFIG_SUPPORTS_THREADING
-	bx::MutexScope ms(*ctx->m_DataPoolMutex);
-#endif
+		Mesh mesh;
+		const uint32_t* colors = &col;
+		uint32_t numColors = 1;
 
-	bx::AllocatorI* allocator = ctx->m_Allocator;
+		bool decomposed = false;
+		if (aa) {
+			decomposed = strokerConcaveFillEndAA(stroker, &mesh, col, fillRule);
+			colors = mesh.m_ColorBuffer;
+			numColors = mesh.m_NumVertices;
+		} else {
+			decomposed = strokerConcaveFillEnd(stroker, &mesh, fillRule);
+		}
 
-	const uint32_t capacity = ctx->m_Uint32DataPoolCapacity;
-	for (uint32_t i = 0; i < capacity; ++i) {
-		uint32_t* data = ctx->m_Uint32DataPool[i];
-		// If LSB of pointer is set it means that the ptr is valid and the buffer is free for reuse.
-		if (((uintptr_t)data) & 1) {
-			// Remove the free flag
-			data = (uint32_t*)((uintptr_t)data & ~1);
-			ctx->m_Uint32DataPool[i] = data;
-			return data;
-		} else if (data == nullptr) {
-			data = (uint32_t*)bx::alignedAlloc(allocator, sizeof(uint32_t) * ctx->m_Config.m_MaxVBVertices, 16);
-			ctx->m_Uint32DataPool[i] = data;
-			return data;
+		VG_WARN(decomposed, "Failed to triangulate concave polygon");
+		if (decomposed) {
+			callback(userData, &mesh, colors, numColors);
 		}
 	}
-
-	ctx->m_Uint32DataPoolCapacity += 8;
-	ctx->m_Uint32DataPool = (uint32_t**)bx::realloc(allocator, ctx->m_Uint32DataPool, sizeof(uint32_t*) * ctx->m_Uint32DataPoolCapacity);
-	bx::memSet(&ctx->m_Uint32DataPool[capacity], 0, sizeof(uint32_t*) * (ctx->m_Uint32DataPoolCapacity - capacity));
-
-	ctx->m_Uint32DataPool[capacity] = (uint32_t*)bx::alignedAlloc(allocator, sizeof(uint32_t) * ctx->m_Config.m_MaxVBVertices, 16);
-	return ctx->m_Uint32DataPool[capacity];
 }
 
-#if VG_CONFIG_UV_INT16
-static int16_t* allocVertexBufferData_UV(Context* ctx)
+// Strokes each sub-path of the (already transformed) path and passes the meshes to the callback.
+// strokeWidth and isThin come from calcStrokeParams().
+static void meshStrokePath(Stroker* stroker, const Path* path, const float* pathVertices, uint32_t flags, Color col, float strokeWidth, bool isThin, bool aa, PathMeshCallback callback, void* userData)
 {
-#if BX_CONFIG_SUPPORTS_THREADING
-	bx::MutexScope ms(*ctx->m_DataPoolMutex);
-#endif
+	const LineJoin::Enum lineJoin = VG_STROKE_FLAGS_LINE_JOIN(flags);
+	const LineCap::Enum lineCap = VG_STROKE_FLAGS_LINE_CAP(flags);
 
-	bx::AllocatorI* allocator = ctx->m_Allocator;
+	const uint32_t numSubPaths = pathGetNumSubPaths(path);
+	const SubPath* subPaths = pathGetSubPaths(path);
 
-	const uint32_t capacity = ctx->m_UVDataPoolCapacity;
-	for (uint32_t i = 0; i < capacity; ++i) {
-		int16_t* data = ctx->m_UVDataPool[i];
-
-		// If LSB of pointer is set it means that the ptr is valid and the buffer is free for reuse.
-		if (((uintptr_t)data) & 1) {
-			// Remove the free flag
-			data = (int16_t*)((uintptr_t)data & ~1);
-			ctx->m_UVDataPool[i] = data;
-			return data;
-		} else if (data == nullptr) {
-			data = (int16_t*)bx::alignedAlloc(allocator, sizeof(int16_t) * 2 * ctx->m_Config.m_MaxVBVertices, 16);
-			ctx->m_UVDataPool[i] = data;
-			return data;
+	for (uint32_t iSubPath = 0; iSubPath < numSubPaths; ++iSubPath) {
+		const SubPath* subPath = &subPaths[iSubPath];
+		if (subPath->m_NumVertices < 2) {
+			continue;
 		}
-	}
-
-	ctx->m_UVDataPoolCapacity += 8;
-	ctx->m_UVDataPool = (int16_t**)bx::realloc(allocator, ctx->m_UVDataPool, sizeof(int16_t*) * ctx->m_UVDataPoolCapacity);
-	bx::memSet(&ctx->m_UVDataPool[capacity], 0, sizeof(int16_t*) * (ctx->m_UVDataPoolCapacity - capacity));
 
-	ctx->m_UVDataPool[capacity] = (int16_t*)bx::alignedAlloc(allocator, sizeof(int16_t) * 2 * ctx->m_Config.m_MaxVBVertices, 16);
-	return ctx->m_UVDataPool[capacity];
-}
-#endif
+		const float* vtx = &pathVertices[subPath->m_FirstVertexID << 1];
+		const uint32_t numPathVertices = subPath->m_NumVertices;
+		const bool isClosed = subPath->m_IsClosed;
 
-static void releaseVertexBufferData_Vec2(Context* ctx, float* data)
-{
-#if BX_CONFIG_SUPPORTS_THREADING
-	bx::MutexScope ms(*ctx->m_DataPoolMutex);
-#endif
+		Mesh mesh;
+		const uint32_t* colors = &col;
+		uint32_t numColors = 1;
+		if (aa) {
+			if (isThin) {
+				strokerPolylineStrokeAAThin(stroker, &mesh, vtx, numPathVertices, isClosed, col, lineCap, lineJoin);
+			} else {
+				strokerPolylineStrokeAA(stroker, &mesh, vtx, numPathVertices, isClosed, col, strokeWidth, lineCap, lineJoin);
+			}
 
-	VG_CHECK(data != nullptr, "Tried to release a null vertex buffer");
-	const uint32_t capacity = ctx->m_Vec2DataPoolCapacity;
-	for (uint32_t i = 0; i < capacity; ++i) {
-		if (ctx->m_Vec2DataPool[i] == data) {
-			// Mark buffer as free by setting the LSB of the ptr to 1.
-			ctx->m_Vec2DataPool[i] = (float*)((uintptr_t)ctx->m_Vec2DataPool[i] | 1);
-			break;
+			colors = mesh.m_ColorBuffer;
+			numColors = mesh.m_NumVertices;
+		} else {
+			strokerPolylineStroke(stroker, &mesh, vtx, numPathVertices, isClosed, strokeWidth, lineCap, lineJoin);
 		}
+
+		callback(userData, &mesh, colors, numColors);
 	}
 }
 
-static void releaseVertexBufferData_Uint32(Context* ctx, uint32_t* data)
+// Sets the vertex streams and the index range of the specified draw command for the next submit.
+// Clip commands use only the position stream and only Textured commands use the UV stream.
+// Draw commands of cached command lists also set their model matrix.
+static void setDrawCommandBuffers(Context* ctx, const DrawCommand* cmd)
 {
-#if BX_CONFIG_SUPPORTS_THREADING
-	bx::MutexScope ms(*ctx->m_DataPoolMutex);
-#endif
+	const uint32_t firstVertexID = cmd->m_FirstVertexID;
+	const uint32_t numVertices = cmd->m_NumVertices;
+	const bool hasColor = cmd->m_Type != DrawCommand::Type::Clip;
+	const bool hasUV = cmd->m_Type == DrawCommand::Type::Textured;
+	const GPUVertexBuffer* gpuvb = &ctx->m_GPUVertexBuffers[cmd->m_VertexBufferID];
 
-	VG_CHECK(data != nullptr, "Tried to release a null vertex buffer");
-	const uint32_t capacity = ctx->m_Uint32DataPoolCapacity;
-	for (uint32_t i = 0; i < capacity; ++i) {
-		if (ctx->m_Uint32DataPool[i] == data) {
-			// Mark buffer as free by setting the LSB of the ptr to 1.
-			ctx->m_Uint32DataPool[i] = (uint32_t*)((uintptr_t)ctx->m_Uint32DataPool[i] | 1);
-			break;
+#if VG_CONFIG_STATIC_CACHED_GEOMETRY
+	if (bgfx::isValid(cmd->m_StaticIndexBufferHandle)) {
+		bgfx::setVertexBuffer(0, cmd->m_StaticPosBufferHandle, firstVertexID, numVertices);
+		if (hasColor) {
+			bgfx::setVertexBuffer(1, cmd->m_StaticColorBufferHandle, firstVertexID, numVertices);
 		}
+		if (hasUV) {
+			bgfx::setVertexBuffer(2, cmd->m_StaticUVBufferHandle, firstVertexID, numVertices);
+		}
+		bgfx::setIndexBuffer(cmd->m_StaticIndexBufferHandle, cmd->m_FirstIndexID, cmd->m_NumIndices);
+
+		float modelMtx[16];
+		bx::mtxIdentity(modelMtx);
+		modelMtx[0] = cmd->m_TransformMtx[0];
+		modelMtx[1] = cmd->m_TransformMtx[1];
+		modelMtx[4] = cmd->m_TransformMtx[2];
+		modelMtx[5] = cmd->m_TransformMtx[3];
+		modelMtx[12] = cmd->m_TransformMtx[4];
+		modelMtx[13] = cmd->m_TransformMtx[5];
+		bgfx::setTransform(modelMtx);
+		return;
 	}
-}
-
-#if VG_CONFIG_UV_INT16
-static void releaseVertexBufferData_UV(Context* ctx, int16_t* data)
-{
-#if BX_CONFIG_SUPPORTS_THREADING
-	bx::MutexScope ms(*ctx->m_DataPoolMutex);
 #endif
 
-	VG_CHECK(data != nullptr, "Tried to release a null vertex buffer");
-	const uint32_t capacity = ctx->m_UVDataPoolCapacity;
-	for (uint32_t i = 0; i < capacity; ++i) {
-		if (ctx->m_UVDataPool[i] == data) {
-			// Mark buffer as free by setting the LSB of the ptr to 1.
-			ctx->m_UVDataPool[i] = (int16_t*)((uintptr_t)ctx->m_UVDataPool[i] | 1);
-			break;
+#if VG_CONFIG_TRANSIENT_BUFFERS
+	const VertexBuffer* vb = &ctx->m_VertexBuffers[cmd->m_VertexBufferID];
+	if (vb->m_IsTransient) {
+		bgfx::setVertexBuffer(0, &vb->m_TransientPos, firstVertexID, numVertices);
+		if (hasColor) {
+			bgfx::setVertexBuffer(1, &vb->m_TransientColor, firstVertexID, numVertices);
 		}
-	}
-}
+		if (hasUV) {
+			bgfx::setVertexBuffer(2, &vb->m_TransientUV, firstVertexID, numVertices);
+		}
+	} else
 #endif
+	{
+		bgfx::setVertexBuffer(0, gpuvb->m_PosBufferHandle, firstVertexID, numVertices);
+		if (hasColor) {
+			bgfx::setVertexBuffer(1, gpuvb->m_ColorBufferHandle, firstVertexID, numVertices);
+		}
+		if (hasUV) {
+			bgfx::setVertexBuffer(2, gpuvb->m_UVBufferHandle, firstVertexID, numVertices);
+		}
+	}
 
-static void releaseIndexBuffer(Context* ctx, uint16_t* data)
-{
-#if BX_CONFIG_SUPPORTS_THREADING
-	bx::MutexScope ms(*ctx->m_DataPoolMutex);
+#if VG_CONFIG_TRANSIENT_BUFFERS
+	if (ctx->m_IsTransientIndexBuffer) {
+		bgfx::setIndexBuffer(&ctx->m_TransientIndexBuffer, cmd->m_FirstIndexID, cmd->m_NumIndices);
+		return;
+	}
 #endif
 
-	VG_CHECK(data != nullptr, "Tried to release a null vertex buffer");
-	const uint32_t numIB = ctx->m_NumIndexBuffers;
-	for (uint32_t i = 0; i < numIB; ++i) {
-		if (ctx->m_IndexBuffers[i].m_Indices == data) {
-			// Reset the ib for reuse.
-			ctx->m_IndexBuffers[i].m_Count = 0;
-			break;
-		}
-	}
+	const GPUIndexBuffer* gpuib = &ctx->m_GPUIndexBuffers[ctx->m_ActiveIndexBufferID];
+	bgfx::setIndexBuffer(gpuib->m_bgfxHandle, cmd->m_FirstIndexID, cmd->m_NumIndices);
 }
 
-static void createDrawCommand_VertexColor(Context* ctx, const float* vtx, uint32_t numVertices, const uint32_t* colors, uint32_t numColors, const uint16_t* indices, uint32_t numIndices)
+// viewMtx and projMtx are the view's transform if it has been set by vg (nullptr if both are unknown).
+static void submitDrawCommands(Context* ctx, uint16_t viewID, const float* viewMtx, const float* projMtx)
 {
-	// Allocate the draw command
-	const ImageHandle fontImg = ctx->m_FontImages[0];
-	DrawCommand* cmd = allocDrawCommand(ctx, numVertices, numIndices, DrawCommand::Type::Textured, fontImg.idx);
+	const uint32_t numDrawCommands = ctx->m_NumDrawCommands;
+	const uint16_t canvasWidth = ctx->m_CanvasWidth;
+	const uint16_t canvasHeight = ctx->m_CanvasHeight;
+	const float devicePixelRatio = ctx->m_DevicePixelRatio;
 
-	// Vertex buffer
-	VertexBuffer* vb = &ctx->m_VertexBuffers[cmd->m_VertexBufferID];
-	const uint32_t vbOffset = cmd->m_FirstVertexID + cmd->m_NumVertices;
+	uint16_t prevScissorRect[4] = { 0, 0, canvasWidth, canvasHeight};
+	uint16_t prevScissorID = UINT16_MAX;
+	uint32_t prevClipCmdID = UINT32_MAX;
+	uint32_t stencilState = BGFX_STENCIL_NONE;
 
-	float* dstPos = &vb->m_Pos[vbOffset << 1];
-	bx::memCopy(dstPos, vtx, sizeof(float) * 2 * numVertices);
+	const uint64_t drawState = 0
+		| BGFX_STATE_WRITE_A
+		| BGFX_STATE_WRITE_RGB
+		| BGFX_STATE_BLEND_FUNC_SEPARATE(BGFX_STATE_BLEND_SRC_ALPHA, BGFX_STATE_BLEND_INV_SRC_ALPHA, BGFX_STATE_BLEND_ONE, BGFX_STATE_BLEND_INV_SRC_ALPHA);
 
-	const uv_t* uv = getWhitePixelUV(ctx);
+	for (uint32_t iCmd = 0; iCmd < numDrawCommands; ++iCmd) {
+		DrawCommand* cmd = &ctx->m_DrawCommands[iCmd];
 
-	uv_t* dstUV = &vb->m_UV[vbOffset << 1];
-#if VG_CONFIG_UV_INT16
-	vgutil::memset32(dstUV, numVertices, &uv[0]);
-#else
-	vgutil::memset64(dstUV, numVertices, &uv[0]);
-#endif
+		const ClipState* cmdClipState = &cmd->m_ClipState;
+		if (cmdClipState->m_FirstCmdID != prevClipCmdID) {
+			prevClipCmdID = cmdClipState->m_FirstCmdID;
+			const uint8_t stencilValue = cmd->m_StencilValue;
+			const uint32_t numClipCommands = cmdClipState->m_NumCmds;
+			if (stencilValue != 0) {
+				if ((cmd->m_StencilFlags & DrawCommand::StencilFlags::Clear) != 0) {
+					submitStencilClear(ctx, viewID, viewMtx, projMtx);
+				}
 
-	uint32_t* dstColor = &vb->m_Color[vbOffset];
-	if (numColors == numVertices) {
-		bx::memCopy(dstColor, colors, sizeof(uint32_t) * numVertices);
-	} else {
-		VG_CHECK(numColors == 1, "Invalid size of color array passed.");
-		vgutil::memset32(dstColor, numVertices, colors);
-	}
+				const uint32_t numClipCommandsToWrite = (cmd->m_StencilFlags & DrawCommand::StencilFlags::WriteClipMask) != 0
+					? numClipCommands
+					: 0;
 
-	// Index buffer
-	IndexBuffer* ib = &ctx->m_IndexBuffers[ctx->m_ActiveIndexBufferID];
-	uint16_t* dstIndex = &ib->m_Indices[cmd->m_FirstIndexID + cmd->m_NumIndices];
-	vgutil::batchTransformDrawIndices(indices, numIndices, dstIndex, (uint16_t)cmd->m_NumVertices);
+				for (uint32_t iClip = 0; iClip < numClipCommandsToWrite; ++iClip) {
+					VG_CHECK(cmdClipState->m_FirstCmdID + iClip < ctx->m_NumClipCommands, "Invalid clip command index");
 
-	cmd->m_NumVertices += numVertices;
-	cmd->m_NumIndices += numIndices;
-}
+					DrawCommand* clipCmd = &ctx->m_ClipCommands[cmdClipState->m_FirstCmdID + iClip];
 
-static void createDrawCommand_ImagePattern(Context* ctx, ImagePatternHandle imgPatternHandle, const float* vtx, uint32_t numVertices, const uint32_t* colors, uint32_t numColors, const uint16_t* indices, uint32_t numIndices)
-{
-	DrawCommand* cmd = allocDrawCommand(ctx, numVertices, numIndices, DrawCommand::Type::ImagePattern, imgPatternHandle.idx);
+					setDrawCommandBuffers(ctx, clipCmd);
 
-	VertexBuffer* vb = &ctx->m_VertexBuffers[cmd->m_VertexBufferID];
-	const uint32_t vbOffset = cmd->m_FirstVertexID + cmd->m_NumVertices;
+					// Set scissor.
+					{
+						const uint16_t* cmdScissorRect = &clipCmd->m_ScissorRect[0];
+						if (!bx::memCmp(cmdScissorRect, &prevScissorRect[0], sizeof(uint16_t) * 4)) {
+							bgfx::setScissor(prevScissorID);
+						} else {
+							prevScissorID = bgfx::setScissor(cmdScissorRect[0] * devicePixelRatio, cmdScissorRect[1] * devicePixelRatio, cmdScissorRect[2] * devicePixelRatio, cmdScissorRect[3] * devicePixelRatio);
+							bx::memCopy(prevScissorRect, cmdScissorRect, sizeof(uint16_t) * 4);
+						}
+					}
 
-	float* dstPos = &vb->m_Pos[vbOffset << 1];
-	bx::memCopy(dstPos, vtx, sizeof(float) * 2 * numVertices);
+					VG_CHECK(clipCmd->m_Type == DrawCommand::Type::Clip, "Invalid clip command");
+					VG_CHECK(clipCmd->m_HandleID == UINT16_MAX, "Invalid clip command image handle");
 
-	uint32_t* dstColor = &vb->m_Color[vbOffset];
-	if (numColors == numVertices) {
-		bx::memCopy(dstColor, colors, sizeof(uint32_t) * numVertices);
-	} else {
-		VG_CHECK(numColors == 1, "Invalid size of color array passed.");
-		vgutil::memset32(dstColor, numVertices, colors);
-	}
+					const uint32_t clipStencilState = 0
+						| BGFX_STENCIL_TEST_ALWAYS             // pass always
+						| BGFX_STENCIL_FUNC_REF(stencilValue)  // value = stencilValue
+						| BGFX_STENCIL_FUNC_RMASK(0xff)
+						| BGFX_STENCIL_OP_FAIL_S_REPLACE
+						| BGFX_STENCIL_OP_FAIL_Z_REPLACE
+						| BGFX_STENCIL_OP_PASS_Z_REPLACE;
 
-	IndexBuffer* ib = &ctx->m_IndexBuffers[ctx->m_ActiveIndexBufferID];
-	uint16_t* dstIndex = &ib->m_Indices[cmd->m_FirstIndexID + cmd->m_NumIndices];
-	vgutil::batchTransformDrawIndices(indices, numIndices, dstIndex, (uint16_t)cmd->m_NumVertices);
+					bgfx::setState(0);
+					bgfx::setStencil(clipStencilState, BGFX_STENCIL_NONE);
 
-	cmd->m_NumVertices += numVertices;
-	cmd->m_NumIndices += numIndices;
-}
+					// TODO: Check if it's better to use Type_TexturedVertexColor program here to avoid too many 
+					// state switches.
+					bgfx::submit(viewID, ctx->m_ProgramHandle[DrawCommand::Type::Clip]);
+					ctx->m_Stats.m_NumClipDrawCalls++;
+#if VG_CONFIG_RECORD_DRAW_CALLS
+					recordDrawCall(ctx, viewID, clipCmd, 0, clipStencilState, UINT16_MAX, nullptr, nullptr);
+#endif
+				}
 
-static void createDrawCommand_ColorGradient(Context* ctx, GradientHandle gradientHandle, const float* vtx, uint32_t numVertices, const uint32_t* colors, uint32_t numColors, const uint16_t* indices, uint32_t numIndices)
-{
-	DrawCommand* cmd = allocDrawCommand(ctx, numVertices, numIndices, DrawCommand::Type::ColorGradient, gradientHandle.idx);
+				stencilState = 0
+					| (cmdClipState->m_Rule == ClipRule::In ? BGFX_STENCIL_TEST_EQUAL : BGFX_STENCIL_TEST_NOTEQUAL)
+					| BGFX_STENCIL_FUNC_REF(stencilValue)
+					| BGFX_STENCIL_FUNC_RMASK(0xff)
+					| BGFX_STENCIL_OP_FAIL_S_KEEP
+					| BGFX_STENCIL_OP_FAIL_Z_KEEP
+					| BGFX_STENCIL_OP_PASS_Z_KEEP;
+			} else {
+				stencilState = BGFX_STENCIL_NONE;
+			}
+		}
 
-	VertexBuffer* vb = &ctx->m_VertexBuffers[cmd->m_VertexBufferID];
-	const uint32_t vbOffset = cmd->m_FirstVertexID + cmd->m_NumVertices;
+		setDrawCommandBuffers(ctx, cmd);
 
-	float* dstPos = &vb->m_Pos[vbOffset << 1];
-	bx::memCopy(dstPos, vtx, sizeof(float) * 2 * numVertices);
+		// Set scissor.
+		{
+			const uint16_t* cmdScissorRect = &cmd->m_ScissorRect[0];
+			if (!bx::memCmp(cmdScissorRect, &prevScissorRect[0], sizeof(uint16_t) * 4)) {
+				bgfx::setScissor(prevScissorID);
+			} else {
+				prevScissorID = bgfx::setScissor(cmdScissorRect[0] * devicePixelRatio, cmdScissorRect[1] * devicePixelRatio, cmdScissorRect[2] * devicePixelRatio, cmdScissorRect[3] * devicePixelRatio);
+				bx::memCopy(prevScissorRect, cmdScissorRect, sizeof(uint16_t) * 4);
+			}
+		}
 
-	uint32_t* dstColor = &vb->m_Color[vbOffset];
-	if (numColors == numVertices) {
-		bx::memCopy(dstColor, colors, sizeof(uint32_t) * numVertices);
-	} else {
-		VG_CHECK(numColors == 1, "Invalid size of color array passed.");
-		vgutil::memset32(dstColor, numVertices, colors);
-	}
+		if (cmd->m_Type == DrawCommand::Type::Textured) {
+			VG_CHECK(cmd->m_HandleID != UINT16_MAX, "Invalid image handle");
+			Image* tex = &ctx->m_Images[cmd->m_HandleID];
 
-	IndexBuffer* ib = &ctx->m_IndexBuffers[ctx->m_ActiveIndexBufferID];
-	uint16_t* dstIndex = &ib->m_Indices[cmd->m_FirstIndexID + cmd->m_NumIndices];
-	vgutil::batchTransformDrawIndices(indices, numIndices, dstIndex, (uint16_t)cmd->m_NumVertices);
+			bgfx::setTexture(0, ctx->m_TexUniform, tex->m_bgfxHandle, tex->m_Flags);
 
-	cmd->m_NumVertices += numVertices;
-	cmd->m_NumIndices += numIndices;
-}
+			bgfx::setState(drawState);
+			bgfx::setStencil(stencilState);
 
-static void createDrawCommand_Clip(Context* ctx, const float* vtx, uint32_t numVertices, const uint16_t* indices, uint32_t numIndices)
-{
-	// Allocate the draw command
-	DrawCommand* cmd = allocClipCommand(ctx, numVertices, numIndices);
+			bgfx::submit(viewID, ctx->m_ProgramHandle[DrawCommand::Type::Textured]);
+			ctx->m_Stats.m_NumDrawCalls++;
+#if VG_CONFIG_RECORD_DRAW_CALLS
+			recordDrawCall(ctx, viewID, cmd, drawState, stencilState, cmd->m_HandleID, nullptr, nullptr);
+#endif
+		} else if (cmd->m_Type == DrawCommand::Type::ColorGradient) {
+			VG_CHECK(cmd->m_HandleID != UINT16_MAX, "Invalid gradient handle");
+			Gradient* grad = &ctx->m_Gradients[cmd->m_HandleID];
 
-	// Vertex buffer
-	VertexBuffer* vb = &ctx->m_VertexBuffers[cmd->m_VertexBufferID];
-	const uint32_t vbOffset = cmd->m_FirstVertexID + cmd->m_NumVertices;
+			const float* paintMtx = grad->m_Matrix;
+#if VG_CONFIG_STATIC_CACHED_GEOMETRY
+			float staticPaintMtx[9];
+			if (bgfx::isValid(cmd->m_StaticIndexBufferHandle)) {
+				calcStaticPaintMatrix(paintMtx, cmd->m_TransformMtx, staticPaintMtx);
+				paintMtx = staticPaintMtx;
+			}
+#endif
 
-	float* dstPos = &vb->m_Pos[vbOffset << 1];
-	bx::memCopy(dstPos, vtx, sizeof(float) * 2 * numVertices);
+			bgfx::setUniform(ctx->m_PaintMatUniform, paintMtx, 1);
+			bgfx::setUniform(ctx->m_ExtentRadiusFeatherUniform, grad->m_Params, 1);
+			bgfx::setUniform(ctx->m_InnerColorUniform, grad->m_InnerColor, 1);
+			bgfx::setUniform(ctx->m_OuterColorUniform, grad->m_OuterColor, 1);
 
-	// Index buffer
-	IndexBuffer* ib = &ctx->m_IndexBuffers[ctx->m_ActiveIndexBufferID];
-	uint16_t* dstIndex = &ib->m_Indices[cmd->m_FirstIndexID + cmd->m_NumIndices];
-	vgutil::batchTransformDrawIndices(indices, numIndices, dstIndex, (uint16_t)cmd->m_NumVertices);
+			bgfx::setState(drawState);
+			bgfx::setStencil(stencilState);
 
-	cmd->m_NumVertices += numVertices;
-	cmd->m_NumIndices += numIndices;
+			bgfx::submit(viewID, ctx->m_ProgramHandle[DrawCommand::Type::ColorGradient]);
+			ctx->m_Stats.m_NumDrawCalls++;
+#if VG_CONFIG_RECORD_DRAW_CALLS
+			recordDrawCall(ctx, viewID, cmd, drawState, stencilState, UINT16_MAX, paintMtx, grad);
+#endif
+		} else if(cmd->m_Type == DrawCommand::Type::ImagePattern) {
+			VG_CHECK(cmd->m_HandleID != UINT16_MAX, "Invalid image pattern handle");
+			ImagePattern* imgPattern = &ctx->m_ImagePatterns[cmd->m_HandleID];
+
+			VG_CHECK(isValid(imgPattern->m_ImageHandle), "Invalid image handle in pattern");
+			Image* tex = &ctx->m_Images[imgPattern->m_ImageHandle.idx];
+
+			const float* paintMtx = imgPattern->m_Matrix;
+#if VG_CONFIG_STATIC_CACHED_GEOMETRY
+			float staticPaintMtx[9];
+			if (bgfx::isValid(cmd->m_StaticIndexBufferHandle)) {
+				calcStaticPaintMatrix(paintMtx, cmd->m_TransformMtx, staticPaintMtx);
+				paintMtx = staticPaintMtx;
+			}
+#endif
+
+			bgfx::setTexture(0, ctx->m_TexUniform, tex->m_bgfxHandle, tex->m_Flags);
+			bgfx::setUniform(ctx->m_PaintMatUniform, paintMtx, 1);
+
+			bgfx::setState(drawState);
+			bgfx::setStencil(stencilState);
+
+			bgfx::submit(viewID, ctx->m_ProgramHandle[DrawCommand::Type::ImagePattern]);
+			ctx->m_Stats.m_NumDrawCalls++;
+#if VG_CONFIG_RECORD_DRAW_CALLS
+			recordDrawCall(ctx, viewID, cmd, drawState, stencilState, imgPattern->m_ImageHandle.idx, paintMtx, nullptr);
+#endif
+		} else {
+			VG_CHECK(false, "Unknown draw command type");
+		}
+	}
 }
 
-// NOTE: Side effect: Resets m_ForceNewDrawCommand and m_ForceNewClipCommand if the current
-// vertex buffer cannot hold the specified amount of vertices.
-static uint32_t allocVertices(Context* ctx, uint32_t numVertices, uint32_t* vbID)
+// Resets the stencil buffer to 0 by rendering a quad which covers the whole viewport. If the view's
+// transform is known, the quad is specified in clip space and the model matrix undoes the view
+// transform. Otherwise the view is assumed to map the canvas to the viewport.
+static void submitStencilClear(Context* ctx, uint16_t viewID, const float* viewMtx, const float* projMtx)
 {
-	VG_CHECK(numVertices < ctx->m_Config.m_MaxVBVertices, "A single draw call cannot have more than %d vertices", ctx->m_Config.m_MaxVBVertices);
-
-	// Check if the current vertex buffer can hold the specified amount of vertices
-	VertexBuffer* vb = &ctx->m_VertexBuffers[ctx->m_NumVertexBuffers - 1];
-	if (vb->m_Count + numVertices > ctx->m_Config.m_MaxVBVertices) {
-		// It cannot. Allocate a new vb.
-		vb = allocVertexBuffer(ctx);
-		VG_CHECK(vb, "Failed to allocate new Vertex Buffer");
+	const bgfx::VertexLayout& decl = ctx->m_PosVertexDecl;
 
-		// The currently active vertex buffer has changed so force a new draw command.
-		ctx->m_ForceNewDrawCommand = true;
-		ctx->m_ForceNewClipCommand = true;
+	if (bgfx::getAvailTransientVertexBuffer(4, decl) < 4 || bgfx::getAvailTransientIndexBuffer(6) < 6) {
+		VG_WARN(false, "Not enough transient buffer space to clear the stencil buffer. Clip masks might be wrong.");
+		return;
 	}
 
-	*vbID = (uint32_t)(vb - ctx->m_VertexBuffers);
-	
-	const uint32_t firstVertexID = vb->m_Count;
-	vb->m_Count += numVertices;
-	return firstVertexID;
+	bgfx::TransientVertexBuffer tvb;
+	bgfx::TransientIndexBuffer tib;
+	bgfx::allocTransientVertexBuffer(&tvb, 4, decl);
+	bgfx::allocTransientIndexBuffer(&tib, 6);
+
+	// NOTE: The stencil program only reads the positions.
+	float quad[8];
+	if (viewMtx || projMtx) {
+		// NOTE: bgfx uses identity for a nullptr view or projection matrix.
+		float identityMtx[16];
+		bx::mtxIdentity(identityMtx);
+
+		float viewProjMtx[16];
+		float invViewProjMtx[16];
+		bx::mtxMul(viewProjMtx, viewMtx ? viewMtx : identityMtx, projMtx ? projMtx : identityMtx);
+		bx::mtxInverse(invViewProjMtx, viewProjMtx);
+		bgfx::setTransform(invViewProjMtx);
+
+		const float clipQuad[8] = { -1.0f, -1.0f, 1.0f, -1.0f, 1.0f, 1.0f, -1.0f, 1.0f };
+		bx::memCopy(quad, clipQuad, sizeof(float) * 8);
+	} else {
+		const float w = (float)ctx->m_CanvasWidth;
+		const float h = (float)ctx->m_CanvasHeight;
+		const float canvasQuad[8] = { 0.0f, 0.0f, w, 0.0f, w, h, 0.0f, h };
+		bx::memCopy(quad, canvasQuad, sizeof(float) * 8);
+	}
+
+	const uint32_t stride = decl.getStride();
+	for (uint32_t i = 0; i < 4; ++i) {
+		bx::memCopy(&tvb.data[i * stride], &quad[i * 2], sizeof(float) * 2);
+	}
+
+	uint16_t* indices = (uint16_t*)tib.data;
+	indices[0] = 0; indices[1] = 1; indices[2] = 2;
+	indices[3] = 0; indices[4] = 2; indices[5] = 3;
+
+	const uint32_t stencilState = 0
+		| BGFX_STENCIL_TEST_ALWAYS
+		| BGFX_STENCIL_FUNC_REF(0)
+		| BGFX_STENCIL_FUNC_RMASK(0xff)
+		| BGFX_STENCIL_OP_FAIL_S_REPLACE
+		| BGFX_STENCIL_OP_FAIL_Z_REPLACE
+		| BGFX_STENCIL_OP_PASS_Z_REPLACE;
+
+	bgfx::setVertexBuffer(0, &tvb, 0, 4);
+	bgfx::setIndexBuffer(&tib, 0, 6);
+	bgfx::setState(0);
+	bgfx::setStencil(stencilState, BGFX_STENCIL_NONE);
+	bgfx::submit(viewID, ctx->m_ProgramHandle[DrawCommand::Type::Clip]);
+	ctx->m_Stats.m_NumClipDrawCalls++;
+#if VG_CONFIG_RECORD_DRAW_CALLS
+	recordDrawCall(ctx, viewID, nullptr, 0, stencilState, UINT16_MAX, nullptr, nullptr);
+#endif
 }
 
-static uint32_t allocIndices(Context* ctx, uint32_t numIndices)
+#if VG_CONFIG_RECORD_DRAW_CALLS
+// Passes a copy of the draw call which has just been submitted to bgfx to the user's callback.
+// cmd is nullptr for the stencil clear quad.
+static void recordDrawCall(Context* ctx, uint16_t viewID, const DrawCommand* cmd, uint64_t state, uint32_t stencil, uint16_t imageHandle, const float* paintMtx, const Gradient* grad)
 {
-	IndexBuffer* ib = &ctx->m_IndexBuffers[ctx->m_ActiveIndexBufferID];
-	if (ib->m_Count + numIndices > ib->m_Capacity) {
-		const uint32_t nextCapacity = ib->m_Capacity != 0 ? (ib->m_Capacity * 3) / 2 : 32;
+	if (!ctx->m_DrawCallCallback) {
+		return;
+	}
 
-		ib->m_Capacity = bx::uint32_max(nextCapacity, ib->m_Count + numIndices);
-		ib->m_Indices = (uint16_t*)bx::alignedRealloc(ctx->m_Allocator, ib->m_Indices, sizeof(uint16_t) * ib->m_Capacity, 16);
+	DrawCall drawCall;
+	bx::memSet(&drawCall, 0, sizeof(DrawCall));
+	drawCall.m_ViewID = viewID;
+	drawCall.m_State = state;
+	drawCall.m_Stencil = stencil;
+	drawCall.m_ImageHandle = imageHandle;
+
+	if (cmd) {
+		drawCall.m_Program = (DrawCall::Program::Enum)cmd->m_Type;
+		bx::memCopy(drawCall.m_ScissorRect, cmd->m_ScissorRect, sizeof(uint16_t) * 4);
+		drawCall.m_VertexBufferID = cmd->m_VertexBufferID;
+		drawCall.m_FirstVertexID = cmd->m_FirstVertexID;
+		drawCall.m_NumVertices = cmd->m_NumVertices;
+		drawCall.m_FirstIndexID = cmd->m_FirstIndexID;
+		drawCall.m_NumIndices = cmd->m_NumIndices;
+#if VG_CONFIG_STATIC_CACHED_GEOMETRY
+		if (bgfx::isValid(cmd->m_StaticIndexBufferHandle)) {
+			drawCall.m_VertexBufferID = UINT32_MAX;
+		}
+#endif
+	} else {
+		drawCall.m_Program = DrawCall::Program::Stencil;
+		drawCall.m_VertexBufferID = UINT32_MAX;
+		drawCall.m_NumVertices = 4;
+		drawCall.m_NumIndices = 6;
 	}
 
-	const uint32_t firstIndexID = ib->m_Count;
-	ib->m_Count += numIndices;
-	return firstIndexID;
+	if (paintMtx) {
+		bx::memCopy(drawCall.m_PaintMatrix, paintMtx, sizeof(float) * 9);
+	}
+
+	if (grad) {
+		bx::memCopy(drawCall.m_ExtentRadiusFeather, grad->m_Params, sizeof(float) * 4);
+		bx::memCopy(drawCall.m_InnerColor, grad->m_InnerColor, sizeof(float) * 4);
+		bx::memCopy(drawCall.m_OuterColor, grad->m_OuterColor, sizeof(float) * 4);
+	}
+
+	ctx->m_DrawCallCallback(&drawCall, ctx->m_DrawCallCallbackUserData);
 }
+#endif
 
-static DrawCommand* allocDrawCommand(Context* ctx, uint32_t numVertices, uint32_t numIndices, DrawCommand::Type::Enum type, uint16_t handle)
+
+#if VG_CONFIG_SOFTWARE_RASTERIZER
+static void rasterInitImage(const Image* img, RasterImage* rimg)
 {
-	uint32_t vertexBufferID;
-	const uint32_t firstVertexID = allocVertices(ctx, numVertices, &vertexBufferID);
-	const uint32_t firstIndexID = allocIndices(ctx, numIndices);
+	rimg->m_Data = img->m_RasterData; // Images created from external bgfx textures don't have a CPU copy.
+	rimg->m_Flags = img->m_Flags;
+	rimg->m_Width = img->m_Width;
+	rimg->m_Height = img->m_Height;
+}
 
-	const State* state = getState(ctx);
-	const float* scissor = state->m_ScissorRect;
+static void rasterInitDrawCommand(Context* ctx, const DrawCommand* cmd, const index_t* indices, RasterDrawCommand* rcmd)
+{
+	bx::memSet(rcmd, 0, sizeof(RasterDrawCommand));
 
-	if (!ctx->m_ForceNewDrawCommand && ctx->m_NumDrawCommands != 0) {
-		DrawCommand* prevCmd = &ctx->m_DrawCommands[ctx->m_NumDrawCommands - 1];
+	const VertexBuffer* vb = &ctx->m_VertexBuffers[cmd->m_VertexBufferID];
+	const uint32_t firstVertexID = cmd->m_FirstVertexID;
+	rcmd->m_Pos = &vb->m_Pos[firstVertexID * 2];
+	rcmd->m_UV = &vb->m_UV[firstVertexID * 2];
+	rcmd->m_Color = &vb->m_Color[firstVertexID];
+	rcmd->m_Indices = &indices[cmd->m_FirstIndexID];
+	rcmd->m_NumIndices = cmd->m_NumIndices;
+	bx::memCopy(rcmd->m_ScissorRect, cmd->m_ScissorRect, sizeof(uint16_t) * 4);
 
-		VG_CHECK(prevCmd->m_VertexBufferID == vertexBufferID, "Cannot merge draw commands with different vertex buffers");
-		VG_CHECK(prevCmd->m_ScissorRect[0] == (uint16_t)scissor[0]
-		      && prevCmd->m_ScissorRect[1] == (uint16_t)scissor[1] 
-		      && prevCmd->m_ScissorRect[2] == (uint16_t)scissor[2] 
-		      && prevCmd->m_ScissorRect[3] == (uint16_t)scissor[3], "Invalid scissor rect");
+	const ClipState* clipState = &cmd->m_ClipState;
+	rcmd->m_FirstClipCmdID = clipState->m_FirstCmdID;
+	rcmd->m_NumClipCmds = clipState->m_NumCmds;
+	rcmd->m_ClipRule = clipState->m_Rule;
+	rcmd->m_StencilValue = cmd->m_StencilValue;
+	rcmd->m_StencilFlags = 0
+		| ((cmd->m_StencilFlags & DrawCommand::StencilFlags::WriteClipMask) != 0 ? RasterDrawCommand::StencilFlags::WriteClipMask : 0)
+		| ((cmd->m_StencilFlags & DrawCommand::StencilFlags::Clear) != 0 ? RasterDrawCommand::StencilFlags::Clear : 0)
+		;
 
-		if (prevCmd->m_Type == type && prevCmd->m_HandleID == handle) {
-			return prevCmd;
-		}
+	RasterPaint* paint = &rcmd->m_Paint;
+	if (cmd->m_Type == DrawCommand::Type::Textured) {
+		paint->m_Type = RasterPaint::Type::Textured;
+		rasterInitImage(&ctx->m_Images[cmd->m_HandleID], &paint->m_Image);
+	} else if (cmd->m_Type == DrawCommand::Type::ColorGradient) {
+		const Gradient* grad = &ctx->m_Gradients[cmd->m_HandleID];
+		paint->m_Type = RasterPaint::Type::ColorGradient;
+		paint->m_PaintMtx = grad->m_Matrix;
+		paint->m_GradientParams = grad->m_Params;
+		paint->m_InnerColor = grad->m_InnerColor;
+		paint->m_OuterColor = grad->m_OuterColor;
+	} else if (cmd->m_Type == DrawCommand::Type::ImagePattern) {
+		const ImagePattern* imgPattern = &ctx->m_ImagePatterns[cmd->m_HandleID];
+		paint->m_Type = RasterPaint::Type::ImagePattern;
+		paint->m_PaintMtx = imgPattern->m_Matrix;
+		rasterInitImage(&ctx->m_Images[imgPattern->m_ImageHandle.idx], &paint->m_Image);
+	} else {
+		paint->m_Type = RasterPaint::Type::Clip;
 	}
+}
 
-	// The new draw command cannot be combined with the previous one. Create a new one.
-	if (ctx->m_NumDrawCommands == ctx->m_DrawCommandCapacity) {
-		ctx->m_DrawCommandCapacity = ctx->m_DrawCommandCapacity + 32;
-		ctx->m_DrawCommands = (DrawCommand*)bx::realloc(ctx->m_Allocator, ctx->m_DrawCommands, sizeof(DrawCommand) * ctx->m_DrawCommandCapacity);
+// Rasterizes the frame's draw commands into the raster target (see setRasterTarget()).
+// NOTE: Must be called before the vertex and index buffers are submitted to bgfx.
+static void rasterizeDrawCommands(Context* ctx)
+{
+	VG_SCOPED_TIMER(ctx, Timer::Raster);
+
+	const uint32_t numDrawCommands = ctx->m_NumDrawCommands;
+	const uint32_t numClipCommands = ctx->m_NumClipCommands;
+	RasterDrawCommand* cmds = (RasterDrawCommand*)arenaAlloc(ctx->m_Allocator, &ctx->m_FrameArena, sizeof(RasterDrawCommand) * (numDrawCommands + numClipCommands));
+	RasterDrawCommand* clipCmds = &cmds[numDrawCommands];
+
+	const index_t* indices = ctx->m_IndexBuffers[ctx->m_ActiveIndexBufferID].m_Indices;
+	for (uint32_t i = 0; i < numDrawCommands; ++i) {
+		rasterInitDrawCommand(ctx, &ctx->m_DrawCommands[i], indices, &cmds[i]);
+	}
+	for (uint32_t i = 0; i < numClipCommands; ++i) {
+		rasterInitDrawCommand(ctx, &ctx->m_ClipCommands[i], indices, &clipCmds[i]);
 	}
 
-	DrawCommand* cmd = &ctx->m_DrawCommands[ctx->m_NumDrawCommands];
-	ctx->m_NumDrawCommands++;
+	rasterizerDrawCommands(ctx->m_Rasterizer, cmds, numDrawCommands, clipCmds, ctx->m_DevicePixelRatio);
+}
+#endif // VG_CONFIG_SOFTWARE_RASTERIZER
 
-	cmd->m_VertexBufferID = vertexBufferID;
-	cmd->m_FirstVertexID = firstVertexID;
-	cmd->m_FirstIndexID = firstIndexID;
-	cmd->m_NumVertices = 0;
-	cmd->m_NumIndices = 0;
-	cmd->m_Type = type;
-	cmd->m_HandleID = handle;
-	cmd->m_ScissorRect[0] = (uint16_t)scissor[0];
-	cmd->m_ScissorRect[1] = (uint16_t)scissor[1];
-	cmd->m_ScissorRect[2] = (uint16_t)scissor[2];
-	cmd->m_ScissorRect[3] = (uint16_t)scissor[3];
-	bx::memCopy(&cmd->m_ClipState, &ctx->m_ClipState, sizeof(ClipState));
+static VertexBuffer* allocVertexBuffer(Context* ctx, uint32_t numVertices)
+{
+	if (ctx->m_NumVertexBuffers + 1 > ctx->m_VertexBufferCapacity) {
+		ctx->m_VertexBufferCapacity++;
+		ctx->m_VertexBuffers = (VertexBuffer*)bx::realloc(ctx->m_Allocator, ctx->m_VertexBuffers, sizeof(VertexBuffer) * ctx->m_VertexBufferCapacity);
+		ctx->m_GPUVertexBuffers = (GPUVertexBuffer*)bx::realloc(ctx->m_Allocator, ctx->m_GPUVertexBuffers, sizeof(GPUVertexBuffer) * ctx->m_VertexBufferCapacity);
 
-	ctx->m_ForceNewDrawCommand = false;
+		GPUVertexBuffer* gpuvb = &ctx->m_GPUVertexBuffers[ctx->m_VertexBufferCapacity - 1];
 
-	return cmd;
+		gpuvb->m_PosBufferHandle = BGFX_INVALID_HANDLE;
+		gpuvb->m_UVBufferHandle = BGFX_INVALID_HANDLE;
+		gpuvb->m_ColorBufferHandle = BGFX_INVALID_HANDLE;
+	}
+
+	VertexBuffer* vb = &ctx->m_VertexBuffers[ctx->m_NumVertexBuffers++];
+	vb->m_Count = 0;
+
+	allocVertexBufferStreams(ctx, vb, getVertexBufferSizeClass(ctx, numVertices));
+
+	return vb;
 }
 
-static DrawCommand* allocClipCommand(Context* ctx, uint32_t numVertices, uint32_t numIndices)
+static uint16_t allocIndexBuffer(Context* ctx)
 {
-	uint32_t vertexBufferID;
-	const uint32_t firstVertexID = allocVertices(ctx, numVertices, &vertexBufferID);
-	const uint32_t firstIndexID = allocIndices(ctx, numIndices);
-	
-	const State* state = getState(ctx);
-	const float* scissor = state->m_ScissorRect;
+	IndexBufferNode* node = ctx->m_IndexBufferFreeList;
+	if (!node) {
+		node = (IndexBufferNode*)releasedListPopAll(&ctx->m_ReleasedIndexBuffers);
+	}
 
-	if (!ctx->m_ForceNewClipCommand && ctx->m_NumClipCommands != 0) {
-		DrawCommand* prevCmd = &ctx->m_ClipCommands[ctx->m_NumClipCommands - 1];
+	bx::atomicFetchAndAdd<int32_t>(&ctx->m_NumIndexBuffersUsed, 1);
 
-		VG_CHECK(prevCmd->m_VertexBufferID == vertexBufferID, "Cannot merge clip commands with different vertex buffers");
-		VG_CHECK(prevCmd->m_ScissorRect[0] == (uint16_t)scissor[0] 
-		      && prevCmd->m_ScissorRect[1] == (uint16_t)scissor[1] 
-		      && prevCmd->m_ScissorRect[2] == (uint16_t)scissor[2] 
-		      && prevCmd->m_ScissorRect[3] == (uint16_t)scissor[3], "Invalid scissor rect");
-		VG_CHECK(prevCmd->m_Type == DrawCommand::Type::Clip, "Invalid draw command type");
+	if (node) {
+		ctx->m_IndexBufferFreeList = (IndexBufferNode*)(uintptr_t)node->m_Next;
 
-		return prevCmd;
+		// Reset the ib for reuse.
+		ctx->m_IndexBuffers[node->m_ID].m_Count = 0;
+		return node->m_ID;
 	}
 
-	// The new clip command cannot be combined with the previous one. Create a new one.
-	if (ctx->m_NumClipCommands == ctx->m_ClipCommandCapacity) {
-		ctx->m_ClipCommandCapacity = ctx->m_ClipCommandCapacity + 32;
-		ctx->m_ClipCommands = (DrawCommand*)bx::realloc(ctx->m_Allocator, ctx->m_ClipCommands, sizeof(DrawCommand) * ctx->m_ClipCommandCapacity);
-	}
+	bx::AllocatorI* allocator = ctx->m_Allocator;
 
-	DrawCommand* cmd = &ctx->m_ClipCommands[ctx->m_NumClipCommands];
-	ctx->m_NumClipCommands++;
+	ctx->m_NumIndexBuffers++;
+	ctx->m_IndexBuffers = (IndexBuffer*)bx::realloc(allocator, ctx->m_IndexBuffers, sizeof(IndexBuffer) * ctx->m_NumIndexBuffers);
+	ctx->m_GPUIndexBuffers = (GPUIndexBuffer*)bx::realloc(allocator, ctx->m_GPUIndexBuffers, sizeof(GPUIndexBuffer) * ctx->m_NumIndexBuffers);
 
-	cmd->m_VertexBufferID = vertexBufferID;
-	cmd->m_FirstVertexID = firstVertexID;
-	cmd->m_FirstIndexID = firstIndexID;
-	cmd->m_NumVertices = 0;
-	cmd->m_NumIndices = 0;
-	cmd->m_Type = DrawCommand::Type::Clip;
-	cmd->m_HandleID = UINT16_MAX;
-	cmd->m_ScissorRect[0] = (uint16_t)scissor[0];
-	cmd->m_ScissorRect[1] = (uint16_t)scissor[1];
-	cmd->m_ScissorRect[2] = (uint16_t)scissor[2];
-	cmd->m_ScissorRect[3] = (uint16_t)scissor[3];
-	cmd->m_ClipState.m_FirstCmdID = ~0u;
-	cmd->m_ClipState.m_NumCmds = 0;
+	const uint16_t ibID = (uint16_t)(ctx->m_NumIndexBuffers - 1);
 
-	ctx->m_ForceNewClipCommand = false;
+	IndexBuffer* ib = &ctx->m_IndexBuffers[ibID];
+	ib->m_Capacity = 0;
+	ib->m_Count = 0;
+	ib->m_Indices = nullptr;
+	ib->m_Node = (IndexBufferNode*)bx::alloc(allocator, sizeof(IndexBufferNode));
+	ib->m_Node->m_Next = 0;
+	ib->m_Node->m_Context = ctx;
+	ib->m_Node->m_ID = ibID;
 
-	return cmd;
+	GPUIndexBuffer* gpuib = &ctx->m_GPUIndexBuffers[ibID];
+	gpuib->m_bgfxHandle = BGFX_INVALID_HANDLE;
+
+	return ibID;
 }
 
-static void resetImage(Image* img)
+// Can be called from any thread.
+static void releaseIndexBuffer(Context* ctx, IndexBufferNode* node)
 {
-	img->m_bgfxHandle = BGFX_INVALID_HANDLE;
-	img->m_Width = 0;
-	img->m_Height = 0;
-	img->m_Flags = 0;
-	img->m_Owned = false;
+	VG_CHECK(node != nullptr, "Tried to release a null index buffer");
+	bx::atomicFetchAndAdd<int32_t>(&ctx->m_NumIndexBuffersUsed, -1);
+	releasedListPush(&ctx->m_ReleasedIndexBuffers, node);
 }
 
-static ImageHandle allocImage(Context* ctx)
+static void releasedListPush(ReleasedList* list, void* node)
 {
-	ImageHandle handle = { ctx->m_ImageHandleAlloc->alloc() };
-	if (!isValid(handle)) {
-		return VG_INVALID_HANDLE;
+	uint64_t* next = (uint64_t*)node;
+	const uint64_t nodeAddr = (uint64_t)(uintptr_t)node;
+	for (;;) {
+		const uint64_t head = list->m_Head;
+		*next = head;
+		if (bx::atomicCompareAndSwap<uint64_t>(&list->m_Head, head, nodeAddr) == head) {
+			break;
+		}
 	}
+}
 
-	if (handle.idx >= ctx->m_ImageCapacity) {
-		const uint32_t oldCapacity = ctx->m_ImageCapacity;
-
-		ctx->m_ImageCapacity = bx::uint32_min(bx::uint32_max(ctx->m_ImageCapacity + 4, handle.idx + 1),
-																				  ctx->m_Config.m_MaxImages);
-		ctx->m_Images = (Image*)bx::realloc(ctx->m_Allocator, ctx->m_Images, sizeof(Image) * ctx->m_ImageCapacity);
-		if (!ctx->m_Images) {
-			return VG_INVALID_HANDLE;
+static void* releasedListPopAll(ReleasedList* list)
+{
+	for (;;) {
+		const uint64_t head = list->m_Head;
+		if (head == 0) {
+			return nullptr;
 		}
 
-		// Reset all new textures...
-		const uint32_t capacity = ctx->m_ImageCapacity;
-		for (uint32_t i = oldCapacity; i < capacity; ++i) {
-			resetImage(&ctx->m_Images[i]);
+		if (bx::atomicCompareAndSwap<uint64_t>(&list->m_Head, head, 0) == head) {
+			return (void*)(uintptr_t)head;
 		}
 	}
+}
 
-	VG_CHECK(handle.idx < ctx->m_ImageCapacity, "Allocated invalid image handle");
-	Image* tex = &ctx->m_Images[handle.idx];
-	VG_CHECK(!bgfx::isValid(tex->m_bgfxHandle), "Allocated texture is already in use");
-	resetImage(tex);
+static ArenaChunk* arenaAllocChunk(bx::AllocatorI* allocator, Arena* arena, uint32_t size)
+{
+	size = alignSize(bx::max<uint32_t>(size, VG_CONFIG_ARENA_CHUNK_SIZE), VG_CONFIG_ARENA_CHUNK_SIZE);
 
-	return handle;
+	ArenaChunk* chunk = (ArenaChunk*)bx::alignedAlloc(allocator, kAlignedArenaChunkHeaderSize + size, 16);
+	chunk->m_Next = arena->m_Chunk;
+	chunk->m_Size = size;
+	chunk->m_Pos = 0;
+
+	arena->m_Chunk = chunk;
+	arena->m_Size += size;
+
+	return chunk;
 }
 
-static bool allocTextAtlas(Context* ctx)
+static void arenaDestroy(bx::AllocatorI* allocator, Arena* arena)
 {
-	flushTextAtlas(ctx);
+	ArenaChunk* chunk = arena->m_Chunk;
+	while (chunk) {
+		ArenaChunk* next = chunk->m_Next;
+		bx::alignedFree(allocator, chunk, 16);
+		chunk = next;
+	}
 
-	if (ctx->m_FontImageID + 1 >= VG_CONFIG_MAX_FONT_IMAGES) {
-		VG_WARN(false, "No more text atlases for this frame");
-		return false;
+	bx::memSet(arena, 0, sizeof(Arena));
+}
+
+// Allocations made since the last reset are invalidated. If they didn't fit in a single chunk, all chunks
+// are replaced by one which can hold all of them, so a steady workload stops touching the allocator.
+static void arenaReset(bx::AllocatorI* allocator, Arena* arena)
+{
+	ArenaChunk* chunk = arena->m_Chunk;
+	if (chunk && chunk->m_Next) {
+		const uint32_t used = arena->m_Used;
+		arenaDestroy(allocator, arena);
+		arenaAllocChunk(allocator, arena, used);
+	} else if (chunk) {
+		chunk->m_Pos = 0;
 	}
 
-	// if next fontImage already have a texture
-	uint16_t iw, ih;
-	if (isValid(ctx->m_FontImages[ctx->m_FontImageID + 1])) {
-		getImageSize(ctx, ctx->m_FontImages[ctx->m_FontImageID + 1], &iw, &ih);
-	} else {
-		// calculate the new font image size and create it.
-		bool imgSizeValid = getImageSize(ctx, ctx->m_FontImages[ctx->m_FontImageID], &iw, &ih);
-		VG_CHECK(imgSizeValid, "Invalid font atlas dimensions");
-		BX_UNUSED(imgSizeValid);
+	arena->m_Used = 0;
+	arena->m_LastAlloc = nullptr;
+}
 
-		if (iw > ih) {
-			ih *= 2;
-		} else {
-			iw *= 2;
-		}
+// Returns 16-byte aligned memory which is valid until the next arenaReset().
+static void* arenaAlloc(bx::AllocatorI* allocator, Arena* arena, uint32_t size)
+{
+	if (size == 0) {
+		return nullptr;
+	}
 
-		const uint32_t maxTextureSize = bgfx::getCaps()->limits.maxTextureSize;
-		if (iw > maxTextureSize || ih > maxTextureSize) {
-			iw = ih = (uint16_t)maxTextureSize;
-		}
+	size = alignSize(size, 16);
 
-		ctx->m_FontImages[ctx->m_FontImageID + 1] = createImage(ctx, iw, ih, ctx->m_Config.m_FontAtlasImageFlags, nullptr);
+	ArenaChunk* chunk = arena->m_Chunk;
+	if (!chunk || chunk->m_Pos + size > chunk->m_Size) {
+		// Double the arena's size so the number of chunks stays small until the next reset merges them.
+		chunk = arenaAllocChunk(allocator, arena, bx::max<uint32_t>(size, arena->m_Size));
 	}
 
-	++ctx->m_FontImageID;
-	updateWhitePixelUV(ctx);
-
-	fonsResetAtlas(ctx->m_FontStashContext, iw, ih);
+	uint8_t* ptr = (uint8_t*)chunk + kAlignedArenaChunkHeaderSize + chunk->m_Pos;
+	chunk->m_Pos += size;
+	arena->m_Used += size;
+	arena->m_LastAlloc = ptr;
 
-	return true;
+	return ptr;
 }
 
-static void renderTextQuads(Context* ctx, uint32_t numQuads, Color color)
+// Grows the last allocation in place if possible. Otherwise the contents are copied to a new allocation
+// and the old one is wasted until the next reset.
+static void* arenaRealloc(bx::AllocatorI* allocator, Arena* arena, void* ptr, uint32_t oldSize, uint32_t newSize)
 {
-	const State* state = getState(ctx);
-	const float scale = state->m_FontScale * ctx->m_DevicePixelRatio;
-	const float invscale = 1.0f / scale;
+	oldSize = alignSize(oldSize, 16);
+	newSize = alignSize(newSize, 16);
+	if (newSize <= oldSize) {
+		return ptr;
+	}
 
-	const uint32_t c = colorSetAlpha(color, (uint8_t)(state->m_GlobalAlpha * colorGetAlpha(color)));
-	if (colorGetAlpha(c) == 0) {
-		return;
+	ArenaChunk* chunk = arena->m_Chunk;
+	if (ptr != nullptr && ptr == arena->m_LastAlloc && chunk->m_Pos + (newSize - oldSize) <= chunk->m_Size) {
+		chunk->m_Pos += newSize - oldSize;
+		arena->m_Used += newSize - oldSize;
+		return ptr;
 	}
 
-	float mtx[6];
-	mtx[0] = state->m_TransformMtx[0] * invscale;
-	mtx[1] = state->m_TransformMtx[1] * invscale;
-	mtx[2] = state->m_TransformMtx[2] * invscale;
-	mtx[3] = state->m_TransformMtx[3] * invscale;
-	mtx[4] = state->m_TransformMtx[4];
-	mtx[5] = state->m_TransformMtx[5];
+	void* newPtr = arenaAlloc(allocator, arena, newSize);
+	if (ptr != nullptr) {
+		bx::memCopy(newPtr, ptr, oldSize);
+	}
 
-	// TODO: Calculate bounding rect of the quads.
-	vgutil::batchTransformTextQuads(&ctx->m_TextQuads->x0, numQuads, mtx, ctx->m_TextVertices);
+	return newPtr;
+}
 
-	const uint32_t numDrawVertices = numQuads * 4;
-	const uint32_t numDrawIndices = numQuads * 6;
+static void dataPoolInit(DataPool* pool, uint32_t bufferSize)
+{
+	VG_CHECK(bufferSize >= sizeof(uint64_t), "Pooled buffers must be able to hold a ReleasedList link");
+	bx::memSet(pool, 0, sizeof(DataPool));
+	pool->m_BufferSize = bufferSize;
+}
 
-	DrawCommand* cmd = allocDrawCommand(ctx, numDrawVertices, numDrawIndices, DrawCommand::Type::Textured, ctx->m_FontImages[ctx->m_FontImageID].idx);
+static void dataPoolDestroy(Context* ctx, DataPool* pool)
+{
+	VG_WARN(pool->m_NumUsed == 0, "Destroying data pool with buffers still in use");
 
-	VertexBuffer* vb = &ctx->m_VertexBuffers[cmd->m_VertexBufferID];
-	const uint32_t vbOffset = cmd->m_FirstVertexID + cmd->m_NumVertices;
+	bx::AllocatorI* allocator = ctx->m_Allocator;
+	for (uint32_t i = 0; i < pool->m_NumBuffers; ++i) {
+		bx::alignedFree(allocator, pool->m_Buffers[i], 16);
+	}
+	bx::free(allocator, pool->m_Buffers);
+	ctx->m_PooledVertexMemory -= pool->m_NumBuffers * pool->m_BufferSize;
 
-	float* dstPos = &vb->m_Pos[vbOffset << 1];
-	bx::memCopy(dstPos, ctx->m_TextVertices, sizeof(float) * 2 * numDrawVertices);
+	const uint32_t bufferSize = pool->m_BufferSize;
+	bx::memSet(pool, 0, sizeof(DataPool));
+	pool->m_BufferSize = bufferSize;
+}
 
-	uint32_t* dstColor = &vb->m_Color[vbOffset];
-	vgutil::memset32(dstColor, numDrawVertices, &c);
+// O(1) unless the pool has to allocate a new buffer. Must be called on the Context's thread.
+static void* dataPoolAlloc(Context* ctx, DataPool* pool)
+{
+	void* data = pool->m_FreeList;
+	if (!data) {
+		data = releasedListPopAll(&pool->m_Released);
+	}
 
-#if VG_CONFIG_UV_INT16
-	int16_t* dstUV = &vb->m_UV[vbOffset << 1];
-	const FONSquad* q = ctx->m_TextQuads;
-	uint32_t nq = numQuads;
-	while (nq-- > 0) {
-		const float s0 = q->s0;
-		const float s1 = q->s1;
-		const float t0 = q->t0;
-		const float t1 = q->t1;
+	const uint32_t numUsed = (uint32_t)bx::atomicAddAndFetch<int32_t>(&pool->m_NumUsed, 1);
+	pool->m_HighWater = bx::max<uint32_t>(pool->m_HighWater, numUsed);
 
-		dstUV[0] = (int16_t)(s0 * INT16_MAX); dstUV[1] = (int16_t)(t0 * INT16_MAX);
-		dstUV[2] = (int16_t)(s1 * INT16_MAX); dstUV[3] = (int16_t)(t0 * INT16_MAX);
-		dstUV[4] = (int16_t)(s1 * INT16_MAX); dstUV[5] = (int16_t)(t1 * INT16_MAX);
-		dstUV[6] = (int16_t)(s0 * INT16_MAX); dstUV[7] = (int16_t)(t1 * INT16_MAX);
+	if (data) {
+		pool->m_FreeList = (void*)(uintptr_t)(*(uint64_t*)data);
+		return data;
+	}
 
-		dstUV += 8;
-		++q;
+	bx::AllocatorI* allocator = ctx->m_Allocator;
+	if (pool->m_NumBuffers == pool->m_Capacity) {
+		pool->m_Capacity += 8;
+		pool->m_Buffers = (void**)bx::realloc(allocator, pool->m_Buffers, sizeof(void*) * pool->m_Capacity);
 	}
-#else
-	float* dstUV = &vb->m_UV[vbOffset << 1];
-	const FONSquad* q = ctx->m_TextQuads;
-	uint32_t nq = numQuads;
-	while (nq-- > 0) {
-		const float s0 = q->s0;
-		const float s1 = q->s1;
-		const float t0 = q->t0;
-		const float t1 = q->t1;
 
-		dstUV[0] = s0; dstUV[1] = t0;
-		dstUV[2] = s1; dstUV[3] = t0;
-		dstUV[4] = s1; dstUV[5] = t1;
-		dstUV[6] = s0; dstUV[7] = t1;
+	data = bx::alignedAlloc(allocator, pool->m_BufferSize, 16);
+	pool->m_Buffers[pool->m_NumBuffers++] = data;
 
-		dstUV += 8;
-		++q;
+	ctx->m_PooledVertexMemory += pool->m_BufferSize;
+	ctx->m_PeakPooledVertexMemory = bx::max<uint32_t>(ctx->m_PeakPooledVertexMemory, ctx->m_PooledVertexMemory);
+
+	return data;
+}
+
+// Can be called from any thread.
+static void dataPoolRelease(DataPool* pool, void* data)
+{
+	VG_CHECK(data != nullptr, "Tried to release a null vertex buffer");
+	bx::atomicFetchAndAdd<int32_t>(&pool->m_NumUsed, -1);
+	releasedListPush(&pool->m_Released, data);
+}
+
+// Frees up to maxBuffers buffers which aren't currently in use. Must be called on the Context's thread.
+static void dataPoolTrim(Context* ctx, DataPool* pool, uint32_t maxBuffers)
+{
+	bx::AllocatorI* allocator = ctx->m_Allocator;
+
+	void* released = releasedListPopAll(&pool->m_Released);
+	while (released) {
+		void* next = (void*)(uintptr_t)(*(uint64_t*)released);
+		*(uint64_t*)released = (uint64_t)(uintptr_t)pool->m_FreeList;
+		pool->m_FreeList = released;
+		released = next;
 	}
-#endif
 
-	IndexBuffer* ib = &ctx->m_IndexBuffers[ctx->m_ActiveIndexBufferID];
-	uint16_t* dstIndex = &ib->m_Indices[cmd->m_FirstIndexID + cmd->m_NumIndices];
-	vgutil::genQuadIndices_unaligned(dstIndex, numQuads, (uint16_t)cmd->m_NumVertices);
+	while (pool->m_FreeList && maxBuffers != 0) {
+		void* data = pool->m_FreeList;
+		pool->m_FreeList = (void*)(uintptr_t)(*(uint64_t*)data);
 
-	cmd->m_NumVertices += numDrawVertices;
-	cmd->m_NumIndices += numDrawIndices;
+		for (uint32_t i = 0; i < pool->m_NumBuffers; ++i) {
+			if (pool->m_Buffers[i] == data) {
+				pool->m_Buffers[i] = pool->m_Buffers[--pool->m_NumBuffers];
+				break;
+			}
+		}
+
+		bx::alignedFree(allocator, data, 16);
+		ctx->m_PooledVertexMemory -= pool->m_BufferSize;
+		--maxBuffers;
+	}
 }
 
-static void flushTextAtlas(Context* ctx)
+// Called once per frame. Frees the buffers which haven't been needed during the last maxIdleFrames frames,
+// keeping as many buffers as the busiest frame of that window used.
+static void dataPoolDecay(Context* ctx, DataPool* pool, uint32_t maxIdleFrames)
 {
-	FONScontext* fons = ctx->m_FontStashContext;
+	const uint32_t frameHighWater = pool->m_HighWater;
+	pool->m_HighWater = (uint32_t)pool->m_NumUsed;
 
-	int dirty[4];
-	if (!fonsValidateTexture(fons, dirty)) {
+	if (maxIdleFrames == 0 || frameHighWater >= pool->m_NumBuffers) {
+		pool->m_IdleFrames = 0;
+		pool->m_WindowHighWater = 0;
 		return;
 	}
 
-	// Update texture
-	ImageHandle fontImage = ctx->m_FontImages[ctx->m_FontImageID];
-	if (!isValid(fontImage)) {
+	pool->m_WindowHighWater = bx::max<uint32_t>(pool->m_WindowHighWater, frameHighWater);
+	if (++pool->m_IdleFrames < maxIdleFrames) {
 		return;
 	}
 
-	int iw, ih;
-	const uint8_t* a8Data = fonsGetTextureData(fons, &iw, &ih);
-	VG_CHECK(iw > 0 && ih > 0, "Invalid font atlas dimensions");
+	dataPoolTrim(ctx, pool, pool->m_NumBuffers - pool->m_WindowHighWater);
 
-	// TODO: Convert only the dirty part of the texture (it's the only part that will be uploaded to the backend)
-	uint32_t* rgbaData = (uint32_t*)bx::alloc(ctx->m_Allocator, sizeof(uint32_t) * iw * ih);
-	vgutil::convertA8_to_RGBA8(rgbaData, a8Data, (uint32_t)iw, (uint32_t)ih, 0x00FFFFFF);
+	pool->m_IdleFrames = 0;
+	pool->m_WindowHighWater = 0;
+}
 
-	int x = dirty[0];
-	int y = dirty[1];
-	int w = dirty[2] - dirty[0];
-	int h = dirty[3] - dirty[1];
-	updateImage(ctx, fontImage, (uint16_t)x, (uint16_t)y, (uint16_t)w, (uint16_t)h, (const uint8_t*)rgbaData);
+// Returns the smallest vertex buffer size class which can hold numVertices vertices.
+static uint32_t getVertexBufferSizeClass(Context* ctx, uint32_t numVertices)
+{
+	uint32_t sizeClass = 0;
+	while (sizeClass + 1 < ctx->m_NumVertexBufferSizeClasses && getVertexBufferSizeClassCapacity(ctx, sizeClass) < numVertices) {
+		++sizeClass;
+	}
 
-	bx::free(ctx->m_Allocator, rgbaData);
+	return sizeClass;
 }
 
-static CommandListHandle allocCommandList(Context* ctx)
+static uint32_t getVertexBufferSizeClassCapacity(Context* ctx, uint32_t sizeClass)
 {
-	CommandListHandle handle = { ctx->m_CmdListHandleAlloc->alloc() };
-	if (!isValid(handle)) {
-		return VG_INVALID_HANDLE;
+	return bx::min<uint32_t>(VG_CONFIG_MIN_VB_VERTICES << sizeClass, ctx->m_Config.m_MaxVBVertices);
+}
+
+// Prefers transient buffers (when enabled) and falls back to the pools if the transient memory has run out.
+static void allocVertexBufferStreams(Context* ctx, VertexBuffer* vb, uint32_t sizeClass)
+{
+	vb->m_SizeClass = (uint8_t)sizeClass;
+	vb->m_Capacity = getVertexBufferSizeClassCapacity(ctx, sizeClass);
+
+#if VG_CONFIG_TRANSIENT_BUFFERS
+	// NOTE: All 3 streams are allocated from the same transient pool and the position stream has the
+	// largest stride, so 3x the position stream's size is enough for all of them.
+	const uint32_t capacity = vb->m_Capacity;
+	vb->m_IsTransient = bgfx::getAvailTransientVertexBuffer(capacity * 3, ctx->m_PosVertexDecl) >= capacity * 3;
+	if (vb->m_IsTransient) {
+		bgfx::allocTransientVertexBuffer(&vb->m_TransientPos, capacity, ctx->m_PosVertexDecl);
+		bgfx::allocTransientVertexBuffer(&vb->m_TransientUV, capacity, ctx->m_UVVertexDecl);
+		bgfx::allocTransientVertexBuffer(&vb->m_TransientColor, capacity, ctx->m_ColorVertexDecl);
+		vb->m_Pos = (float*)vb->m_TransientPos.data;
+		vb->m_UV = (uv_t*)vb->m_TransientUV.data;
+		vb->m_Color = (uint32_t*)vb->m_TransientColor.data;
+		return;
 	}
+#endif
 
-	VG_CHECK(handle.idx < ctx->m_Config.m_MaxCommandLists, "Allocated invalid command list handle");
-	CommandList* cl = &ctx->m_CmdLists[handle.idx];
-	bx::memSet(cl, 0, sizeof(CommandList));
+	vb->m_Pos = (float*)dataPoolAlloc(ctx, &ctx->m_Vec2DataPools[sizeClass]);
+#if VG_CONFIG_UV_INT16
+	vb->m_UV = (int16_t*)dataPoolAlloc(ctx, &ctx->m_UVDataPools[sizeClass]);
+#else
+	vb->m_UV = (float*)dataPoolAlloc(ctx, &ctx->m_Vec2DataPools[sizeClass]);
+#endif
+	vb->m_Color = (uint32_t*)dataPoolAlloc(ctx, &ctx->m_Uint32DataPools[sizeClass]);
+}
 
-	return handle;
+static void releaseVertexBufferStreams(Context* ctx, VertexBuffer* vb)
+{
+#if VG_CONFIG_TRANSIENT_BUFFERS
+	if (vb->m_IsTransient) {
+		// Transient memory is reclaimed by bgfx at the end of the frame.
+		return;
+	}
+#endif
+
+	const uint32_t sizeClass = vb->m_SizeClass;
+	dataPoolRelease(&ctx->m_Vec2DataPools[sizeClass], vb->m_Pos);
+#if VG_CONFIG_UV_INT16
+	dataPoolRelease(&ctx->m_UVDataPools[sizeClass], vb->m_UV);
+#else
+	dataPoolRelease(&ctx->m_Vec2DataPools[sizeClass], vb->m_UV);
+#endif
+	dataPoolRelease(&ctx->m_Uint32DataPools[sizeClass], vb->m_Color);
 }
 
-static inline bool isCommandListHandleValid(Context* ctx, CommandListHandle handle)
+// Moves the vertices of vb to streams from the smallest size class which can hold numVertices vertices.
+static void growVertexBuffer(Context* ctx, VertexBuffer* vb, uint32_t numVertices)
 {
-	return isValid(handle) && ctx->m_CmdListHandleAlloc->isValid(handle.idx);
+	VertexBuffer oldVB;
+	bx::memCopy(&oldVB, vb, sizeof(VertexBuffer));
+
+	allocVertexBufferStreams(ctx, vb, getVertexBufferSizeClass(ctx, numVertices));
+
+	const uint32_t count = vb->m_Count;
+	bx::memCopy(vb->m_Pos, oldVB.m_Pos, sizeof(float) * 2 * count);
+	bx::memCopy(vb->m_UV, oldVB.m_UV, sizeof(uv_t) * 2 * count);
+	bx::memCopy(vb->m_Color, oldVB.m_Color, sizeof(uint32_t) * count);
+
+	releaseVertexBufferStreams(ctx, &oldVB);
 }
 
-#if VG_CONFIG_ENABLE_SHAPE_CACHING
-static CommandListCache* allocCommandListCache(Context* ctx)
+static void createDrawCommand_VertexColor(Context* ctx, const float* vtx, uint32_t numVertices, const uint32_t* colors, uint32_t numColors, const uint16_t* indices, uint32_t numIndices)
 {
-	bx::AllocatorI* allocator = ctx->m_Allocator;
+#if VG_CONFIG_SOFTWARE_SCISSOR
+	const uv_t* noUV = nullptr;
+	if (!clipMeshToScissorRect(ctx, &vtx, &noUV, &numVertices, &colors, &numColors, &indices, &numIndices)) {
+		return;
+	}
+#endif
 
-	CommandListCache* cache = (CommandListCache*)bx::alloc(allocator, sizeof(CommandListCache));
-	bx::memSet(cache, 0, sizeof(CommandListCache));
+	// Allocate the draw command
+	const ImageHandle fontImg = ctx->m_FontImages[0];
+	DrawCommand* cmd = allocDrawCommand(ctx, numVertices, numIndices, DrawCommand::Type::Textured, fontImg.idx);
 
-	return cache;
+	// Vertex buffer
+	VertexBuffer* vb = &ctx->m_VertexBuffers[cmd->m_VertexBufferID];
+	const uint32_t vbOffset = cmd->m_FirstVertexID + cmd->m_NumVertices;
+
+	float* dstPos = &vb->m_Pos[vbOffset << 1];
+	bx::memCopy(dstPos, vtx, sizeof(float) * 2 * numVertices);
+
+	const uv_t* uv = getWhitePixelUV(ctx);
+
+	uv_t* dstUV = &vb->m_UV[vbOffset << 1];
+#if VG_CONFIG_UV_INT16
+	vgutil::memset32(dstUV, numVertices, &uv[0]);
+#else
+	vgutil::memset64(dstUV, numVertices, &uv[0]);
+#endif
+
+	uint32_t* dstColor = &vb->m_Color[vbOffset];
+	if (numColors == numVertices) {
+		bx::memCopy(dstColor, colors, sizeof(uint32_t) * numVertices);
+	} else {
+		VG_CHECK(numColors == 1, "Invalid size of color array passed.");
+		vgutil::memset32(dstColor, numVertices, colors);
+	}
+
+	// Index buffer
+	IndexBuffer* ib = &ctx->m_IndexBuffers[ctx->m_ActiveIndexBufferID];
+	index_t* dstIndex = &ib->m_Indices[cmd->m_FirstIndexID + cmd->m_NumIndices];
+	vgutil::batchTransformDrawIndices(indices, numIndices, dstIndex, (index_t)cmd->m_NumVertices);
+
+	cmd->m_NumVertices += numVertices;
+	cmd->m_NumIndices += numIndices;
+}
+
+static void createDrawCommand_ImagePattern(Context* ctx, ImagePatternHandle imgPatternHandle, const float* vtx, uint32_t numVertices, const uint32_t* colors, uint32_t numColors, const uint16_t* indices, uint32_t numIndices)
+{
+#if VG_CONFIG_SOFTWARE_SCISSOR
+	const uv_t* noUV = nullptr;
+	if (!clipMeshToScissorRect(ctx, &vtx, &noUV, &numVertices, &colors, &numColors, &indices, &numIndices)) {
+		return;
+	}
+#endif
+
+#if VG_CONFIG_BATCH_IMAGE_PATTERNS
+	if (createDrawCommand_ImagePatternUV(ctx, imgPatternHandle, vtx, numVertices, colors, numColors, indices, numIndices)) {
+		return;
+	}
+#endif
+
+	DrawCommand* cmd = allocDrawCommand(ctx, numVertices, numIndices, DrawCommand::Type::ImagePattern, imgPatternHandle.idx);
+
+	VertexBuffer* vb = &ctx->m_VertexBuffers[cmd->m_VertexBufferID];
+	const uint32_t vbOffset = cmd->m_FirstVertexID + cmd->m_NumVertices;
+
+	float* dstPos = &vb->m_Pos[vbOffset << 1];
+	bx::memCopy(dstPos, vtx, sizeof(float) * 2 * numVertices);
+
+	uint32_t* dstColor = &vb->m_Color[vbOffset];
+	if (numColors == numVertices) {
+		bx::memCopy(dstColor, colors, sizeof(uint32_t) * numVertices);
+	} else {
+		VG_CHECK(numColors == 1, "Invalid size of color array passed.");
+		vgutil::memset32(dstColor, numVertices, colors);
+	}
+
+	IndexBuffer* ib = &ctx->m_IndexBuffers[ctx->m_ActiveIndexBufferID];
+	index_t* dstIndex = &ib->m_Indices[cmd->m_FirstIndexID + cmd->m_NumIndices];
+	vgutil::batchTransformDrawIndices(indices, numIndices, dstIndex, (index_t)cmd->m_NumVertices);
+
+	cmd->m_NumVertices += numVertices;
+	cmd->m_NumIndices += numIndices;
 }
 
-static void freeCommandListCache(Context* ctx, CommandListCache* cache)
-{
-	bx::AllocatorI* allocator = ctx->m_Allocator;
+static void createDrawCommand_ColorGradient(Context* ctx, GradientHandle gradientHandle, const float* vtx, uint32_t numVertices, const uint32_t* colors, uint32_t numColors, const uint16_t* indices, uint32_t numIndices)
+{
+#if VG_CONFIG_SOFTWARE_SCISSOR
+	const uv_t* noUV = nullptr;
+	if (!clipMeshToScissorRect(ctx, &vtx, &noUV, &numVertices, &colors, &numColors, &indices, &numIndices)) {
+		return;
+	}
+#endif
+
+#if VG_CONFIG_BATCH_LINEAR_GRADIENTS
+	if (ctx->m_Gradients[gradientHandle.idx].m_IsLinear && createDrawCommand_GradientRamp(ctx, gradientHandle, vtx, numVertices, colors, numColors, indices, numIndices)) {
+		return;
+	}
+#endif
+
+	DrawCommand* cmd = allocDrawCommand(ctx, numVertices, numIndices, DrawCommand::Type::ColorGradient, gradientHandle.idx);
+
+	VertexBuffer* vb = &ctx->m_VertexBuffers[cmd->m_VertexBufferID];
+	const uint32_t vbOffset = cmd->m_FirstVertexID + cmd->m_NumVertices;
+
+	float* dstPos = &vb->m_Pos[vbOffset << 1];
+	bx::memCopy(dstPos, vtx, sizeof(float) * 2 * numVertices);
+
+	uint32_t* dstColor = &vb->m_Color[vbOffset];
+	if (numColors == numVertices) {
+		bx::memCopy(dstColor, colors, sizeof(uint32_t) * numVertices);
+	} else {
+		VG_CHECK(numColors == 1, "Invalid size of color array passed.");
+		vgutil::memset32(dstColor, numVertices, colors);
+	}
+
+	IndexBuffer* ib = &ctx->m_IndexBuffers[ctx->m_ActiveIndexBufferID];
+	index_t* dstIndex = &ib->m_Indices[cmd->m_FirstIndexID + cmd->m_NumIndices];
+	vgutil::batchTransformDrawIndices(indices, numIndices, dstIndex, (index_t)cmd->m_NumVertices);
+
+	cmd->m_NumVertices += numVertices;
+	cmd->m_NumIndices += numIndices;
+}
+
+#if VG_CONFIG_BATCH_IMAGE_PATTERNS
+// Renders an image pattern fill/stroke as a Textured draw command of the pattern's image by applying the
+// paint matrix (u_paintMat in vs_image_pattern.sc) to the vertices on the CPU.
+// With VG_CONFIG_UV_INT16, the texture coordinates of each mesh are shifted by whole image periods along
+// the axes the image repeats on (i.e. without Clamp_U/Clamp_V), so meshes spanning up to one period fit
+// in [-1, 1]. Returns false if the texture coordinates still cannot be represented by uv_t (the caller
+// should fall back to the image pattern program).
+static bool createDrawCommand_ImagePatternUV(Context* ctx, ImagePatternHandle imgPatternHandle, const float* vtx, uint32_t numVertices, const uint32_t* colors, uint32_t numColors, const uint16_t* indices, uint32_t numIndices)
+{
+	const ImagePattern* pattern = &ctx->m_ImagePatterns[imgPatternHandle.idx];
+	const float* m = pattern->m_Matrix;
+
+#if VG_CONFIG_UV_INT16
+	float uvBounds[4] = { bx::kFloatMax, bx::kFloatMax, -bx::kFloatMax, -bx::kFloatMax };
+	for (uint32_t i = 0; i < numVertices; ++i) {
+		const float x = vtx[i * 2 + 0];
+		const float y = vtx[i * 2 + 1];
+		const float u = m[0] * x + m[3] * y + m[6];
+		const float v = m[1] * x + m[4] * y + m[7];
+		uvBounds[0] = bx::min<float>(uvBounds[0], u);
+		uvBounds[1] = bx::min<float>(uvBounds[1], v);
+		uvBounds[2] = bx::max<float>(uvBounds[2], u);
+		uvBounds[3] = bx::max<float>(uvBounds[3], v);
+	}
+
+	const uint32_t imgFlags = ctx->m_Images[pattern->m_ImageHandle.idx].m_Flags;
+	const bool repeatUV[2] = { (imgFlags & BGFX_SAMPLER_U_CLAMP) == 0, (imgFlags & BGFX_SAMPLER_V_CLAMP) == 0 };
+	float uvOffset[2] = { 0.0f, 0.0f };
+	for (uint32_t i = 0; i < 2; ++i) {
+		if (uvBounds[i] >= -1.0f && uvBounds[i + 2] <= 1.0f) {
+			continue;
+		}
+
+		if (!repeatUV[i]) {
+			return false;
+		}
+
+		// Move the minimum into [-1, 0)
+		uvOffset[i] = -bx::floor(uvBounds[i]) - 1.0f;
+		if (uvBounds[i + 2] + uvOffset[i] > 1.0f) {
+			return false;
+		}
+	}
+#endif
+
+	DrawCommand* cmd = allocDrawCommand(ctx, numVertices, numIndices, DrawCommand::Type::Textured, pattern->m_ImageHandle.idx);
+
+	VertexBuffer* vb = &ctx->m_VertexBuffers[cmd->m_VertexBufferID];
+	const uint32_t vbOffset = cmd->m_FirstVertexID + cmd->m_NumVertices;
+
+	float* dstPos = &vb->m_Pos[vbOffset << 1];
+	bx::memCopy(dstPos, vtx, sizeof(float) * 2 * numVertices);
+
+	uv_t* dstUV = &vb->m_UV[vbOffset << 1];
+	for (uint32_t i = 0; i < numVertices; ++i) {
+		const float x = vtx[i * 2 + 0];
+		const float y = vtx[i * 2 + 1];
+		const float u = m[0] * x + m[3] * y + m[6];
+		const float v = m[1] * x + m[4] * y + m[7];
+#if VG_CONFIG_UV_INT16
+		dstUV[i * 2 + 0] = (int16_t)((u + uvOffset[0]) * INT16_MAX);
+		dstUV[i * 2 + 1] = (int16_t)((v + uvOffset[1]) * INT16_MAX);
+#else
+		dstUV[i * 2 + 0] = u;
+		dstUV[i * 2 + 1] = v;
+#endif
+	}
+
+	uint32_t* dstColor = &vb->m_Color[vbOffset];
+	if (numColors == numVertices) {
+		bx::memCopy(dstColor, colors, sizeof(uint32_t) * numVertices);
+	} else {
+		VG_CHECK(numColors == 1, "Invalid size of color array passed.");
+		vgutil::memset32(dstColor, numVertices, colors);
+	}
+
+	IndexBuffer* ib = &ctx->m_IndexBuffers[ctx->m_ActiveIndexBufferID];
+	index_t* dstIndex = &ib->m_Indices[cmd->m_FirstIndexID + cmd->m_NumIndices];
+	vgutil::batchTransformDrawIndices(indices, numIndices, dstIndex, (index_t)cmd->m_NumVertices);
+
+	cmd->m_NumVertices += numVertices;
+	cmd->m_NumIndices += numIndices;
+
+	return true;
+}
+#endif
+
+#if VG_CONFIG_BATCH_LINEAR_GRADIENTS
+// Same as sdroundrect() in fs_color_gradient.sc. For linear gradients the result is an affine function
+// of the vertex position, so it can be evaluated per vertex and interpolated by the rasterizer.
+static inline float gradientCalcParam(const Gradient* grad, float x, float y)
+{
+	const float* m = grad->m_Matrix;
+	const float* params = grad->m_Params;
+	const float px = m[0] * x + m[3] * y + m[6];
+	const float py = m[1] * x + m[4] * y + m[7];
+
+	const float dx = bx::abs(px) - (params[0] - params[2]);
+	const float dy = bx::abs(py) - (params[1] - params[2]);
+	const float mx = bx::max<float>(dx, 0.0f);
+	const float my = bx::max<float>(dy, 0.0f);
+	const float sd = bx::min<float>(bx::max<float>(dx, dy), 0.0f) + bx::sqrt(mx * mx + my * my) - params[2];
+
+	return (sd + params[3] * 0.5f) / params[3];
+}
+
+// Renders a linear gradient fill/stroke using the gradient's row in the gradient ramp image. The ramp
+// is 2 texels wide (inner and outer color) so the texture coordinate u = 0.25 + 0.5 * t reproduces
+// mix(inner, outer, clamp(t, 0, 1)) via bilinear filtering and clamp addressing.
+// Returns false if the texture coordinates cannot be represented by uv_t (the caller should fall back
+// to the color gradient program).
+static bool createDrawCommand_GradientRamp(Context* ctx, GradientHandle gradientHandle, const float* vtx, uint32_t numVertices, const uint32_t* colors, uint32_t numColors, const uint16_t* indices, uint32_t numIndices)
+{
+	const Gradient* grad = &ctx->m_Gradients[gradientHandle.idx];
+
+#if VG_CONFIG_UV_INT16
+	for (uint32_t i = 0; i < numVertices; ++i) {
+		const float u = 0.25f + 0.5f * gradientCalcParam(grad, vtx[i * 2 + 0], vtx[i * 2 + 1]);
+		if (u < -1.0f || u > 1.0f) {
+			return false;
+		}
+	}
+#endif
+
+	const ImageHandle rampImg = ctx->m_GradientRampImage;
+	DrawCommand* cmd = allocDrawCommand(ctx, numVertices, numIndices, DrawCommand::Type::Textured, rampImg.idx);
+
+	VertexBuffer* vb = &ctx->m_VertexBuffers[cmd->m_VertexBufferID];
+	const uint32_t vbOffset = cmd->m_FirstVertexID + cmd->m_NumVertices;
+
+	float* dstPos = &vb->m_Pos[vbOffset << 1];
+	bx::memCopy(dstPos, vtx, sizeof(float) * 2 * numVertices);
+
+	const float v = ((float)gradientHandle.idx + 0.5f) / (float)ctx->m_Config.m_MaxGradients;
+	uv_t* dstUV = &vb->m_UV[vbOffset << 1];
+	for (uint32_t i = 0; i < numVertices; ++i) {
+		const float u = 0.25f + 0.5f * gradientCalcParam(grad, vtx[i * 2 + 0], vtx[i * 2 + 1]);
+#if VG_CONFIG_UV_INT16
+		dstUV[i * 2 + 0] = (int16_t)(u * INT16_MAX);
+		dstUV[i * 2 + 1] = (int16_t)(v * INT16_MAX);
+#else
+		dstUV[i * 2 + 0] = u;
+		dstUV[i * 2 + 1] = v;
+#endif
+	}
+
+	// The color gradient program uses only the alpha of the vertex colors, while the textured program
+	// modulates the texel with the whole color.
+	uint32_t* dstColor = &vb->m_Color[vbOffset];
+	if (numColors == numVertices) {
+		for (uint32_t i = 0; i < numVertices; ++i) {
+			dstColor[i] = colors[i] | 0x00FFFFFF;
+		}
+	} else {
+		VG_CHECK(numColors == 1, "Invalid size of color array passed.");
+		const uint32_t c = colors[0] | 0x00FFFFFF;
+		vgutil::memset32(dstColor, numVertices, &c);
+	}
+
+	IndexBuffer* ib = &ctx->m_IndexBuffers[ctx->m_ActiveIndexBufferID];
+	index_t* dstIndex = &ib->m_Indices[cmd->m_FirstIndexID + cmd->m_NumIndices];
+	vgutil::batchTransformDrawIndices(indices, numIndices, dstIndex, (index_t)cmd->m_NumVertices);
+
+	cmd->m_NumVertices += numVertices;
+	cmd->m_NumIndices += numIndices;
+
+	return true;
+}
+#endif
+
+
+static void createDrawCommand_Clip(Context* ctx, const float* vtx, uint32_t numVertices, const uint16_t* indices, uint32_t numIndices)
+{
+	// Allocate the draw command
+	DrawCommand* cmd = allocClipCommand(ctx, numVertices, numIndices);
+
+	// Vertex buffer
+	VertexBuffer* vb = &ctx->m_VertexBuffers[cmd->m_VertexBufferID];
+	const uint32_t vbOffset = cmd->m_FirstVertexID + cmd->m_NumVertices;
+
+	float* dstPos = &vb->m_Pos[vbOffset << 1];
+	bx::memCopy(dstPos, vtx, sizeof(float) * 2 * numVertices);
+
+	// Index buffer
+	IndexBuffer* ib = &ctx->m_IndexBuffers[ctx->m_ActiveIndexBufferID];
+	index_t* dstIndex = &ib->m_Indices[cmd->m_FirstIndexID + cmd->m_NumIndices];
+	vgutil::batchTransformDrawIndices(indices, numIndices, dstIndex, (index_t)cmd->m_NumVertices);
+
+	cmd->m_NumVertices += numVertices;
+	cmd->m_NumIndices += numIndices;
+}
+
+#if VG_CONFIG_SOFTWARE_SCISSOR
+struct ScissorClipVertex
+{
+	float m_Pos[2];
+	float m_UV[2];
+	float m_Color[4];
+};
+
+static inline uint32_t scissorOutcode(const float* pos, const float* rect)
+{
+	return 0
+		| (pos[0] < rect[0] ? 1u : 0u)
+		| (pos[1] < rect[1] ? 2u : 0u)
+		| (pos[0] > rect[2] ? 4u : 0u)
+		| (pos[1] > rect[3] ? 8u : 0u)
+		;
+}
+
+// Sutherland-Hodgman step against a single edge of the scissor rect. Every step adds at most one vertex.
+static uint32_t clipPolygonToScissorEdge(const ScissorClipVertex* in, uint32_t numIn, ScissorClipVertex* out, uint32_t edge, float value)
+{
+	const uint32_t axis = edge & 1;
+	const float sign = edge < 2 ? 1.0f : -1.0f;
+
+	uint32_t numOut = 0;
+	for (uint32_t i = 0; i < numIn; ++i) {
+		const ScissorClipVertex* a = &in[i];
+		const ScissorClipVertex* b = &in[i + 1 == numIn ? 0 : i + 1];
+		const float da = (a->m_Pos[axis] - value) * sign;
+		const float db = (b->m_Pos[axis] - value) * sign;
+
+		if (da >= 0.0f) {
+			out[numOut++] = *a;
+		}
+
+		if ((da >= 0.0f) != (db >= 0.0f)) {
+			const float t = da / (da - db);
+			ScissorClipVertex* v = &out[numOut++];
+			const float* fa = &a->m_Pos[0];
+			const float* fb = &b->m_Pos[0];
+			float* fv = &v->m_Pos[0];
+			for (uint32_t j = 0; j < 8; ++j) {
+				fv[j] = fa[j] + (fb[j] - fa[j]) * t;
+			}
+			v->m_Pos[axis] = value;
+		}
+	}
+
+	return numOut;
+}
+
+static void loadScissorClipVertex(ScissorClipVertex* v, const float* pos, const uv_t* uv, const uint32_t* color)
+{
+	v->m_Pos[0] = pos[0];
+	v->m_Pos[1] = pos[1];
+	v->m_UV[0] = uv ? (float)uv[0] : 0.0f;
+	v->m_UV[1] = uv ? (float)uv[1] : 0.0f;
+	const uint32_t c = color ? *color : 0;
+	v->m_Color[0] = (float)((c >> 0) & 0xFF);
+	v->m_Color[1] = (float)((c >> 8) & 0xFF);
+	v->m_Color[2] = (float)((c >> 16) & 0xFF);
+	v->m_Color[3] = (float)((c >> 24) & 0xFF);
+}
+
+static void storeScissorClipVertex(const ScissorClipVertex* v, float* pos, uv_t* uv, uint32_t* color)
+{
+	pos[0] = v->m_Pos[0];
+	pos[1] = v->m_Pos[1];
+	if (uv) {
+#if VG_CONFIG_UV_INT16
+		uv[0] = (int16_t)bx::floor(v->m_UV[0] + 0.5f);
+		uv[1] = (int16_t)bx::floor(v->m_UV[1] + 0.5f);
+#else
+		uv[0] = v->m_UV[0];
+		uv[1] = v->m_UV[1];
+#endif
+	}
+	if (color) {
+		*color = 0
+			| ((uint32_t)(v->m_Color[0] + 0.5f) << 0)
+			| ((uint32_t)(v->m_Color[1] + 0.5f) << 8)
+			| ((uint32_t)(v->m_Color[2] + 0.5f) << 16)
+			| ((uint32_t)(v->m_Color[3] + 0.5f) << 24);
+	}
+}
+
+// Clips the triangles of a screen space mesh against the current scissor rect, so the draw command doesn't
+// depend on it and can be merged with draw commands using different scissor rects. Positions, UVs (optional)
+// and per-vertex colors are interpolated along the clipped edges. Returns false if the mesh is completely
+// outside the scissor rect. Otherwise, the mesh pointers might point to the context's scratch buffers on return.
+// If the clipped mesh would have too many vertices for a single draw call, the mesh isn't modified and the
+// draw command falls back to the hardware scissor.
+static bool clipMeshToScissorRect(Context* ctx, const float** vtx, const uv_t** uv, uint32_t* numVertices, const uint32_t** colors, uint32_t* numColors, const uint16_t** indices, uint32_t* numIndices)
+{
+	ctx->m_ForceHardwareScissor = false;
+
+	const float* scissor = getState(ctx)->m_ScissorRect;
+	const float rect[4] = { scissor[0], scissor[1], scissor[0] + scissor[2], scissor[1] + scissor[3] };
+
+	const float* srcPos = *vtx;
+	const uint32_t numSrcVertices = *numVertices;
+	uint32_t andCode = 0x0F;
+	uint32_t orCode = 0;
+	for (uint32_t i = 0; i < numSrcVertices; ++i) {
+		const uint32_t code = scissorOutcode(&srcPos[i << 1], rect);
+		andCode &= code;
+		orCode |= code;
+	}
+
+	if (andCode != 0) {
+		return false;
+	} else if (orCode == 0) {
+		return true;
+	}
+
+	const uv_t* srcUV = *uv;
+	const uint32_t* srcColors = *numColors == numSrcVertices ? *colors : nullptr;
+	const uint16_t* srcIndices = *indices;
+	const uint32_t numSrcIndices = *numIndices;
+	const uint32_t numTris = numSrcIndices / 3;
+
+	// Worst case: every triangle is clipped to a heptagon (7 new vertices, 5 triangles).
+	const uint32_t maxVertices = numSrcVertices + numTris * 7;
+	const uint32_t maxIndices = numTris * 15;
+	if (maxVertices > ctx->m_ScissorClipVertexCapacity) {
+		bx::AllocatorI* allocator = ctx->m_Allocator;
+		ctx->m_ScissorClipVertexCapacity = maxVertices;
+		ctx->m_ScissorClipPos = (float*)bx::alignedRealloc(allocator, ctx->m_ScissorClipPos, sizeof(float) * 2 * maxVertices, 16);
+		ctx->m_ScissorClipUV = (uv_t*)bx::alignedRealloc(allocator, ctx->m_ScissorClipUV, sizeof(uv_t) * 2 * maxVertices, 16);
+		ctx->m_ScissorClipColors = (uint32_t*)bx::alignedRealloc(allocator, ctx->m_ScissorClipColors, sizeof(uint32_t) * maxVertices, 16);
+	}
+	if (maxIndices > ctx->m_ScissorClipIndexCapacity) {
+		ctx->m_ScissorClipIndexCapacity = maxIndices;
+		ctx->m_ScissorClipIndices = (uint16_t*)bx::alignedRealloc(ctx->m_Allocator, ctx->m_ScissorClipIndices, sizeof(uint16_t) * maxIndices, 16);
+	}
+
+	float* dstPos = ctx->m_ScissorClipPos;
+	uv_t* dstUV = srcUV ? ctx->m_ScissorClipUV : nullptr;
+	uint32_t* dstColors = srcColors ? ctx->m_ScissorClipColors : nullptr;
+	uint16_t* dstIndices = ctx->m_ScissorClipIndices;
+
+	// The original vertices are kept as is, so triangles which are completely inside the rect reuse them.
+	bx::memCopy(dstPos, srcPos, sizeof(float) * 2 * numSrcVertices);
+	if (dstUV) {
+		bx::memCopy(dstUV, srcUV, sizeof(uv_t) * 2 * numSrcVertices);
+	}
+	if (dstColors) {
+		bx::memCopy(dstColors, srcColors, sizeof(uint32_t) * numSrcVertices);
+	}
+
+	const uint32_t vertexLimit = bx::min<uint32_t>(UINT16_MAX, ctx->m_Config.m_MaxVBVertices - 1);
+	uint32_t numDstVertices = numSrcVertices;
+	uint32_t numDstIndices = 0;
+	for (uint32_t iTri = 0; iTri < numTris; ++iTri) {
+		const uint16_t* tri = &srcIndices[iTri * 3];
+		const uint32_t c0 = scissorOutcode(&srcPos[tri[0] << 1], rect);
+		const uint32_t c1 = scissorOutcode(&srcPos[tri[1] << 1], rect);
+		const uint32_t c2 = scissorOutcode(&srcPos[tri[2] << 1], rect);
+
+		if ((c0 | c1 | c2) == 0) {
+			dstIndices[numDstIndices++] = tri[0];
+			dstIndices[numDstIndices++] = tri[1];
+			dstIndices[numDstIndices++] = tri[2];
+			continue;
+		} else if ((c0 & c1 & c2) != 0) {
+			continue;
+		}
+
+		ScissorClipVertex polygon[2][8];
+		for (uint32_t i = 0; i < 3; ++i) {
+			const uint32_t id = tri[i];
+			loadScissorClipVertex(&polygon[0][i], &srcPos[id << 1], srcUV ? &srcUV[id << 1] : nullptr, srcColors ? &srcColors[id] : nullptr);
+		}
+
+		uint32_t numPolygonVertices = 3;
+		uint32_t cur = 0;
+		for (uint32_t edge = 0; edge < 4 && numPolygonVertices != 0; ++edge) {
+			numPolygonVertices = clipPolygonToScissorEdge(polygon[cur], numPolygonVertices, polygon[cur ^ 1], edge, rect[edge]);
+			cur ^= 1;
+		}
+
+		if (numPolygonVertices < 3) {
+			continue;
+		}
+
+		if (numDstVertices + numPolygonVertices > vertexLimit) {
+			ctx->m_ForceHardwareScissor = true;
+			return true;
+		}
+
+		const uint16_t firstVertexID = (uint16_t)numDstVertices;
+		for (uint32_t i = 0; i < numPolygonVertices; ++i) {
+			const uint32_t id = numDstVertices + i;
+			storeScissorClipVertex(&polygon[cur][i], &dstPos[id << 1], dstUV ? &dstUV[id << 1] : nullptr, dstColors ? &dstColors[id] : nullptr);
+		}
+		numDstVertices += numPolygonVertices;
+
+		for (uint32_t i = 2; i < numPolygonVertices; ++i) {
+			dstIndices[numDstIndices++] = firstVertexID;
+			dstIndices[numDstIndices++] = (uint16_t)(firstVertexID + i - 1);
+			dstIndices[numDstIndices++] = (uint16_t)(firstVertexID + i);
+		}
+	}
+
+	if (numDstIndices == 0) {
+		return false;
+	}
+
+	*vtx = dstPos;
+	*uv = dstUV;
+	*numVertices = numDstVertices;
+	if (dstColors) {
+		*colors = dstColors;
+		*numColors = numDstVertices;
+	}
+	*indices = dstIndices;
+	*numIndices = numDstIndices;
+
+	return true;
+}
+
+// Clips the glyph quads against the current scissor rect (see clipMeshToScissorRect()). Glyph quads stay
+// rectangles only if the text transform is axis-aligned, so in any other case the draw command falls back
+// to the hardware scissor. Returns the number of remaining quads, which are compacted at the start of the array.
+static uint32_t clipTextQuadsToScissorRect(Context* ctx, FONSquad* quads, uint32_t numQuads, const float* mtx)
+{
+	ctx->m_ForceHardwareScissor = false;
+
+	if (mtx[1] != 0.0f || mtx[2] != 0.0f || mtx[0] == 0.0f || mtx[3] == 0.0f) {
+		ctx->m_ForceHardwareScissor = true;
+		return numQuads;
+	}
+
+	// Scissor rect in quad space.
+	const float* scissor = getState(ctx)->m_ScissorRect;
+	const float x0 = (scissor[0] - mtx[4]) / mtx[0];
+	const float x1 = (scissor[0] + scissor[2] - mtx[4]) / mtx[0];
+	const float y0 = (scissor[1] - mtx[5]) / mtx[3];
+	const float y1 = (scissor[1] + scissor[3] - mtx[5]) / mtx[3];
+	const float rect[4] = { bx::min<float>(x0, x1), bx::min<float>(y0, y1), bx::max<float>(x0, x1), bx::max<float>(y0, y1) };
+
+	uint32_t numDstQuads = 0;
+	for (uint32_t i = 0; i < numQuads; ++i) {
+		FONSquad q = quads[i];
+		if (q.x1 <= rect[0] || q.x0 >= rect[2] || q.y1 <= rect[1] || q.y0 >= rect[3]) {
+			continue;
+		}
+
+		if (q.x0 < rect[0]) {
+			q.s0 += (q.s1 - q.s0) * (rect[0] - q.x0) / (q.x1 - q.x0);
+			q.x0 = rect[0];
+		}
+		if (q.x1 > rect[2]) {
+			q.s1 -= (q.s1 - q.s0) * (q.x1 - rect[2]) / (q.x1 - q.x0);
+			q.x1 = rect[2];
+		}
+		if (q.y0 < rect[1]) {
+			q.t0 += (q.t1 - q.t0) * (rect[1] - q.y0) / (q.y1 - q.y0);
+			q.y0 = rect[1];
+		}
+		if (q.y1 > rect[3]) {
+			q.t1 -= (q.t1 - q.t0) * (q.y1 - rect[3]) / (q.y1 - q.y0);
+			q.y1 = rect[3];
+		}
+
+		quads[numDstQuads++] = q;
+	}
+
+	return numDstQuads;
+}
+#endif
+
+static inline bool clipStatesEqual(const ClipState* a, const ClipState* b)
+{
+	return a->m_FirstCmdID == b->m_FirstCmdID && a->m_NumCmds == b->m_NumCmds && a->m_Rule == b->m_Rule;
+}
+
+static inline bool drawCommandsCanMerge(const DrawCommand* a, const DrawCommand* b)
+{
+	return true
+#if VG_CONFIG_STATIC_CACHED_GEOMETRY
+		&& !bgfx::isValid(a->m_StaticIndexBufferHandle)
+		&& !bgfx::isValid(b->m_StaticIndexBufferHandle)
+#endif
+		&& a->m_Type == b->m_Type
+		&& a->m_HandleID == b->m_HandleID
+		&& a->m_VertexBufferID == b->m_VertexBufferID
+		&& clipStatesEqual(&a->m_ClipState, &b->m_ClipState)
+		&& !bx::memCmp(a->m_ScissorRect, b->m_ScissorRect, sizeof(uint16_t) * 4)
+		;
+}
+
+static inline bool rectsOverlap(const float* a, const float* b)
+{
+	return a[0] < b[2] && b[0] < a[2] && a[1] < b[3] && b[1] < a[3];
+}
+
+// Merges draw commands with an earlier compatible draw command (same type, handle, vertex buffer,
+// scissor rect and clip state) if the screen-space bounds of the draw command don't overlap any of the
+// batches it has to be moved over. Since the order of non-overlapping geometry doesn't affect the final image,
+// the result is the same as the original draw command order. Rewrites the index buffer in the new draw order.
+// NOTE: Must be called before the vertex and index buffers are submitted to bgfx.
+static void reorderDrawCommands(Context* ctx)
+{
+	const uint32_t numDrawCommands = ctx->m_NumDrawCommands;
+	if (numDrawCommands < 3) {
+		return;
+	}
+
+	struct DrawCommandBatch
+	{
+		float m_Bounds[4]; // { minx, miny, maxx, maxy }
+		uint32_t m_FirstCmdID;
+		uint32_t m_LastCmdID;
+	};
+
+	bx::AllocatorI* allocator = ctx->m_Allocator;
+	IndexBuffer* ib = &ctx->m_IndexBuffers[ctx->m_ActiveIndexBufferID];
+	const uint32_t numIndices = ib->m_Count;
+
+	const uint32_t totalMem = 0
+		+ alignSize(sizeof(DrawCommandBatch) * numDrawCommands, 16)
+		+ alignSize(sizeof(uint32_t) * numDrawCommands, 16)
+		+ alignSize(sizeof(DrawCommand) * numDrawCommands, 16)
+		+ alignSize(sizeof(index_t) * numIndices, 16);
+
+	uint8_t* mem = (uint8_t*)arenaAlloc(allocator, &ctx->m_FrameArena, totalMem);
+	DrawCommandBatch* batches = (DrawCommandBatch*)mem; mem += alignSize(sizeof(DrawCommandBatch) * numDrawCommands, 16);
+	uint32_t* nextCmdID = (uint32_t*)mem;               mem += alignSize(sizeof(uint32_t) * numDrawCommands, 16);
+	DrawCommand* newDrawCommands = (DrawCommand*)mem;   mem += alignSize(sizeof(DrawCommand) * numDrawCommands, 16);
+	index_t* oldIndices = (index_t*)mem;                mem += alignSize(sizeof(index_t) * numIndices, 16);
+
+	uint32_t numBatches = 0;
+	for (uint32_t iCmd = 0; iCmd < numDrawCommands; ++iCmd) {
+		const DrawCommand* cmd = &ctx->m_DrawCommands[iCmd];
+
+		float bounds[4] = { bx::kFloatMax, bx::kFloatMax, -bx::kFloatMax, -bx::kFloatMax };
+#if VG_CONFIG_STATIC_CACHED_GEOMETRY
+		if (bgfx::isValid(cmd->m_StaticIndexBufferHandle)) {
+			// Draw commands of cached command lists aren't in the frame's buffers. Treat them as covering
+			// the whole canvas so nothing is moved over them.
+			bounds[0] = bounds[1] = -bx::kFloatMax;
+			bounds[2] = bounds[3] = bx::kFloatMax;
+		} else
+#endif
+		{
+			const VertexBuffer* vb = &ctx->m_VertexBuffers[cmd->m_VertexBufferID];
+			const float* pos = &vb->m_Pos[cmd->m_FirstVertexID << 1];
+			const uint32_t numVertices = cmd->m_NumVertices;
+			for (uint32_t i = 0; i < numVertices; ++i) {
+				bounds[0] = bx::min<float>(bounds[0], pos[0]);
+				bounds[1] = bx::min<float>(bounds[1], pos[1]);
+				bounds[2] = bx::max<float>(bounds[2], pos[0]);
+				bounds[3] = bx::max<float>(bounds[3], pos[1]);
+				pos += 2;
+			}
+		}
+
+		uint32_t targetBatchID = UINT32_MAX;
+		const uint32_t minBatchID = numBatches > VG_CONFIG_DRAW_COMMAND_REORDER_DISTANCE ? numBatches - VG_CONFIG_DRAW_COMMAND_REORDER_DISTANCE : 0;
+		for (uint32_t iBatch = numBatches; iBatch-- > minBatchID; ) {
+			const DrawCommandBatch* batch = &batches[iBatch];
+			const DrawCommand* batchCmd = &ctx->m_DrawCommands[batch->m_FirstCmdID];
+			if (drawCommandsCanMerge(batchCmd, cmd)) {
+				targetBatchID = iBatch;
+				break;
+			}
+
+			// Don't move draw commands across clip state changes (stencil values are assigned in draw order)
+			// or over geometry they overlap.
+			if (!clipStatesEqual(&batchCmd->m_ClipState, &cmd->m_ClipState) || rectsOverlap(batch->m_Bounds, bounds)) {
+				break;
+			}
+		}
+
+		nextCmdID[iCmd] = UINT32_MAX;
+		if (targetBatchID == UINT32_MAX) {
+			DrawCommandBatch* batch = &batches[numBatches++];
+			bx::memCopy(batch->m_Bounds, bounds, sizeof(float) * 4);
+			batch->m_FirstCmdID = iCmd;
+			batch->m_LastCmdID = iCmd;
+		} else {
+			DrawCommandBatch* batch = &batches[targetBatchID];
+			batch->m_Bounds[0] = bx::min<float>(batch->m_Bounds[0], bounds[0]);
+			batch->m_Bounds[1] = bx::min<float>(batch->m_Bounds[1], bounds[1]);
+			batch->m_Bounds[2] = bx::max<float>(batch->m_Bounds[2], bounds[2]);
+			batch->m_Bounds[3] = bx::max<float>(batch->m_Bounds[3], bounds[3]);
+			nextCmdID[batch->m_LastCmdID] = iCmd;
+			batch->m_LastCmdID = iCmd;
+		}
+	}
+
+	if (numBatches != numDrawCommands) {
+		// Rewrite the index buffer: draw commands in batch order first, followed by all clip commands.
+		bx::memCopy(oldIndices, ib->m_Indices, sizeof(index_t) * numIndices);
+
+		uint32_t nextIndexID = 0;
+		for (uint32_t iBatch = 0; iBatch < numBatches; ++iBatch) {
+			const DrawCommandBatch* batch = &batches[iBatch];
+			const DrawCommand* firstCmd = &ctx->m_DrawCommands[batch->m_FirstCmdID];
+
+			DrawCommand* newCmd = &newDrawCommands[iBatch];
+			bx::memCopy(newCmd, firstCmd, sizeof(DrawCommand));
+#if VG_CONFIG_STATIC_CACHED_GEOMETRY
+			if (bgfx::isValid(firstCmd->m_StaticIndexBufferHandle)) {
+				continue;
+			}
+#endif
+
+			newCmd->m_FirstIndexID = nextIndexID;
+			newCmd->m_NumIndices = 0;
+
+			// NOTE: All commands in a batch use the same vertex buffer and they are in increasing vertex order,
+			// so the batch's vertex range covers all of them (including the vertices of the commands in between).
+			for (uint32_t iCmd = batch->m_FirstCmdID; iCmd != UINT32_MAX; iCmd = nextCmdID[iCmd]) {
+				const DrawCommand* cmd = &ctx->m_DrawCommands[iCmd];
+				const index_t delta = (index_t)(cmd->m_FirstVertexID - firstCmd->m_FirstVertexID);
+
+				vgutil::batchTransformDrawIndices(&oldIndices[cmd->m_FirstIndexID], cmd->m_NumIndices, &ib->m_Indices[nextIndexID], delta);
+				nextIndexID += cmd->m_NumIndices;
+
+				newCmd->m_NumIndices += cmd->m_NumIndices;
+				newCmd->m_NumVertices = (cmd->m_FirstVertexID + cmd->m_NumVertices) - firstCmd->m_FirstVertexID;
+			}
+		}
+
+		const uint32_t numClipCommands = ctx->m_NumClipCommands;
+		for (uint32_t iClip = 0; iClip < numClipCommands; ++iClip) {
+			DrawCommand* clipCmd = &ctx->m_ClipCommands[iClip];
+			bx::memCopy(&ib->m_Indices[nextIndexID], &oldIndices[clipCmd->m_FirstIndexID], sizeof(index_t) * clipCmd->m_NumIndices);
+			clipCmd->m_FirstIndexID = nextIndexID;
+			nextIndexID += clipCmd->m_NumIndices;
+		}
+		VG_CHECK(nextIndexID == numIndices, "Index buffer size mismatch after reordering draw commands");
+
+		bx::memCopy(ctx->m_DrawCommands, newDrawCommands, sizeof(DrawCommand) * numBatches);
+		ctx->m_NumDrawCommands = numBatches;
+	}
+}
+
+// Screen-space bounds of the clip commands of a clip state (limited to their scissor rects).
+static void calcClipStateBounds(Context* ctx, const ClipState* clipState, float* bounds)
+{
+	bounds[0] = bounds[1] = bx::kFloatMax;
+	bounds[2] = bounds[3] = -bx::kFloatMax;
+
+	const uint32_t numClipCommands = clipState->m_NumCmds;
+	for (uint32_t iClip = 0; iClip < numClipCommands; ++iClip) {
+		const DrawCommand* clipCmd = &ctx->m_ClipCommands[clipState->m_FirstCmdID + iClip];
+		const VertexBuffer* vb = &ctx->m_VertexBuffers[clipCmd->m_VertexBufferID];
+		const float* pos = &vb->m_Pos[clipCmd->m_FirstVertexID << 1];
+
+		float cmdBounds[4] = { bx::kFloatMax, bx::kFloatMax, -bx::kFloatMax, -bx::kFloatMax };
+		const uint32_t numVertices = clipCmd->m_NumVertices;
+		for (uint32_t i = 0; i < numVertices; ++i) {
+			cmdBounds[0] = bx::min<float>(cmdBounds[0], pos[0]);
+			cmdBounds[1] = bx::min<float>(cmdBounds[1], pos[1]);
+			cmdBounds[2] = bx::max<float>(cmdBounds[2], pos[0]);
+			cmdBounds[3] = bx::max<float>(cmdBounds[3], pos[1]);
+			pos += 2;
+		}
+
+		const uint16_t* scissor = clipCmd->m_ScissorRect;
+		bounds[0] = bx::min<float>(bounds[0], bx::max<float>(cmdBounds[0], (float)scissor[0]));
+		bounds[1] = bx::min<float>(bounds[1], bx::max<float>(cmdBounds[1], (float)scissor[1]));
+		bounds[2] = bx::max<float>(bounds[2], bx::min<float>(cmdBounds[2], (float)(scissor[0] + scissor[2])));
+		bounds[3] = bx::max<float>(bounds[3], bx::min<float>(cmdBounds[3], (float)(scissor[1] + scissor[3])));
+	}
+}
+
+// Returns true if the 2 clip states render exactly the same clip mask.
+static bool clipStateMasksEqual(Context* ctx, const ClipState* a, const ClipState* b)
+{
+	if (a->m_FirstCmdID == b->m_FirstCmdID && a->m_NumCmds == b->m_NumCmds) {
+		return true;
+	} else if (a->m_NumCmds != b->m_NumCmds) {
+		return false;
+	}
+
+	const IndexBuffer* ib = &ctx->m_IndexBuffers[ctx->m_ActiveIndexBufferID];
+	const uint32_t numClipCommands = a->m_NumCmds;
+	for (uint32_t iClip = 0; iClip < numClipCommands; ++iClip) {
+		const DrawCommand* cmdA = &ctx->m_ClipCommands[a->m_FirstCmdID + iClip];
+		const DrawCommand* cmdB = &ctx->m_ClipCommands[b->m_FirstCmdID + iClip];
+		if (cmdA->m_NumVertices != cmdB->m_NumVertices || cmdA->m_NumIndices != cmdB->m_NumIndices || bx::memCmp(cmdA->m_ScissorRect, cmdB->m_ScissorRect, sizeof(uint16_t) * 4) != 0) {
+			return false;
+		}
+
+		// NOTE: Indices are relative to the first vertex of the command.
+		const float* posA = &ctx->m_VertexBuffers[cmdA->m_VertexBufferID].m_Pos[cmdA->m_FirstVertexID << 1];
+		const float* posB = &ctx->m_VertexBuffers[cmdB->m_VertexBufferID].m_Pos[cmdB->m_FirstVertexID << 1];
+		if (bx::memCmp(posA, posB, sizeof(float) * 2 * cmdA->m_NumVertices) != 0
+			|| bx::memCmp(&ib->m_Indices[cmdA->m_FirstIndexID], &ib->m_Indices[cmdB->m_FirstIndexID], sizeof(index_t) * cmdA->m_NumIndices) != 0) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Intersects 2 scissor rects ({ x, y, w, h }). Returns false if the result is empty.
+static bool intersectScissorRects(const uint16_t* a, const uint16_t* b, uint16_t* res)
+{
+	const uint32_t minx = bx::max<uint32_t>(a[0], b[0]);
+	const uint32_t miny = bx::max<uint32_t>(a[1], b[1]);
+	const uint32_t maxx = bx::min<uint32_t>(a[0] + a[2], b[0] + b[2]);
+	const uint32_t maxy = bx::min<uint32_t>(a[1] + a[3], b[1] + b[3]);
+	if (maxx <= minx || maxy <= miny) {
+		return false;
+	}
+
+	res[0] = (uint16_t)minx;
+	res[1] = (uint16_t)miny;
+	res[2] = (uint16_t)(maxx - minx);
+	res[3] = (uint16_t)(maxy - miny);
+
+	return true;
+}
+
+// Returns true if the clip state is a ClipRule::In mask which covers exactly an axis-aligned rectangle with
+// integer coordinates (i.e. the same pixels as the equivalent scissor rect). The rect is returned in the
+// same format as DrawCommand::m_ScissorRect.
+static bool getClipStateRect(Context* ctx, const ClipState* clipState, uint16_t* rect)
+{
+	if (clipState->m_Rule != ClipRule::In || clipState->m_NumCmds != 1) {
+		return false;
+	}
+
+	const DrawCommand* clipCmd = &ctx->m_ClipCommands[clipState->m_FirstCmdID];
+	const float* pos = &ctx->m_VertexBuffers[clipCmd->m_VertexBufferID].m_Pos[clipCmd->m_FirstVertexID << 1];
+	const uint32_t numVertices = clipCmd->m_NumVertices;
+	if (numVertices < 3) {
+		return false;
+	}
+
+	float bounds[4] = { pos[0], pos[1], pos[0], pos[1] };
+	for (uint32_t i = 1; i < numVertices; ++i) {
+		bounds[0] = bx::min<float>(bounds[0], pos[i * 2 + 0]);
+		bounds[1] = bx::min<float>(bounds[1], pos[i * 2 + 1]);
+		bounds[2] = bx::max<float>(bounds[2], pos[i * 2 + 0]);
+		bounds[3] = bx::max<float>(bounds[3], pos[i * 2 + 1]);
+	}
+
+	if (bounds[0] < 0.0f || bounds[1] < 0.0f || bounds[2] > (float)UINT16_MAX || bounds[3] > (float)UINT16_MAX) {
+		return false;
+	}
+
+	for (uint32_t i = 0; i < 4; ++i) {
+		if (bx::floor(bounds[i]) != bounds[i]) {
+			return false;
+		}
+	}
+
+	// All vertices must be corners of the bounding rect. Any triangle formed by 3 different corners covers
+	// the half of the rect on the opposite side of the missing corner, so the whole rect is covered iff the
+	// triangles miss both corners of one of the diagonals.
+	// Corner bits: bit 0 => maxx, bit 1 => maxy. Diagonals: (0, 3) and (1, 2).
+	const IndexBuffer* ib = &ctx->m_IndexBuffers[ctx->m_ActiveIndexBufferID];
+	const index_t* indices = &ib->m_Indices[clipCmd->m_FirstIndexID];
+	const uint32_t numIndices = clipCmd->m_NumIndices;
+	uint32_t missingCorners = 0;
+	for (uint32_t i = 0; i + 2 < numIndices; i += 3) {
+		uint32_t corners[3];
+		for (uint32_t j = 0; j < 3; ++j) {
+			const float* v = &pos[indices[i + j] << 1];
+			const bool isMinX = v[0] == bounds[0];
+			const bool isMaxX = v[0] == bounds[2];
+			const bool isMinY = v[1] == bounds[1];
+			const bool isMaxY = v[1] == bounds[3];
+			if ((!isMinX && !isMaxX) || (!isMinY && !isMaxY)) {
+				return false;
+			}
+
+			corners[j] = (isMaxX ? 1 : 0) | (isMaxY ? 2 : 0);
+		}
+
+		if (corners[0] != corners[1] && corners[0] != corners[2] && corners[1] != corners[2]) {
+			missingCorners |= 1u << (corners[0] ^ corners[1] ^ corners[2]);
+		}
+	}
+
+	if ((missingCorners & 0x09) != 0x09 && (missingCorners & 0x06) != 0x06) {
+		return false;
+	}
+
+	const uint16_t boundsRect[4] = {
+		(uint16_t)bounds[0],
+		(uint16_t)bounds[1],
+		(uint16_t)(bounds[2] - bounds[0]),
+		(uint16_t)(bounds[3] - bounds[1])
+	};
+
+	// The mask is also limited by the scissor rect of the clip command.
+	return intersectScissorRects(boundsRect, clipCmd->m_ScissorRect, rect);
+}
+
+// Assigns a stencil value to the clip state of each draw command. A clip state whose mask has already
+// been written with the same clip commands (or identical geometry) reuses that stencil value, as long as no
+// mask written after it overlaps it. When all 255 values are in use, the stencil buffer is cleared and the
+// values are recycled.
+// Rectangular clip masks (see getClipStateRect()) are intersected with the scissor rects of the draw
+// commands instead of using the stencil buffer.
+// NOTE: Must be called before the vertex buffers are submitted to bgfx.
+static void assignStencilValues(Context* ctx)
+{
+	struct ClipMask
+	{
+		ClipState m_ClipState;
+		float m_Bounds[4]; // { minx, miny, maxx, maxy }
+	};
+
+	ClipMask masks[255];
+	uint32_t numMasks = 0;
+
+	const uint32_t numDrawCommands = ctx->m_NumDrawCommands;
+	uint32_t prevClipCmdID = UINT32_MAX;
+	uint8_t stencilValue = 0;
+	uint16_t clipRect[4];
+	bool isRectClip = false;
+	for (uint32_t iCmd = 0; iCmd < numDrawCommands; ++iCmd) {
+		DrawCommand* cmd = &ctx->m_DrawCommands[iCmd];
+		cmd->m_StencilFlags = 0;
+
+		const ClipState* cmdClipState = &cmd->m_ClipState;
+		if (cmdClipState->m_FirstCmdID != prevClipCmdID) {
+			prevClipCmdID = cmdClipState->m_FirstCmdID;
+			isRectClip = false;
+
+			if (cmdClipState->m_NumCmds != 0 && getClipStateRect(ctx, cmdClipState, clipRect)) {
+				// An empty scissor rect disables scissoring in bgfx, so keep using the stencil buffer if the
+				// clip rect doesn't intersect the scissor rects of all the draw commands of the clip state.
+				isRectClip = true;
+				for (uint32_t iNext = iCmd; iNext < numDrawCommands && ctx->m_DrawCommands[iNext].m_ClipState.m_FirstCmdID == prevClipCmdID; ++iNext) {
+					uint16_t rect[4];
+					if (!intersectScissorRects(ctx->m_DrawCommands[iNext].m_ScissorRect, clipRect, rect)) {
+						isRectClip = false;
+						break;
+					}
+				}
+			}
+
+			if (cmdClipState->m_NumCmds == 0 || isRectClip) {
+				stencilValue = 0;
+			} else {
+				float bounds[4];
+				calcClipStateBounds(ctx, cmdClipState, bounds);
+
+				// Search for the most recent mask which renders the same clip commands. Keep track of the bounds
+				// of all masks written after it.
+				uint32_t maskID = UINT32_MAX;
+				float laterBounds[4] = { bx::kFloatMax, bx::kFloatMax, -bx::kFloatMax, -bx::kFloatMax };
+				for (uint32_t iMask = numMasks; iMask-- > 0; ) {
+					const ClipMask* mask = &masks[iMask];
+					if (!bx::memCmp(mask->m_Bounds, bounds, sizeof(float) * 4) && clipStateMasksEqual(ctx, &mask->m_ClipState, cmdClipState)) {
+						if (!rectsOverlap(laterBounds, bounds)) {
+							maskID = iMask;
+						}
+						break;
+					}
+
+					laterBounds[0] = bx::min<float>(laterBounds[0], mask->m_Bounds[0]);
+					laterBounds[1] = bx::min<float>(laterBounds[1], mask->m_Bounds[1]);
+					laterBounds[2] = bx::max<float>(laterBounds[2], mask->m_Bounds[2]);
+					laterBounds[3] = bx::max<float>(laterBounds[3], mask->m_Bounds[3]);
+				}
+
+				if (maskID == UINT32_MAX) {
+					if (numMasks == BX_COUNTOF(masks)) {
+						cmd->m_StencilFlags |= DrawCommand::StencilFlags::Clear;
+						numMasks = 0;
+					}
+
+					maskID = numMasks++;
+					ClipMask* mask = &masks[maskID];
+					bx::memCopy(&mask->m_ClipState, cmdClipState, sizeof(ClipState));
+					bx::memCopy(mask->m_Bounds, bounds, sizeof(float) * 4);
+
+					cmd->m_StencilFlags |= DrawCommand::StencilFlags::WriteClipMask;
+				}
+
+				stencilValue = (uint8_t)(maskID + 1);
+			}
+		}
+
+		if (isRectClip) {
+			intersectScissorRects(cmd->m_ScissorRect, clipRect, cmd->m_ScissorRect);
+		}
+
+		cmd->m_StencilValue = stencilValue;
+	}
+}
+
+// NOTE: Side effect: Resets m_ForceNewDrawCommand and m_ForceNewClipCommand if the current
+// vertex buffer cannot hold the specified amount of vertices.
+static uint32_t allocVertices(Context* ctx, uint32_t numVertices, uint32_t* vbID)
+{
+	VG_CHECK(numVertices < ctx->m_Config.m_MaxVBVertices, "A single draw call cannot have more than %d vertices", ctx->m_Config.m_MaxVBVertices);
+
+	// Check if the current vertex buffer can hold the specified amount of vertices
+	VertexBuffer* vb = &ctx->m_VertexBuffers[ctx->m_NumVertexBuffers - 1];
+	if (vb->m_Count + numVertices > vb->m_Capacity && vb->m_Count + numVertices <= ctx->m_Config.m_MaxVBVertices) {
+		// It can after moving its vertices to larger streams. The vb's ID doesn't change so
+		// the current draw commands can be extended.
+		growVertexBuffer(ctx, vb, vb->m_Count + numVertices);
+	} else if (vb->m_Count + numVertices > vb->m_Capacity) {
+		// It cannot. Allocate a new vb.
+		vb = allocVertexBuffer(ctx, numVertices);
+		VG_CHECK(vb, "Failed to allocate new Vertex Buffer");
+
+		// The currently active vertex buffer has changed so force a new draw command.
+		ctx->m_ForceNewDrawCommand = true;
+		ctx->m_ForceNewClipCommand = true;
+	}
+
+	*vbID = (uint32_t)(vb - ctx->m_VertexBuffers);
+	
+	const uint32_t firstVertexID = vb->m_Count;
+	vb->m_Count += numVertices;
+	return firstVertexID;
+}
+
+static uint32_t allocIndices(Context* ctx, uint32_t numIndices)
+{
+	IndexBuffer* ib = &ctx->m_IndexBuffers[ctx->m_ActiveIndexBufferID];
+	if (ib->m_Count + numIndices > ib->m_Capacity) {
+		const uint32_t nextCapacity = ib->m_Capacity != 0 ? (ib->m_Capacity * 3) / 2 : 32;
+
+		ib->m_Capacity = bx::uint32_max(nextCapacity, ib->m_Count + numIndices);
+		ib->m_Indices = (index_t*)bx::alignedRealloc(ctx->m_Allocator, ib->m_Indices, sizeof(index_t) * ib->m_Capacity, 16);
+	}
+
+	const uint32_t firstIndexID = ib->m_Count;
+	ib->m_Count += numIndices;
+	return firstIndexID;
+}
+
+// NOTE: The old array stays in the frame arena until the next begin(), so grow geometrically.
+static void growDrawCommandArray(Context* ctx, DrawCommand** commands, uint32_t* capacity)
+{
+	const uint32_t oldCapacity = *capacity;
+	const uint32_t newCapacity = oldCapacity != 0 ? oldCapacity * 2 : 32;
+	*commands = (DrawCommand*)arenaRealloc(ctx->m_Allocator, &ctx->m_FrameArena, *commands, sizeof(DrawCommand) * oldCapacity, sizeof(DrawCommand) * newCapacity);
+	*capacity = newCapacity;
+}
+
+static DrawCommand* allocDrawCommand(Context* ctx, uint32_t numVertices, uint32_t numIndices, DrawCommand::Type::Enum type, uint16_t handle)
+{
+	uint32_t vertexBufferID;
+	const uint32_t firstVertexID = allocVertices(ctx, numVertices, &vertexBufferID);
+	const uint32_t firstIndexID = allocIndices(ctx, numIndices);
+
+	const State* state = getState(ctx);
+#if VG_CONFIG_SOFTWARE_SCISSOR
+	// The geometry has already been clipped against the scissor rect, unless clipMeshToScissorRect()/clipTextQuadsToScissorRect()
+	// couldn't do it.
+	const float canvasRect[4] = { 0.0f, 0.0f, (float)ctx->m_CanvasWidth, (float)ctx->m_CanvasHeight };
+	const float* scissor = ctx->m_ForceHardwareScissor ? state->m_ScissorRect : canvasRect;
+	ctx->m_ForceHardwareScissor = false;
+#else
+	const float* scissor = state->m_ScissorRect;
+#endif
+
+	if (!ctx->m_ForceNewDrawCommand && ctx->m_NumDrawCommands != 0) {
+		DrawCommand* prevCmd = &ctx->m_DrawCommands[ctx->m_NumDrawCommands - 1];
+
+		VG_CHECK(prevCmd->m_VertexBufferID == vertexBufferID, "Cannot merge draw commands with different vertex buffers");
+#if VG_CONFIG_SOFTWARE_SCISSOR
+		const bool sameScissor = true
+			&& prevCmd->m_ScissorRect[0] == (uint16_t)scissor[0]
+			&& prevCmd->m_ScissorRect[1] == (uint16_t)scissor[1]
+			&& prevCmd->m_ScissorRect[2] == (uint16_t)scissor[2]
+			&& prevCmd->m_ScissorRect[3] == (uint16_t)scissor[3]
+			;
+#else
+		VG_CHECK(prevCmd->m_ScissorRect[0] == (uint16_t)scissor[0]
+		      && prevCmd->m_ScissorRect[1] == (uint16_t)scissor[1] 
+		      && prevCmd->m_ScissorRect[2] == (uint16_t)scissor[2] 
+		      && prevCmd->m_ScissorRect[3] == (uint16_t)scissor[3], "Invalid scissor rect");
+		const bool sameScissor = true;
+#endif
+
+		if (sameScissor && prevCmd->m_Type == type && prevCmd->m_HandleID == handle) {
+			return prevCmd;
+		}
+	}
+
+	// The new draw command cannot be combined with the previous one. Create a new one.
+	if (ctx->m_NumDrawCommands == ctx->m_DrawCommandCapacity) {
+		growDrawCommandArray(ctx, &ctx->m_DrawCommands, &ctx->m_DrawCommandCapacity);
+	}
+
+	DrawCommand* cmd = &ctx->m_DrawCommands[ctx->m_NumDrawCommands];
+	ctx->m_NumDrawCommands++;
+
+	cmd->m_VertexBufferID = vertexBufferID;
+	cmd->m_FirstVertexID = firstVertexID;
+	cmd->m_FirstIndexID = firstIndexID;
+	cmd->m_NumVertices = 0;
+	cmd->m_NumIndices = 0;
+	cmd->m_Type = type;
+	cmd->m_HandleID = handle;
+	cmd->m_ScissorRect[0] = (uint16_t)scissor[0];
+	cmd->m_ScissorRect[1] = (uint16_t)scissor[1];
+	cmd->m_ScissorRect[2] = (uint16_t)scissor[2];
+	cmd->m_ScissorRect[3] = (uint16_t)scissor[3];
+	bx::memCopy(&cmd->m_ClipState, &ctx->m_ClipState, sizeof(ClipState));
+#if VG_CONFIG_STATIC_CACHED_GEOMETRY
+	cmd->m_StaticIndexBufferHandle = BGFX_INVALID_HANDLE;
+#endif
+
+	ctx->m_ForceNewDrawCommand = false;
+
+	return cmd;
+}
+
+static DrawCommand* allocClipCommand(Context* ctx, uint32_t numVertices, uint32_t numIndices)
+{
+	uint32_t vertexBufferID;
+	const uint32_t firstVertexID = allocVertices(ctx, numVertices, &vertexBufferID);
+	const uint32_t firstIndexID = allocIndices(ctx, numIndices);
+	
+	const State* state = getState(ctx);
+	const float* scissor = state->m_ScissorRect;
+
+	if (!ctx->m_ForceNewClipCommand && ctx->m_NumClipCommands != 0) {
+		DrawCommand* prevCmd = &ctx->m_ClipCommands[ctx->m_NumClipCommands - 1];
+
+		VG_CHECK(prevCmd->m_VertexBufferID == vertexBufferID, "Cannot merge clip commands with different vertex buffers");
+		VG_CHECK(prevCmd->m_ScissorRect[0] == (uint16_t)scissor[0] 
+		      && prevCmd->m_ScissorRect[1] == (uint16_t)scissor[1] 
+		      && prevCmd->m_ScissorRect[2] == (uint16_t)scissor[2] 
+		      && prevCmd->m_ScissorRect[3] == (uint16_t)scissor[3], "Invalid scissor rect");
+		VG_CHECK(prevCmd->m_Type == DrawCommand::Type::Clip, "Invalid draw command type");
+
+		return prevCmd;
+	}
+
+	// The new clip command cannot be combined with the previous one. Create a new one.
+	if (ctx->m_NumClipCommands == ctx->m_ClipCommandCapacity) {
+		growDrawCommandArray(ctx, &ctx->m_ClipCommands, &ctx->m_ClipCommandCapacity);
+	}
+
+	DrawCommand* cmd = &ctx->m_ClipCommands[ctx->m_NumClipCommands];
+	ctx->m_NumClipCommands++;
+
+	cmd->m_VertexBufferID = vertexBufferID;
+	cmd->m_FirstVertexID = firstVertexID;
+	cmd->m_FirstIndexID = firstIndexID;
+	cmd->m_NumVertices = 0;
+	cmd->m_NumIndices = 0;
+	cmd->m_Type = DrawCommand::Type::Clip;
+	cmd->m_HandleID = UINT16_MAX;
+	cmd->m_ScissorRect[0] = (uint16_t)scissor[0];
+	cmd->m_ScissorRect[1] = (uint16_t)scissor[1];
+	cmd->m_ScissorRect[2] = (uint16_t)scissor[2];
+	cmd->m_ScissorRect[3] = (uint16_t)scissor[3];
+	cmd->m_ClipState.m_FirstCmdID = ~0u;
+	cmd->m_ClipState.m_NumCmds = 0;
+#if VG_CONFIG_STATIC_CACHED_GEOMETRY
+	cmd->m_StaticIndexBufferHandle = BGFX_INVALID_HANDLE;
+#endif
+
+	ctx->m_ForceNewClipCommand = false;
+
+	return cmd;
+}
+
+static void resetImage(Image* img)
+{
+	img->m_bgfxHandle = BGFX_INVALID_HANDLE;
+	img->m_Width = 0;
+	img->m_Height = 0;
+	img->m_Flags = 0;
+	img->m_Owned = false;
+#if VG_CONFIG_SOFTWARE_RASTERIZER
+	img->m_RasterData = nullptr;
+#endif
+}
+
+static ImageHandle allocImage(Context* ctx)
+{
+	ImageHandle handle = { ctx->m_ImageHandleAlloc->alloc() };
+	if (!isValid(handle)) {
+		return VG_INVALID_HANDLE;
+	}
+
+	if (handle.idx >= ctx->m_ImageCapacity) {
+		const uint32_t oldCapacity = ctx->m_ImageCapacity;
+
+		ctx->m_ImageCapacity = bx::uint32_min(bx::uint32_max(ctx->m_ImageCapacity + 4, handle.idx + 1),
+																				  ctx->m_Config.m_MaxImages + VG_CONFIG_NUM_INTERNAL_IMAGES);
+		ctx->m_Images = (Image*)bx::realloc(ctx->m_Allocator, ctx->m_Images, sizeof(Image) * ctx->m_ImageCapacity);
+		if (!ctx->m_Images) {
+			return VG_INVALID_HANDLE;
+		}
+
+		// Reset all new textures...
+		const uint32_t capacity = ctx->m_ImageCapacity;
+		for (uint32_t i = oldCapacity; i < capacity; ++i) {
+			resetImage(&ctx->m_Images[i]);
+		}
+	}
+
+	VG_CHECK(handle.idx < ctx->m_ImageCapacity, "Allocated invalid image handle");
+	Image* tex = &ctx->m_Images[handle.idx];
+	VG_CHECK(!bgfx::isValid(tex->m_bgfxHandle), "Allocated texture is already in use");
+	resetImage(tex);
+
+	return handle;
+}
+
+static bool allocTextAtlas(Context* ctx)
+{
+	flushTextAtlas(ctx);
+
+	if (ctx->m_FontImageID + 1 >= VG_CONFIG_MAX_FONT_IMAGES) {
+		VG_WARN(false, "No more text atlases for this frame");
+		return false;
+	}
+
+	// if next fontImage already have a texture
+	uint16_t iw, ih;
+	if (isValid(ctx->m_FontImages[ctx->m_FontImageID + 1])) {
+		getImageSize(ctx, ctx->m_FontImages[ctx->m_FontImageID + 1], &iw, &ih);
+	} else {
+		// calculate the new font image size and create it.
+		bool imgSizeValid = getImageSize(ctx, ctx->m_FontImages[ctx->m_FontImageID], &iw, &ih);
+		VG_CHECK(imgSizeValid, "Invalid font atlas dimensions");
+		BX_UNUSED(imgSizeValid);
+
+		if (iw > ih) {
+			ih *= 2;
+		} else {
+			iw *= 2;
+		}
+
+		const uint32_t maxTextureSize = bgfx::getCaps()->limits.maxTextureSize;
+		if (iw > maxTextureSize || ih > maxTextureSize) {
+			iw = ih = (uint16_t)maxTextureSize;
+		}
+
+		ctx->m_FontImages[ctx->m_FontImageID + 1] = createImage(ctx, iw, ih, ctx->m_Config.m_FontAtlasImageFlags, nullptr);
+	}
+
+	++ctx->m_FontImageID;
+	updateWhitePixelUV(ctx);
+
+	fonsResetAtlas(ctx->m_FontStashContext, iw, ih);
+	ctx->m_Stats.m_NumAtlasResets++;
+
+	return true;
+}
+
+static void renderTextQuads(Context* ctx, uint32_t numQuads, Color color)
+{
+	const State* state = getState(ctx);
+	const float scale = state->m_FontScale * ctx->m_DevicePixelRatio;
+	const float invscale = 1.0f / scale;
+
+	const uint32_t c = colorSetAlpha(color, (uint8_t)(state->m_GlobalAlpha * colorGetAlpha(color)));
+	if (colorGetAlpha(c) == 0) {
+		return;
+	}
+
+	float mtx[6];
+	mtx[0] = state->m_TransformMtx[0] * invscale;
+	mtx[1] = state->m_TransformMtx[1] * invscale;
+	mtx[2] = state->m_TransformMtx[2] * invscale;
+	mtx[3] = state->m_TransformMtx[3] * invscale;
+	mtx[4] = state->m_TransformMtx[4];
+	mtx[5] = state->m_TransformMtx[5];
+
+#if VG_CONFIG_SOFTWARE_SCISSOR
+	numQuads = clipTextQuadsToScissorRect(ctx, ctx->m_TextQuads, numQuads, mtx);
+	if (numQuads == 0) {
+		return;
+	}
+#endif
+
+	// TODO: Calculate bounding rect of the quads.
+	vgutil::batchTransformTextQuads(&ctx->m_TextQuads->x0, numQuads, mtx, ctx->m_TextVertices);
+
+	const uint32_t numDrawVertices = numQuads * 4;
+	const uint32_t numDrawIndices = numQuads * 6;
+
+	DrawCommand* cmd = allocDrawCommand(ctx, numDrawVertices, numDrawIndices, DrawCommand::Type::Textured, ctx->m_FontImages[ctx->m_FontImageID].idx);
+
+	VertexBuffer* vb = &ctx->m_VertexBuffers[cmd->m_VertexBufferID];
+	const uint32_t vbOffset = cmd->m_FirstVertexID + cmd->m_NumVertices;
+
+	float* dstPos = &vb->m_Pos[vbOffset << 1];
+	bx::memCopy(dstPos, ctx->m_TextVertices, sizeof(float) * 2 * numDrawVertices);
+
+	uint32_t* dstColor = &vb->m_Color[vbOffset];
+	vgutil::memset32(dstColor, numDrawVertices, &c);
+
+#if VG_CONFIG_UV_INT16
+	int16_t* dstUV = &vb->m_UV[vbOffset << 1];
+	const FONSquad* q = ctx->m_TextQuads;
+	uint32_t nq = numQuads;
+	while (nq-- > 0) {
+		const float s0 = q->s0;
+		const float s1 = q->s1;
+		const float t0 = q->t0;
+		const float t1 = q->t1;
+
+		dstUV[0] = (int16_t)(s0 * INT16_MAX); dstUV[1] = (int16_t)(t0 * INT16_MAX);
+		dstUV[2] = (int16_t)(s1 * INT16_MAX); dstUV[3] = (int16_t)(t0 * INT16_MAX);
+		dstUV[4] = (int16_t)(s1 * INT16_MAX); dstUV[5] = (int16_t)(t1 * INT16_MAX);
+		dstUV[6] = (int16_t)(s0 * INT16_MAX); dstUV[7] = (int16_t)(t1 * INT16_MAX);
+
+		dstUV += 8;
+		++q;
+	}
+#else
+	float* dstUV = &vb->m_UV[vbOffset << 1];
+	const FONSquad* q = ctx->m_TextQuads;
+	uint32_t nq = numQuads;
+	while (nq-- > 0) {
+		const float s0 = q->s0;
+		const float s1 = q->s1;
+		const float t0 = q->t0;
+		const float t1 = q->t1;
+
+		dstUV[0] = s0; dstUV[1] = t0;
+		dstUV[2] = s1; dstUV[3] = t0;
+		dstUV[4] = s1; dstUV[5] = t1;
+		dstUV[6] = s0; dstUV[7] = t1;
+
+		dstUV += 8;
+		++q;
+	}
+#endif
+
+	IndexBuffer* ib = &ctx->m_IndexBuffers[ctx->m_ActiveIndexBufferID];
+	index_t* dstIndex = &ib->m_Indices[cmd->m_FirstIndexID + cmd->m_NumIndices];
+	vgutil::genQuadIndices_unaligned(dstIndex, numQuads, (index_t)cmd->m_NumVertices);
+
+	cmd->m_NumVertices += numDrawVertices;
+	cmd->m_NumIndices += numDrawIndices;
+}
+
+static void flushTextAtlas(Context* ctx)
+{
+	FONScontext* fons = ctx->m_FontStashContext;
+
+	int dirty[4];
+	if (!fonsValidateTexture(fons, dirty)) {
+		return;
+	}
+
+	// Update texture
+	ImageHandle fontImage = ctx->m_FontImages[ctx->m_FontImageID];
+	if (!isValid(fontImage)) {
+		return;
+	}
+
+	int iw, ih;
+	const uint8_t* a8Data = fonsGetTextureData(fons, &iw, &ih);
+	VG_CHECK(iw > 0 && ih > 0, "Invalid font atlas dimensions");
+
+	// TODO: Convert only the dirty part of the texture (it's the only part that will be uploaded to the backend)
+	uint32_t* rgbaData = (uint32_t*)arenaAlloc(ctx->m_Allocator, &ctx->m_FrameArena, sizeof(uint32_t) * iw * ih);
+	vgutil::convertA8_to_RGBA8(rgbaData, a8Data, (uint32_t)iw, (uint32_t)ih, 0x00FFFFFF);
+
+	int x = dirty[0];
+	int y = dirty[1];
+	int w = dirty[2] - dirty[0];
+	int h = dirty[3] - dirty[1];
+	updateImage(ctx, fontImage, (uint16_t)x, (uint16_t)y, (uint16_t)w, (uint16_t)h, (const uint8_t*)rgbaData);
+	ctx->m_Stats.m_NumAtlasUploads++;
+}
+
+#if VG_CONFIG_BATCH_LINEAR_GRADIENTS
+static void flushGradientRamps(Context* ctx)
+{
+	const uint32_t numGradients = ctx->m_NextGradientID;
+	if (numGradients == 0) {
+		return;
+	}
+
+	// NOTE: Rows of box/radial gradients hold stale data but they are never sampled.
+	updateImage(ctx, ctx->m_GradientRampImage, 0, 0, 2, (uint16_t)numGradients, (const uint8_t*)ctx->m_GradientRampData);
+}
+#endif
+
+
+static CommandListHandle allocCommandList(Context* ctx)
+{
+	CommandListHandle handle = { ctx->m_CmdListHandleAlloc->alloc() };
+	if (!isValid(handle)) {
+		return VG_INVALID_HANDLE;
+	}
+
+	VG_CHECK(handle.idx < ctx->m_Config.m_MaxCommandLists, "Allocated invalid command list handle");
+	CommandList* cl = &ctx->m_CmdLists[handle.idx];
+	bx::memSet(cl, 0, sizeof(CommandList));
+
+	return handle;
+}
+
+static inline bool isCommandListHandleValid(Context* ctx, CommandListHandle handle)
+{
+	return isValid(handle) && ctx->m_CmdListHandleAlloc->isValid(handle.idx);
+}
+
+#if VG_CONFIG_ENABLE_SHAPE_CACHING
+static CommandListCache* allocCommandListCache(Context* ctx)
+{
+	bx::AllocatorI* allocator = ctx->m_Allocator;
+
+	CommandListCache* cache = (CommandListCache*)bx::alloc(allocator, sizeof(CommandListCache));
+	bx::memSet(cache, 0, sizeof(CommandListCache));
+
+#if VG_CONFIG_STATIC_CACHED_GEOMETRY
+	CachedGeometry* geometry = &cache->m_Geometry;
+	geometry->m_PosBufferHandle = BGFX_INVALID_HANDLE;
+	geometry->m_UVBufferHandle = BGFX_INVALID_HANDLE;
+	geometry->m_ColorBufferHandle = BGFX_INVALID_HANDLE;
+	geometry->m_IndexBufferHandle = BGFX_INVALID_HANDLE;
+	geometry->m_IsStale = true;
+#endif
+
+	return cache;
+}
+
+static void freeCommandListCache(Context* ctx, CommandListCache* cache)
+{
+	bx::AllocatorI* allocator = ctx->m_Allocator;
+
+	arenaDestroy(allocator, &cache->m_Arena);
+#if VG_CONFIG_STATIC_CACHED_GEOMETRY
+	clCacheDestroyGeometry(ctx, cache);
+#endif
+	bx::free(allocator, cache);
+}
+#endif
+
+// NOTE: capacity must be at least m_CommandBufferPos.
+static void clResizeCommandBuffer(Context* ctx, CommandList* cl, uint32_t capacity)
+{
+	VG_CHECK(capacity >= cl->m_CommandBufferPos, "Command buffer capacity smaller than its contents");
+	if (capacity == 0) {
+		bx::alignedFree(ctx->m_Allocator, cl->m_CommandBuffer, VG_CONFIG_COMMAND_LIST_ALIGNMENT);
+		cl->m_CommandBuffer = nullptr;
+	} else {
+		cl->m_CommandBuffer = (uint8_t*)bx::alignedRealloc(ctx->m_Allocator, cl->m_CommandBuffer, capacity, VG_CONFIG_COMMAND_LIST_ALIGNMENT);
+	}
+	cl->m_CommandBufferCapacity = capacity;
+}
+
+// NOTE: capacity must be at least m_StringBufferPos.
+static void clResizeStringBuffer(Context* ctx, CommandList* cl, uint32_t capacity)
+{
+	VG_CHECK(capacity >= cl->m_StringBufferPos, "String buffer capacity smaller than its contents");
+	if (capacity == 0) {
+		bx::free(ctx->m_Allocator, cl->m_StringBuffer);
+		cl->m_StringBuffer = nullptr;
+	} else {
+		cl->m_StringBuffer = (char*)bx::realloc(ctx->m_Allocator, cl->m_StringBuffer, capacity);
+	}
+	cl->m_StringBufferCapacity = capacity;
+}
+
+static uint8_t* clAllocCommand(Context* ctx, CommandList* cl, CommandType::Enum cmdType, uint32_t dataSize)
+{
+	const uint32_t alignedDataSize = alignSize(dataSize, VG_CONFIG_COMMAND_LIST_ALIGNMENT);
+	const uint32_t headerSize = clGetCommandHeaderSize(alignedDataSize);
+	const uint32_t totalSize = 0
+		+ headerSize
+		+ alignedDataSize;
+
+#if VG_CONFIG_DEBUG
+	const int32_t numWriters = bx::atomicAddAndFetch<int32_t>(&cl->m_DebugNumWriters, 1);
+	VG_CHECK(numWriters == 1, "Command list is being recorded from more than one thread");
+#endif
+
+	const uint32_t pos = cl->m_CommandBufferPos;
+	VG_CHECK(isAligned(pos, VG_CONFIG_COMMAND_LIST_ALIGNMENT), "Unaligned command buffer position");
+
+	if (pos + totalSize > cl->m_CommandBufferCapacity) {
+		const uint32_t nextCapacity = cl->m_CommandBufferCapacity != 0 ? (cl->m_CommandBufferCapacity * 3) / 2 : 256;
+		clResizeCommandBuffer(ctx, cl, bx::max<uint32_t>(nextCapacity, pos + totalSize));
+	}
+
+	uint8_t* ptr = &cl->m_CommandBuffer[pos];
+	cl->m_CommandBufferPos += totalSize;
+
+#if VG_CONFIG_COMPACT_COMMAND_LISTS
+	VG_CHECK((uint32_t)cmdType <= 0xFF, "Command type doesn't fit in a compact command header");
+	if (alignedDataSize < kCompactCommandSizeEscape) {
+		CMD_WRITE(ptr, uint32_t, (uint32_t)cmdType | (alignedDataSize << 8));
+	} else {
+		CMD_WRITE(ptr, uint32_t, (uint32_t)cmdType | (kCompactCommandSizeEscape << 8));
+		CMD_WRITE(ptr, uint32_t, alignedDataSize);
+	}
+#else
+	CommandHeader* hdr = (CommandHeader*)ptr;
+	ptr += kAlignedCommandHeaderSize;
+
+	hdr->m_Type = cmdType;
+	hdr->m_Size = alignedDataSize;
+#endif
+
+#if VG_CONFIG_DEBUG
+	bx::atomicFetchAndAdd<int32_t>(&cl->m_DebugNumWriters, -1);
+#endif
+
+	return ptr;
+}
+
+static inline uint32_t clGetCommandHeaderSize(uint32_t dataSize)
+{
+#if VG_CONFIG_COMPACT_COMMAND_LISTS
+	return dataSize < kCompactCommandSizeEscape ? sizeof(uint32_t) : sizeof(uint32_t) * 2;
+#else
+	BX_UNUSED(dataSize);
+	return kAlignedCommandHeaderSize;
+#endif
+}
+
+// Returns a pointer to the command's data.
+static inline const uint8_t* clReadCommandHeader(const uint8_t* cmd, CommandType::Enum* type, uint32_t* dataSize)
+{
+#if VG_CONFIG_COMPACT_COMMAND_LISTS
+	const uint32_t header = CMD_READ(cmd, uint32_t);
+	*type = (CommandType::Enum)(header & 0xFF);
+	*dataSize = header >> 8;
+	if (*dataSize == kCompactCommandSizeEscape) {
+		*dataSize = CMD_READ(cmd, uint32_t);
+	}
+
+	return cmd;
+#else
+	const CommandHeader* header = (const CommandHeader*)cmd;
+	*type = header->m_Type;
+	*dataSize = header->m_Size;
+
+	return cmd + kAlignedCommandHeaderSize;
+#endif
+}
+
+#if VG_CONFIG_COMMAND_LIST_FIXED_POINT_BITS
+// Records a path command with fixed point coordinates (Polyline commands are prefixed with the number of
+// points). Returns false, without recording anything, if any of the coordinates is out of range.
+static bool clStoreFixedPointCommand(Context* ctx, CommandList* cl, CommandType::Enum cmdType, const float* coords, uint32_t numCoords)
+{
+	const bool isPolyline = cmdType == CommandType::PolylineFixed;
+	const uint32_t pos = cl->m_CommandBufferPos;
+
+	uint8_t* ptr = clAllocCommand(ctx, cl, cmdType, (isPolyline ? sizeof(uint32_t) : 0) + sizeof(int16_t) * numCoords);
+	if (isPolyline) {
+		CMD_WRITE(ptr, uint32_t, numCoords >> 1);
+	}
+
+	if (!quantizeCoords((int16_t*)ptr, coords, numCoords)) {
+		cl->m_CommandBufferPos = pos;
+		return false;
+	}
+
+	return true;
+}
+
+static bool quantizeCoords(int16_t* dst, const float* src, uint32_t numCoords)
+{
+	for (uint32_t i = 0; i < numCoords; ++i) {
+		const float q = bx::floor(src[i] * kFixedPointScale + 0.5f);
+		if (!(q >= -32768.0f && q <= 32767.0f)) {
+			return false;
+		}
+
+		dst[i] = (int16_t)q;
+	}
+
+	return true;
+}
+
+static void dequantizeCoords(float* dst, const int16_t* src, uint32_t numCoords)
+{
+	for (uint32_t i = 0; i < numCoords; ++i) {
+		dst[i] = (float)src[i] * kInvFixedPointScale;
+	}
+}
+#endif
+
+static uint32_t clStoreString(Context* ctx, CommandList* cl, const char* str, uint32_t len)
+{
+	if (cl->m_StringBufferPos + len > cl->m_StringBufferCapacity) {
+		const uint32_t nextCapacity = cl->m_StringBufferCapacity != 0 ? (cl->m_StringBufferCapacity * 3) / 2 : 128;
+		clResizeStringBuffer(ctx, cl, bx::max<uint32_t>(nextCapacity, cl->m_StringBufferPos + len));
+	}
+
+	const uint32_t offset = cl->m_StringBufferPos;
+	bx::memCopy(cl->m_StringBuffer + offset, str, len);
+	cl->m_StringBufferPos += len;
+	return offset;
+}
+
+// NOTE: Must be called from the thread which owns the context (createCommandList()/submitCommandList()/etc.).
+static void clMergeStats(Context* ctx, CommandList* cl)
+{
+	VG_CHECK(bx::atomicFetchAndAdd<int32_t>(&cl->m_DebugNumWriters, 0) == 0, "Command list is still being recorded on another thread");
+
+	Stats* stats = &ctx->m_Stats;
+	stats->m_CmdListMemoryTotal = (stats->m_CmdListMemoryTotal - cl->m_MergedMemoryTotal) + cl->m_CommandBufferCapacity;
+	stats->m_CmdListMemoryUsed = (stats->m_CmdListMemoryUsed - cl->m_MergedMemoryUsed) + cl->m_CommandBufferPos;
+	cl->m_MergedMemoryTotal = cl->m_CommandBufferCapacity;
+	cl->m_MergedMemoryUsed = cl->m_CommandBufferPos;
+}
+
+#if VG_CONFIG_ENABLE_SHAPE_CACHING
+static CommandListCache* clGetCache(Context* ctx, CommandList* cl)
+{
+	if ((cl->m_Flags & CommandListFlags::Cacheable) == 0) {
+		return nullptr;
+	}
+
+	CommandListCache* cache = cl->m_Cache;
+	if (!cache) {
+		cache = allocCommandListCache(ctx);
+		cl->m_Cache = cache;
+	}
+
+	return cache;
+}
+
+#if VG_CONFIG_COMMAND_LIST_AUTO_CACHING
+// Returns the list's cache if its commands are the same as in the previous submit. Otherwise, a copy
+// of the new content is stored, any previously cached geometry is invalidated and nullptr is returned
+// (the list is executed without caching; the cache will be built on the next identical submit).
+// The comparison is byte for byte because a list reset and re-recorded every frame has to match the
+// previous frame's content, and a hash collision would replay stale geometry.
+static CommandListCache* clGetAutoCache(Context* ctx, CommandList* cl)
+{
+	// Cached geometry doesn't include the global alpha.
+	if (getState(ctx)->m_GlobalAlpha != 1.0f) {
+		return nullptr;
+	}
+
+	const uint8_t* cmd = cl->m_CommandBuffer;
+	const uint8_t* cmdListEnd = cl->m_CommandBuffer + cl->m_CommandBufferPos;
+	while (cmd < cmdListEnd) {
+		CommandType::Enum cmdType;
+		uint32_t cmdSize;
+		cmd = clReadCommandHeader(cmd, &cmdType, &cmdSize);
+		if (cmdType == CommandType::SetGlobalAlpha) {
+			return nullptr;
+		}
+
+		cmd += cmdSize;
+	}
+
+	const uint32_t cmdSize = cl->m_CommandBufferPos;
+	const uint32_t strSize = cl->m_StringBufferPos;
+	const bool unchanged = true
+		&& cl->m_PrevContent != nullptr
+		&& cmdSize == cl->m_PrevCommandBufferSize
+		&& strSize == cl->m_PrevStringBufferSize
+		&& !bx::memCmp(cl->m_PrevContent, cl->m_CommandBuffer, cmdSize)
+		&& !bx::memCmp(cl->m_PrevContent + cmdSize, cl->m_StringBuffer, strSize);
+
+	CommandListCache* cache = cl->m_Cache;
+	if (!unchanged) {
+		if (cmdSize + strSize > cl->m_PrevContentCapacity) {
+			cl->m_PrevContentCapacity = cmdSize + strSize;
+			cl->m_PrevContent = (uint8_t*)bx::realloc(ctx->m_Allocator, cl->m_PrevContent, cl->m_PrevContentCapacity);
+		}
+
+		bx::memCopy(cl->m_PrevContent, cl->m_CommandBuffer, cmdSize);
+		bx::memCopy(cl->m_PrevContent + cmdSize, cl->m_StringBuffer, strSize);
+		cl->m_PrevCommandBufferSize = cmdSize;
+		cl->m_PrevStringBufferSize = strSize;
+
+		if (cache) {
+			clCacheReset(ctx, cache);
+		}
+
+		return nullptr;
+	}
+
+	if (!cache) {
+		cache = allocCommandListCache(ctx);
+		cl->m_Cache = cache;
+	}
+
+	return cache;
+}
+#endif
+
+static void pushCommandListCache(Context* ctx, CommandListCache* cache)
+{
+	VG_CHECK(ctx->m_CmdListCacheStackTop + 1 < VG_CONFIG_COMMAND_LIST_CACHE_STACK_SIZE, "Command list cache stack overflow");
+	++ctx->m_CmdListCacheStackTop;
+	ctx->m_CmdListCacheStack[ctx->m_CmdListCacheStackTop] = cache;
+}
+
+static void popCommandListCache(Context* ctx)
+{
+	VG_CHECK(ctx->m_CmdListCacheStackTop != ~0u, "Command list cache stack underflow");
+	--ctx->m_CmdListCacheStackTop;
+}
+
+static CommandListCache* getCommandListCacheStackTop(Context* ctx)
+{
+	const uint32_t top = ctx->m_CmdListCacheStackTop;
+	return top == ~0u ? nullptr : ctx->m_CmdListCacheStack[top];
+}
+
+static void beginCachedCommand(Context* ctx)
+{
+	CommandListCache* cache = getCommandListCacheStackTop(ctx);
+	VG_CHECK(cache, "No bound CommandListCache");
+
+	const State* state = getState(ctx);
+	cacheBeginCommand(ctx->m_Allocator, cache, state->m_TransformMtx);
+}
+
+static void endCachedCommand(Context* ctx)
+{
+	CommandListCache* cache = getCommandListCacheStackTop(ctx);
+	VG_CHECK(cache, "No bound CommandListCache");
+
+	cacheEndCommand(cache);
+}
+
+static void addCachedCommand(Context* ctx, const float* pos, uint32_t numVertices, const uint32_t* colors, uint32_t numColors, const uint16_t* indices, uint32_t numIndices)
+{
+	CommandListCache* cache = getCommandListCacheStackTop(ctx);
+	VG_CHECK(cache, "No bound CommandListCache");
+
+	cacheAddMesh(ctx->m_Allocator, cache, pos, numVertices, colors, numColors, indices, numIndices);
+}
+
+static void cacheBeginCommand(bx::AllocatorI* allocator, CommandListCache* cache, const float* transformMtx)
+{
+	if (cache->m_NumCommands == cache->m_CommandCapacity) {
+		const uint32_t oldCapacity = cache->m_CommandCapacity;
+		cache->m_CommandCapacity = oldCapacity != 0 ? oldCapacity * 2 : 16;
+		cache->m_Commands = (CachedCommand*)arenaRealloc(allocator, &cache->m_Arena, cache->m_Commands, sizeof(CachedCommand) * oldCapacity, sizeof(CachedCommand) * cache->m_CommandCapacity);
+	}
+
+	cache->m_NumCommands++;
+
+	CachedCommand* lastCmd = &cache->m_Commands[cache->m_NumCommands - 1];
+	lastCmd->m_FirstMeshID = (uint16_t)cache->m_NumMeshes;
+	lastCmd->m_NumMeshes = 0;
+
+	vgutil::invertMatrix3(transformMtx, lastCmd->m_InvTransformMtx);
+}
+
+static void cacheEndCommand(CommandListCache* cache)
+{
+	VG_CHECK(cache->m_NumCommands != 0, "beginCachedCommand() hasn't been called");
+
+	CachedCommand* lastCmd = &cache->m_Commands[cache->m_NumCommands - 1];
+	VG_CHECK(lastCmd->m_NumMeshes == 0, "endCachedCommand() called too many times");
+	lastCmd->m_NumMeshes = (uint16_t)(cache->m_NumMeshes - lastCmd->m_FirstMeshID);
+}
+
+static void cacheAddMesh(bx::AllocatorI* allocator, CommandListCache* cache, const float* pos, uint32_t numVertices, const uint32_t* colors, uint32_t numColors, const uint16_t* indices, uint32_t numIndices)
+{
+	if (cache->m_NumMeshes == cache->m_MeshCapacity) {
+		const uint32_t oldCapacity = cache->m_MeshCapacity;
+		cache->m_MeshCapacity = oldCapacity != 0 ? oldCapacity * 2 : 16;
+		cache->m_Meshes = (CachedMesh*)arenaRealloc(allocator, &cache->m_Arena, cache->m_Meshes, sizeof(CachedMesh) * oldCapacity, sizeof(CachedMesh) * cache->m_MeshCapacity);
+	}
+
+	cache->m_NumMeshes++;
+
+	CachedMesh* mesh = &cache->m_Meshes[cache->m_NumMeshes - 1];
+
+	const uint32_t totalMem = 0
+		+ alignSize(sizeof(float) * 2 * numVertices, 16)
+		+ ((numColors != 1) ? alignSize(sizeof(uint32_t) * numVertices, 16) : 0)
+		+ alignSize(sizeof(uint16_t) * numIndices, 16);
+
+	uint8_t* mem = (uint8_t*)arenaAlloc(allocator, &cache->m_Arena, totalMem);
+	mesh->m_Pos = (float*)mem;
+	mem += alignSize(sizeof(float) * 2 * numVertices, 16);
+	
+	const float* invMtx = cache->m_Commands[cache->m_NumCommands - 1].m_InvTransformMtx;
+	vgutil::batchTransformPositions(pos, numVertices, mesh->m_Pos, invMtx);
+	mesh->m_NumVertices = numVertices;
+
+	if (numColors == 1) {
+		mesh->m_Colors = nullptr;
+#if VG_CONFIG_STATIC_CACHED_GEOMETRY
+		mesh->m_Color = colors[0];
+#endif
+	} else {
+		VG_CHECK(numColors == numVertices, "Invalid number of colors");
+		mesh->m_Colors = (uint32_t*)mem;
+		mem += alignSize(sizeof(uint32_t) * numVertices, 16);
+
+		bx::memCopy(mesh->m_Colors, colors, sizeof(uint32_t) * numColors);
+	}
+
+	mesh->m_Indices = (uint16_t*)mem;
+	bx::memCopy(mesh->m_Indices, indices, sizeof(uint16_t) * numIndices);
+	mesh->m_NumIndices = numIndices;
+}
+
+// Walk the command list and build the cached meshes of all Stroker commands, without generating any
+// draw commands. Only path, transform and clip commands are tracked, since they are the only ones which
+// affect the generated geometry. Everything else is executed by clCacheRender() at submit time.
+// NOTE: Uses only the Tesselator's scratch buffers (no Context state), so it can run on worker threads.
+static void clCacheBuild(Context* ctx, Tesselator* tess, CommandList* cl, CommandListCache* cache)
+{
+	const float testTol = ctx->m_TesselationTolerance;
+	const float fringeWidth = ctx->m_FringeWidth;
+	const uint32_t maxStateStackSize = ctx->m_Config.m_MaxStateStackSize;
+	BX_UNUSED(maxStateStackSize);
+	Path* path = tess->m_Path;
+	Stroker* stroker = tess->m_Stroker;
+
+	const uint8_t* cmd = cl->m_CommandBuffer;
+	const uint8_t* cmdListEnd = cl->m_CommandBuffer + cl->m_CommandBufferPos;
+	while (cmd < cmdListEnd) {
+		CommandType::Enum cmdType;
+		uint32_t cmdSize;
+		cmd = clReadCommandHeader(cmd, &cmdType, &cmdSize);
+
+		const uint8_t* nextCmd = cmd + cmdSize;
+
+		// Without a cache only the state changes and the child command lists matter.
+		if (!cache && cmdType >= CommandType::FirstPathCommand && cmdType <= CommandType::LastStrokerCommand) {
+			cmd = nextCmd;
+			continue;
+		}
+
+		State* state = &tess->m_StateStack[tess->m_StateStackTop];
+
+		switch (cmdType) {
+		case CommandType::BeginPath: {
+			pathReset(path, state->m_AvgScale, testTol);
+			strokerReset(stroker, state->m_AvgScale, testTol, fringeWidth);
+			tess->m_PathTransformed = false;
+		} break;
+		case CommandType::ClosePath: {
+			pathClose(path);
+		} break;
+		case CommandType::MoveTo: {
+			const float* coords = (float*)cmd;
+			pathMoveTo(path, coords[0], coords[1]);
+		} break;
+		case CommandType::LineTo: {
+			const float* coords = (float*)cmd;
+			pathLineTo(path, coords[0], coords[1]);
+		} break;
+		case CommandType::CubicTo: {
+			const float* coords = (float*)cmd;
+			pathCubicTo(path, coords[0], coords[1], coords[2], coords[3], coords[4], coords[5]);
+		} break;
+		case CommandType::QuadraticTo: {
+			const float* coords = (float*)cmd;
+			pathQuadraticTo(path, coords[0], coords[1], coords[2], coords[3]);
+		} break;
+		case CommandType::Arc: {
+			const float* coords = (float*)cmd;
+			cmd += sizeof(float) * 5;
+			const Winding::Enum dir = CMD_READ(cmd, Winding::Enum);
+			pathArc(path, coords[0], coords[1], coords[2], coords[3], coords[4], dir);
+		} break;
+		case CommandType::ArcTo: {
+			const float* coords = (float*)cmd;
+			pathArcTo(path, coords[0], coords[1], coords[2], coords[3], coords[4]);
+		} break;
+		case CommandType::Rect: {
+			const float* coords = (float*)cmd;
+			pathRect(path, coords[0], coords[1], coords[2], coords[3]);
+		} break;
+		case CommandType::RoundedRect: {
+			const float* coords = (float*)cmd;
+			pathRoundedRect(path, coords[0], coords[1], coords[2], coords[3], coords[4]);
+		} break;
+		case CommandType::RoundedRectVarying: {
+			const float* coords = (float*)cmd;
+			pathRoundedRectVarying(path, coords[0], coords[1], coords[2], coords[3], coords[4], coords[5], coords[6], coords[7]);
+		} break;
+		case CommandType::Circle: {
+			const float* coords = (float*)cmd;
+			pathCircle(path, coords[0], coords[1], coords[2]);
+		} break;
+		case CommandType::Ellipse: {
+			const float* coords = (float*)cmd;
+			pathEllipse(path, coords[0], coords[1], coords[2], coords[3]);
+		} break;
+		case CommandType::Polyline: {
+			const uint32_t numPoints = CMD_READ(cmd, uint32_t);
+			const float* coords = (float*)cmd;
+			pathPolyline(path, coords, numPoints);
+		} break;
+#if VG_CONFIG_COMMAND_LIST_FIXED_POINT_BITS
+		case CommandType::MoveToFixed: {
+			float coords[2];
+			dequantizeCoords(coords, (const int16_t*)cmd, 2);
+			pathMoveTo(path, coords[0], coords[1]);
+		} break;
+		case CommandType::LineToFixed: {
+			float coords[2];
+			dequantizeCoords(coords, (const int16_t*)cmd, 2);
+			pathLineTo(path, coords[0], coords[1]);
+		} break;
+		case CommandType::CubicToFixed: {
+			float coords[6];
+			dequantizeCoords(coords, (const int16_t*)cmd, 6);
+			pathCubicTo(path, coords[0], coords[1], coords[2], coords[3], coords[4], coords[5]);
+		} break;
+		case CommandType::QuadraticToFixed: {
+			float coords[4];
+			dequantizeCoords(coords, (const int16_t*)cmd, 4);
+			pathQuadraticTo(path, coords[0], coords[1], coords[2], coords[3]);
+		} break;
+		case CommandType::PolylineFixed: {
+			uint32_t numPoints = CMD_READ(cmd, uint32_t);
+			const int16_t* fixedCoords = (const int16_t*)cmd;
+
+			float coords[128];
+			while (numPoints != 0) {
+				const uint32_t n = bx::min<uint32_t>(numPoints, 64);
+				dequantizeCoords(coords, fixedCoords, n * 2);
+				pathPolyline(path, coords, n);
+				fixedCoords += n * 2;
+				numPoints -= n;
+			}
+		} break;
+#endif
+		case CommandType::FillPathColor: {
+			const uint32_t flags = CMD_READ(cmd, uint32_t);
+			const Color color = CMD_READ(cmd, Color);
+
+			const bool recordClipCommands = tess->m_RecordClipCommands;
+			const Color col = recordClipCommands ? Colors::Black : color;
+			tessFillPath(ctx, tess, cache, flags, col, recordClipCommands ? false : VG_FILL_FLAGS_AA(flags));
+		} break;
+		case CommandType::FillPathGradient: {
+			const uint32_t flags = CMD_READ(cmd, uint32_t);
+			tessFillPath(ctx, tess, cache, flags, Colors::Black, VG_FILL_FLAGS_AA(flags));
+		} break;
+		case CommandType::FillPathImagePattern: {
+			const uint32_t flags = CMD_READ(cmd, uint32_t);
+			const Color color = CMD_READ(cmd, Color);
+			tessFillPath(ctx, tess, cache, flags, color, VG_FILL_FLAGS_AA(flags));
+		} break;
+		case CommandType::StrokePathColor: {
+			const float width = CMD_READ(cmd, float);
+			const uint32_t flags = CMD_READ(cmd, uint32_t);
+			const Color color = CMD_READ(cmd, Color);
+
+			float strokeWidth, alphaScale;
+			const bool isThin = calcStrokeParams(width, flags, state->m_AvgScale, fringeWidth, &strokeWidth, &alphaScale);
+
+			const bool recordClipCommands = tess->m_RecordClipCommands;
+			const Color col = recordClipCommands ? Colors::Black : colorSetAlpha(color, (uint8_t)(alphaScale * colorGetAlpha(color)));
+			tessStrokePath(ctx, tess, cache, flags, col, strokeWidth, isThin, recordClipCommands ? false : VG_STROKE_FLAGS_AA(flags));
+		} break;
+		case CommandType::StrokePathGradient: {
+			const float width = CMD_READ(cmd, float);
+			const uint32_t flags = CMD_READ(cmd, uint32_t);
+
+			float strokeWidth, alphaScale;
+			const bool isThin = calcStrokeParams(width, flags, state->m_AvgScale, fringeWidth, &strokeWidth, &alphaScale);
+			tessStrokePath(ctx, tess, cache, flags, Colors::Black, strokeWidth, isThin, VG_STROKE_FLAGS_AA(flags));
+		} break;
+		case CommandType::StrokePathImagePattern: {
+			const float width = CMD_READ(cmd, float);
+			const uint32_t flags = CMD_READ(cmd, uint32_t);
+			const Color color = CMD_READ(cmd, Color);
+
+			float strokeWidth, alphaScale;
+			const bool isThin = calcStrokeParams(width, flags, state->m_AvgScale, fringeWidth, &strokeWidth, &alphaScale);
+
+			const Color col = colorSetAlpha(color, (uint8_t)(alphaScale * colorGetAlpha(color)));
+			tessStrokePath(ctx, tess, cache, flags, col, strokeWidth, isThin, VG_STROKE_FLAGS_AA(flags));
+		} break;
+		case CommandType::BeginClip: {
+			tess->m_RecordClipCommands = true;
+		} break;
+		case CommandType::EndClip: {
+			tess->m_RecordClipCommands = false;
+		} break;
+		case CommandType::PushState: {
+			VG_CHECK(tess->m_StateStackTop < maxStateStackSize - 1, "State stack overflow");
+			bx::memCopy(state + 1, state, sizeof(State));
+			++tess->m_StateStackTop;
+		} break;
+		case CommandType::PopState: {
+			VG_CHECK(tess->m_StateStackTop > 0, "State stack underflow");
+			--tess->m_StateStackTop;
+		} break;
+		case CommandType::TransformIdentity: {
+			const float identity[6] = { 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f };
+			bx::memCopy(state->m_TransformMtx, identity, sizeof(float) * 6);
+			updateState(state);
+		} break;
+		case CommandType::TransformScale: {
+			const float* coords = (float*)cmd;
+			const float mtx[6] = { coords[0], 0.0f, 0.0f, coords[1], 0.0f, 0.0f };
+			float res[6];
+			vgutil::multiplyMatrix3(state->m_TransformMtx, mtx, res);
+			bx::memCopy(state->m_TransformMtx, res, sizeof(float) * 6);
+			updateState(state);
+		} break;
+		case CommandType::TransformTranslate: {
+			const float* coords = (float*)cmd;
+			const float mtx[6] = { 1.0f, 0.0f, 0.0f, 1.0f, coords[0], coords[1] };
+			float res[6];
+			vgutil::multiplyMatrix3(state->m_TransformMtx, mtx, res);
+			bx::memCopy(state->m_TransformMtx, res, sizeof(float) * 6);
+			updateState(state);
+		} break;
+		case CommandType::TransformRotate: {
+			const float ang_rad = CMD_READ(cmd, float);
+			const float c = bx::cos(ang_rad);
+			const float s = bx::sin(ang_rad);
+			const float mtx[6] = { c, s, -s, c, 0.0f, 0.0f };
+			float res[6];
+			vgutil::multiplyMatrix3(state->m_TransformMtx, mtx, res);
+			bx::memCopy(state->m_TransformMtx, res, sizeof(float) * 6);
+			updateState(state);
+		} break;
+		case CommandType::TransformMult: {
+			const float* mtx = (float*)cmd;
+			cmd += sizeof(float) * 6;
+			const TransformOrder::Enum order = CMD_READ(cmd, TransformOrder::Enum);
+
+			float res[6];
+			if (order == TransformOrder::Post) {
+				vgutil::multiplyMatrix3(state->m_TransformMtx, mtx, res);
+			} else {
+				vgutil::multiplyMatrix3(mtx, state->m_TransformMtx, res);
+			}
+			bx::memCopy(state->m_TransformMtx, res, sizeof(float) * 6);
+			updateState(state);
+		} break;
+		case CommandType::SetViewBox: {
+			const float* viewBox = (float*)cmd;
+			const float scaleX = (float)ctx->m_CanvasWidth / viewBox[2];
+			const float scaleY = (float)ctx->m_CanvasHeight / viewBox[3];
+			const float mtx[6] = { scaleX, 0.0f, 0.0f, scaleY, -scaleX * viewBox[0], -scaleY * viewBox[1] };
+			float res[6];
+			vgutil::multiplyMatrix3(state->m_TransformMtx, mtx, res);
+			bx::memCopy(state->m_TransformMtx, res, sizeof(float) * 6);
+			updateState(state);
+		} break;
+		case CommandType::SubmitCommandList: {
+			const uint16_t cmdListID = CMD_READ(cmd, uint16_t);
+			const CommandListHandle cmdListHandle = { cmdListID };
+
+			if (isCommandListHandleValid(ctx, cmdListHandle)) {
+				tessSubmitCommandList(ctx, tess, &ctx->m_CmdLists[cmdListID]);
+			}
+		} break;
+		default: {
+			// Commands which don't affect cached geometry (paints, scissor, text, etc.)
+		} break;
+		}
 
-	clCacheReset(ctx, cache);
-	bx::free(allocator, cache);
+		cmd = nextCmd;
+	}
 }
-#endif
 
-static uint8_t* clAllocCommand(Context* ctx, CommandList* cl, CommandType::Enum cmdType, uint32_t dataSize)
+// Tesselator version of submitCommandList(). Rebuilds the cache of the command list if its scale doesn't
+// match the current transform. Lists without a stale cache are still walked for their child lists and,
+// if VG_CONFIG_COMMAND_LIST_PRESERVE_STATE is 0, for the transforms they leave behind.
+static void tessSubmitCommandList(Context* ctx, Tesselator* tess, CommandList* cl)
 {
-	const uint32_t alignedDataSize = alignSize(dataSize, VG_CONFIG_COMMAND_LIST_ALIGNMENT);
-	const uint32_t totalSize = 0
-		+ kAlignedCommandHeaderSize
-		+ alignedDataSize;
-
-	const uint32_t pos = cl->m_CommandBufferPos;
-	VG_CHECK(isAligned(pos, VG_CONFIG_COMMAND_LIST_ALIGNMENT), "Unaligned command buffer position");
+	if (tess->m_SubmitCmdListRecursionDepth >= ctx->m_Config.m_MaxCommandListDepth) {
+		VG_CHECK(false, "SubmitCommandList recursion depth limit reached.");
+		return;
+	}
+	++tess->m_SubmitCmdListRecursionDepth;
 
-	if (pos + totalSize > cl->m_CommandBufferCapacity) {
-		const uint32_t capacityDelta = bx::max<uint32_t>(totalSize, 256);
-		cl->m_CommandBufferCapacity += capacityDelta;
-		cl->m_CommandBuffer = (uint8_t*)bx::alignedRealloc(ctx->m_Allocator, cl->m_CommandBuffer, cl->m_CommandBufferCapacity, VG_CONFIG_COMMAND_LIST_ALIGNMENT);
+	const State* state = &tess->m_StateStack[tess->m_StateStackTop];
+	const float stateScale = state->m_AvgScale;
 
-		ctx->m_Stats.m_CmdListMemoryTotal += capacityDelta;
+	CommandListCache* cache = clGetCache(ctx, cl);
+	if (cache && cache->m_AvgScale != stateScale) {
+		clCacheReset(ctx, cache);
+		cache->m_AvgScale = stateScale;
+		cache->m_LastUseFrame = ctx->m_FrameID;
+		cache->m_PendingStats.m_NumRebuilds++;
+	} else {
+		cache = nullptr;
 	}
 
-	uint8_t* ptr = &cl->m_CommandBuffer[pos];
-	cl->m_CommandBufferPos += totalSize;
-	ctx->m_Stats.m_CmdListMemoryUsed += totalSize;
+#if VG_CONFIG_COMMAND_LIST_PRESERVE_STATE
+	VG_CHECK(tess->m_StateStackTop < ctx->m_Config.m_MaxStateStackSize - 1, "State stack overflow");
+	bx::memCopy(&tess->m_StateStack[tess->m_StateStackTop + 1], state, sizeof(State));
+	++tess->m_StateStackTop;
+	const bool recordClipCommands = tess->m_RecordClipCommands;
+#endif
 
-	CommandHeader* hdr = (CommandHeader*)ptr;
-	ptr += kAlignedCommandHeaderSize;
+	clCacheBuild(ctx, tess, cl, cache);
 
-	hdr->m_Type = cmdType;
-	hdr->m_Size = alignedDataSize;
+#if VG_CONFIG_COMMAND_LIST_PRESERVE_STATE
+	--tess->m_StateStackTop;
+	tess->m_RecordClipCommands = recordClipCommands;
+#endif
 
-	return ptr;
+	--tess->m_SubmitCmdListRecursionDepth;
 }
 
-static uint32_t clStoreString(Context* ctx, CommandList* cl, const char* str, uint32_t len)
+static const float* tessTransformPath(Context* ctx, Tesselator* tess, CommandListCache* cache)
 {
-	if (cl->m_StringBufferPos + len > cl->m_StringBufferCapacity) {
-		cl->m_StringBufferCapacity += bx::max<uint32_t>(len, 128);
-		cl->m_StringBuffer = (char*)bx::realloc(ctx->m_Allocator, cl->m_StringBuffer, cl->m_StringBufferCapacity);
+	Path* path = tess->m_Path;
+	if (tess->m_PathTransformed) {
+		return tess->m_TransformedVertices;
 	}
 
-	const uint32_t offset = cl->m_StringBufferPos;
-	bx::memCopy(cl->m_StringBuffer + offset, str, len);
-	cl->m_StringBufferPos += len;
-	return offset;
-}
-
-#if VG_CONFIG_ENABLE_SHAPE_CACHING
-static CommandListCache* clGetCache(Context* ctx, CommandList* cl)
-{
-	if ((cl->m_Flags & CommandListFlags::Cacheable) == 0) {
-		return nullptr;
+	const uint32_t numPathVertices = pathGetNumVertices(path);
+	if (numPathVertices > tess->m_TransformedVertexCapacity) {
+		tess->m_TransformedVertices = (float*)bx::alignedRealloc(ctx->m_Allocator, tess->m_TransformedVertices, sizeof(float) * 2 * numPathVertices, 16);
+		tess->m_TransformedVertexCapacity = numPathVertices;
 	}
 
-	CommandListCache* cache = cl->m_Cache;
-	if (!cache) {
-		cache = allocCommandListCache(ctx);
-		cl->m_Cache = cache;
-	}
+	const State* state = &tess->m_StateStack[tess->m_StateStackTop];
+	vgutil::batchTransformPositions(pathGetVertices(path), numPathVertices, tess->m_TransformedVertices, state->m_TransformMtx);
+	tess->m_PathTransformed = true;
+	cache->m_PendingStats.m_NumFlattenedPaths++;
 
-	return cache;
+	return tess->m_TransformedVertices;
 }
 
-static void pushCommandListCache(Context* ctx, CommandListCache* cache)
+// userData of tessAddPathMesh()
+struct TessMeshTarget
 {
-	VG_CHECK(ctx->m_CmdListCacheStackTop + 1 < VG_CONFIG_COMMAND_LIST_CACHE_STACK_SIZE, "Command list cache stack overflow");
-	++ctx->m_CmdListCacheStackTop;
-	ctx->m_CmdListCacheStack[ctx->m_CmdListCacheStackTop] = cache;
-}
+	bx::AllocatorI* m_Allocator;
+	CommandListCache* m_Cache;
+};
 
-static void popCommandListCache(Context* ctx)
+static void tessFillPath(Context* ctx, Tesselator* tess, CommandListCache* cache, uint32_t flags, Color col, bool aa)
 {
-	VG_CHECK(ctx->m_CmdListCacheStackTop != ~0u, "Command list cache stack underflow");
-	--ctx->m_CmdListCacheStackTop;
-}
+#if VG_CONFIG_FORCE_AA_OFF
+	aa = false;
+#endif
 
-static CommandListCache* getCommandListCacheStackTop(Context* ctx)
-{
-	const uint32_t top = ctx->m_CmdListCacheStackTop;
-	return top == ~0u ? nullptr : ctx->m_CmdListCacheStack[top];
+	const float* pathVertices = tessTransformPath(ctx, tess, cache);
+	if (VG_FILL_FLAGS_PATH_TYPE(flags) == PathType::Concave) {
+		cache->m_PendingStats.m_NumConcaveFills++;
+	}
+
+	const State* state = &tess->m_StateStack[tess->m_StateStackTop];
+	cacheBeginCommand(ctx->m_Allocator, cache, state->m_TransformMtx);
+
+	TessMeshTarget target = { ctx->m_Allocator, cache };
+	meshFillPath(tess->m_Stroker, tess->m_Path, pathVertices, flags, col, aa, tessAddPathMesh, &target);
+
+	cacheEndCommand(cache);
 }
 
-static void beginCachedCommand(Context* ctx)
+static void tessStrokePath(Context* ctx, Tesselator* tess, CommandListCache* cache, uint32_t flags, Color col, float strokeWidth, bool isThin, bool aa)
 {
-	CommandListCache* cache = getCommandListCacheStackTop(ctx);
-	VG_CHECK(cache, "No bound CommandListCache");
+#if VG_CONFIG_FORCE_AA_OFF
+	aa = false;
+#endif
 
-	bx::AllocatorI* allocator = ctx->m_Allocator;
+	const float* pathVertices = tessTransformPath(ctx, tess, cache);
 
-	cache->m_NumCommands++;
-	cache->m_Commands = (CachedCommand*)bx::realloc(allocator, cache->m_Commands, sizeof(CachedCommand) * cache->m_NumCommands);
+	const State* state = &tess->m_StateStack[tess->m_StateStackTop];
+	cacheBeginCommand(ctx->m_Allocator, cache, state->m_TransformMtx);
 
-	CachedCommand* lastCmd = &cache->m_Commands[cache->m_NumCommands - 1];
-	lastCmd->m_FirstMeshID = (uint16_t)cache->m_NumMeshes;
-	lastCmd->m_NumMeshes = 0;
+	TessMeshTarget target = { ctx->m_Allocator, cache };
+	meshStrokePath(tess->m_Stroker, tess->m_Path, pathVertices, flags, col, strokeWidth, isThin, aa, tessAddPathMesh, &target);
 
-	const State* state = getState(ctx);
-	vgutil::invertMatrix3(state->m_TransformMtx, lastCmd->m_InvTransformMtx);
+	cacheEndCommand(cache);
 }
 
-static void endCachedCommand(Context* ctx)
+static void tessAddPathMesh(void* userData, const Mesh* mesh, const uint32_t* colors, uint32_t numColors)
 {
-	CommandListCache* cache = getCommandListCacheStackTop(ctx);
-	VG_CHECK(cache, "No bound CommandListCache");
-
-	VG_CHECK(cache->m_NumCommands != 0, "beginCachedCommand() hasn't been called");
-
-	CachedCommand* lastCmd = &cache->m_Commands[cache->m_NumCommands - 1];
-	VG_CHECK(lastCmd->m_NumMeshes == 0, "endCachedCommand() called too many times");
-	lastCmd->m_NumMeshes = (uint16_t)(cache->m_NumMeshes - lastCmd->m_FirstMeshID);
+	const TessMeshTarget* target = (const TessMeshTarget*)userData;
+	cacheAddMesh(target->m_Allocator, target->m_Cache, mesh->m_PosBuffer, mesh->m_NumVertices, colors, numColors, mesh->m_IndexBuffer, mesh->m_NumIndices);
 }
 
-static void addCachedCommand(Context* ctx, const float* pos, uint32_t numVertices, const uint32_t* colors, uint32_t numColors, const uint16_t* indices, uint32_t numIndices)
+// NOTE: Must be called from the thread which owns the context.
+static void clCacheMergeStats(Context* ctx, CommandListCache* cache)
 {
-	CommandListCache* cache = getCommandListCacheStackTop(ctx);
-	VG_CHECK(cache, "No bound CommandListCache");
-
-	bx::AllocatorI* allocator = ctx->m_Allocator;
-
-	cache->m_NumMeshes++;
-	cache->m_Meshes = (CachedMesh*)bx::realloc(allocator, cache->m_Meshes, sizeof(CachedMesh) * cache->m_NumMeshes);
-
-	CachedMesh* mesh = &cache->m_Meshes[cache->m_NumMeshes - 1];
-
-	const uint32_t totalMem = 0
-		+ alignSize(sizeof(float) * 2 * numVertices, 16)
-		+ ((numColors != 1) ? alignSize(sizeof(uint32_t) * numVertices, 16) : 0)
-		+ alignSize(sizeof(uint16_t) * numIndices, 16);
-
-	uint8_t* mem = (uint8_t*)bx::alignedAlloc(allocator, totalMem, 16);
-	mesh->m_Pos = (float*)mem;
-	mem += alignSize(sizeof(float) * 2 * numVertices, 16);
-	
-	const float* invMtx = cache->m_Commands[cache->m_NumCommands - 1].m_InvTransformMtx;
-	vgutil::batchTransformPositions(pos, numVertices, mesh->m_Pos, invMtx);
-	mesh->m_NumVertices = numVertices;
-
-	if (numColors == 1) {
-		mesh->m_Colors = nullptr;
-	} else {
-		VG_CHECK(numColors == numVertices, "Invalid number of colors");
-		mesh->m_Colors = (uint32_t*)mem;
-		mem += alignSize(sizeof(uint32_t) * numVertices, 16);
-
-		bx::memCopy(mesh->m_Colors, colors, sizeof(uint32_t) * numColors);
-	}
-
-	mesh->m_Indices = (uint16_t*)mem;
-	bx::memCopy(mesh->m_Indices, indices, sizeof(uint16_t) * numIndices);
-	mesh->m_NumIndices = numIndices;
+	CachedStats* pending = &cache->m_PendingStats;
+	Stats* stats = &ctx->m_Stats;
+	stats->m_NumCacheMisses += pending->m_NumRebuilds;
+	stats->m_NumFlattenedPaths += pending->m_NumFlattenedPaths;
+	stats->m_NumConcaveFills += pending->m_NumConcaveFills;
+	bx::memSet(pending, 0, sizeof(CachedStats));
 }
 
 // Walk the command list; avoid Path commands and use CachedMesh(es) on Stroker commands. 
@@ -5868,6 +8571,10 @@ static void clCacheRender(Context* ctx, CommandList* cl)
 	const char* stringBuffer = cl->m_StringBuffer;
 	CachedCommand* nextCachedCommand = &clCache->m_Commands[0];
 
+#if VG_CONFIG_STATIC_CACHED_GEOMETRY
+	clCacheUpload(ctx, clCache);
+#endif
+
 	bool skipCmds = false;
 
 #if VG_CONFIG_COMMAND_LIST_PRESERVE_STATE
@@ -5875,29 +8582,32 @@ static void clCacheRender(Context* ctx, CommandList* cl)
 #endif
 
 	while (cmd < cmdListEnd) {
-		const CommandHeader* cmdHeader = (CommandHeader*)cmd;
-		cmd += kAlignedCommandHeaderSize;
+		CommandType::Enum cmdType;
+		uint32_t cmdSize;
+		cmd = clReadCommandHeader(cmd, &cmdType, &cmdSize);
 
-		const uint8_t* nextCmd = cmd + cmdHeader->m_Size;
+		const uint8_t* nextCmd = cmd + cmdSize;
 
 		// Skip path commands.
-		if (cmdHeader->m_Type >= CommandType::FirstPathCommand && cmdHeader->m_Type <= CommandType::LastPathCommand) {
+		if (cmdType >= CommandType::FirstPathCommand && cmdType <= CommandType::LastPathCommand) {
 			cmd = nextCmd;
 			continue;
 		}
 
-		if (skipCmds && cmdHeader->m_Type >= CommandType::FirstStrokerCommand && cmdHeader->m_Type <= CommandType::LastStrokerCommand) {
+		if (skipCmds && cmdType >= CommandType::FirstStrokerCommand && cmdType <= CommandType::LastStrokerCommand) {
 			cmd = nextCmd;
 			++nextCachedCommand;
 			continue;
 		}
 
-		switch (cmdHeader->m_Type) {
+		switch (cmdType) {
 		case CommandType::FillPathColor: {
 			const uint32_t flags = CMD_READ(cmd, uint32_t);
 			const Color color = CMD_READ(cmd, Color);
 			BX_UNUSED(flags);
-			submitCachedMesh(ctx, color, &clCache->m_Meshes[nextCachedCommand->m_FirstMeshID], nextCachedCommand->m_NumMeshes);
+			if (!submitCachedCommand(ctx, clCache, nextCachedCommand, DrawCommand::Type::Textured, ctx->m_FontImages[0].idx)) {
+				submitCachedMesh(ctx, color, &clCache->m_Meshes[nextCachedCommand->m_FirstMeshID], nextCachedCommand->m_NumMeshes);
+			}
 			++nextCachedCommand;
 		} break;
 		case CommandType::FillPathGradient: {
@@ -5907,7 +8617,9 @@ static void clCacheRender(Context* ctx, CommandList* cl)
 			BX_UNUSED(flags);
 
 			const GradientHandle gradient = { isLocal(gradientFlags) ? (uint16_t)(gradientHandle + firstGradientID) : gradientHandle, 0 };
-			submitCachedMesh(ctx, gradient, &clCache->m_Meshes[nextCachedCommand->m_FirstMeshID], nextCachedCommand->m_NumMeshes);
+			if (!submitCachedCommand(ctx, clCache, nextCachedCommand, DrawCommand::Type::ColorGradient, gradient.idx)) {
+				submitCachedMesh(ctx, gradient, &clCache->m_Meshes[nextCachedCommand->m_FirstMeshID], nextCachedCommand->m_NumMeshes);
+			}
 			++nextCachedCommand;
 		} break;
 		case CommandType::FillPathImagePattern: {
@@ -5918,7 +8630,9 @@ static void clCacheRender(Context* ctx, CommandList* cl)
 			BX_UNUSED(flags);
 
 			const ImagePatternHandle imgPattern = { isLocal(imgPatternFlags) ? (uint16_t)(imgPatternHandle + firstImagePatternID) : imgPatternHandle, 0 };
-			submitCachedMesh(ctx, imgPattern, color, &clCache->m_Meshes[nextCachedCommand->m_FirstMeshID], nextCachedCommand->m_NumMeshes);
+			if (!submitCachedCommand(ctx, clCache, nextCachedCommand, DrawCommand::Type::ImagePattern, imgPattern.idx)) {
+				submitCachedMesh(ctx, imgPattern, color, &clCache->m_Meshes[nextCachedCommand->m_FirstMeshID], nextCachedCommand->m_NumMeshes);
+			}
 			++nextCachedCommand;
 		} break;
 		case CommandType::StrokePathColor: {
@@ -5927,7 +8641,9 @@ static void clCacheRender(Context* ctx, CommandList* cl)
 			const Color color = CMD_READ(cmd, Color);
 			BX_UNUSED(flags, width);
 
-			submitCachedMesh(ctx, color, &clCache->m_Meshes[nextCachedCommand->m_FirstMeshID], nextCachedCommand->m_NumMeshes);
+			if (!submitCachedCommand(ctx, clCache, nextCachedCommand, DrawCommand::Type::Textured, ctx->m_FontImages[0].idx)) {
+				submitCachedMesh(ctx, color, &clCache->m_Meshes[nextCachedCommand->m_FirstMeshID], nextCachedCommand->m_NumMeshes);
+			}
 			++nextCachedCommand;
 		} break;
 		case CommandType::StrokePathGradient: {
@@ -5938,7 +8654,9 @@ static void clCacheRender(Context* ctx, CommandList* cl)
 			BX_UNUSED(flags, width);
 
 			const GradientHandle gradient = { isLocal(gradientFlags) ? (uint16_t)(gradientHandle + firstGradientID) : gradientHandle, 0 };
-			submitCachedMesh(ctx, gradient, &clCache->m_Meshes[nextCachedCommand->m_FirstMeshID], nextCachedCommand->m_NumMeshes);
+			if (!submitCachedCommand(ctx, clCache, nextCachedCommand, DrawCommand::Type::ColorGradient, gradient.idx)) {
+				submitCachedMesh(ctx, gradient, &clCache->m_Meshes[nextCachedCommand->m_FirstMeshID], nextCachedCommand->m_NumMeshes);
+			}
 			++nextCachedCommand;
 		} break;
 		case CommandType::StrokePathImagePattern: {
@@ -5950,7 +8668,9 @@ static void clCacheRender(Context* ctx, CommandList* cl)
 			BX_UNUSED(flags, width);
 
 			const ImagePatternHandle imgPattern = { isLocal(imgPatternFlags) ? (uint16_t)(imgPatternHandle + firstImagePatternID) : imgPatternHandle, 0 };
-			submitCachedMesh(ctx, imgPattern, color, &clCache->m_Meshes[nextCachedCommand->m_FirstMeshID], nextCachedCommand->m_NumMeshes);
+			if (!submitCachedCommand(ctx, clCache, nextCachedCommand, DrawCommand::Type::ImagePattern, imgPattern.idx)) {
+				submitCachedMesh(ctx, imgPattern, color, &clCache->m_Meshes[nextCachedCommand->m_FirstMeshID], nextCachedCommand->m_NumMeshes);
+			}
 			++nextCachedCommand;
 		} break;
 		case CommandType::IndexedTriList: {
@@ -6123,15 +8843,99 @@ static void clCacheReset(Context* ctx, CommandListCache* cache)
 {
 	bx::AllocatorI* allocator = ctx->m_Allocator;
 
-	const uint32_t numMeshes = cache->m_NumMeshes;
-	for (uint32_t i = 0; i < numMeshes; ++i) {
-		CachedMesh* mesh = &cache->m_Meshes[i];
-		bx::alignedFree(allocator, mesh->m_Pos, 16);
-	}
-	bx::free(allocator, cache->m_Meshes);
-	bx::free(allocator, cache->m_Commands);
+	// Rewind the arena instead of freeing it. The mesh and command arrays keep their capacity, so
+	// rebuilding the cache (e.g. after a scale change) doesn't have to grow them again.
+	Arena arena = cache->m_Arena;
+	arenaReset(allocator, &arena);
+
+	const uint32_t meshCapacity = cache->m_MeshCapacity;
+	const uint32_t commandCapacity = cache->m_CommandCapacity;
+	const CachedStats pendingStats = cache->m_PendingStats;
+
+#if VG_CONFIG_STATIC_CACHED_GEOMETRY
+	// Keep the bgfx buffers around until the next clCacheUpload() because this might not be the context's thread.
+	const CachedGeometry geometry = cache->m_Geometry;
+#endif
 
 	bx::memSet(cache, 0, sizeof(CommandListCache));
+
+	cache->m_Arena = arena;
+	cache->m_MeshCapacity = meshCapacity;
+	cache->m_Meshes = (CachedMesh*)arenaAlloc(allocator, &cache->m_Arena, sizeof(CachedMesh) * meshCapacity);
+	cache->m_CommandCapacity = commandCapacity;
+	cache->m_Commands = (CachedCommand*)arenaAlloc(allocator, &cache->m_Arena, sizeof(CachedCommand) * commandCapacity);
+	cache->m_PendingStats = pendingStats;
+
+#if VG_CONFIG_STATIC_CACHED_GEOMETRY
+	cache->m_Geometry = geometry;
+	cache->m_Geometry.m_IsStale = true;
+#endif
+}
+
+// Frees all the memory of the cache. The command list is retesselated on its next submit.
+static void clCacheEvict(Context* ctx, CommandListCache* cache)
+{
+	arenaDestroy(ctx->m_Allocator, &cache->m_Arena);
+	cache->m_MeshCapacity = 0;
+	cache->m_CommandCapacity = 0;
+	clCacheReset(ctx, cache);
+#if VG_CONFIG_STATIC_CACHED_GEOMETRY
+	clCacheDestroyGeometry(ctx, cache);
+#endif
+}
+
+static uint32_t getCommandListCacheMemory(Context* ctx)
+{
+	const bx::HandleAlloc* handleAlloc = ctx->m_CmdListHandleAlloc;
+	const uint16_t* handles = handleAlloc->getHandles();
+	const uint32_t numHandles = handleAlloc->getNumHandles();
+
+	uint32_t totalMem = 0;
+	for (uint32_t i = 0; i < numHandles; ++i) {
+		const CommandListCache* cache = ctx->m_CmdLists[handles[i]].m_Cache;
+		if (cache) {
+			totalMem += cache->m_Arena.m_Size;
+		}
+	}
+
+	return totalMem;
+}
+
+// Evicts the least recently used caches until all of them fit in ContextConfig::m_CommandListCacheBudget.
+// Caches used during the previous frame are kept (even if the budget is exceeded) to avoid retesselating
+// the same command lists every frame.
+static void evictCommandListCaches(Context* ctx)
+{
+	const bx::HandleAlloc* handleAlloc = ctx->m_CmdListHandleAlloc;
+	const uint16_t* handles = handleAlloc->getHandles();
+	const uint32_t numHandles = handleAlloc->getNumHandles();
+	const uint32_t budget = ctx->m_Config.m_CommandListCacheBudget;
+	const uint32_t prevFrameID = ctx->m_FrameID;
+
+	uint32_t totalMem = getCommandListCacheMemory(ctx);
+	while (totalMem > budget) {
+		CommandListCache* lruCache = nullptr;
+		for (uint32_t i = 0; i < numHandles; ++i) {
+			CommandListCache* cache = ctx->m_CmdLists[handles[i]].m_Cache;
+			if (!cache || cache->m_Arena.m_Size == 0 || cache->m_LastUseFrame == prevFrameID) {
+				continue;
+			}
+
+			if (!lruCache || (int32_t)(cache->m_LastUseFrame - lruCache->m_LastUseFrame) < 0) {
+				lruCache = cache;
+			}
+		}
+
+		if (!lruCache) {
+			break;
+		}
+
+		const uint32_t cacheMem = lruCache->m_Arena.m_Size;
+		clCacheEvict(ctx, lruCache);
+
+		totalMem -= cacheMem;
+		ctx->m_CmdListCacheMemoryEvicted += cacheMem;
+	}
 }
 
 static void submitCachedMesh(Context* ctx, Color col, const CachedMesh* meshList, uint32_t numMeshes)
@@ -6209,31 +9013,228 @@ static void submitCachedMesh(Context* ctx, ImagePatternHandle imgPattern, Color
 		createDrawCommand_ImagePattern(ctx, imgPattern, transformedVertices, numVertices, colors, numColors, mesh->m_Indices, mesh->m_NumIndices);
 	}
 }
-#endif // VG_CONFIG_ENABLE_SHAPE_CACHING
 
-static void releaseVertexBufferDataCallback_Vec2(void* ptr, void* userData)
+// Emits a single draw command which references the static buffers of the cache (see clCacheUpload()),
+// transformed by the current transform on the GPU. Returns false if the cached command should be
+// submitted through submitCachedMesh() instead.
+static bool submitCachedCommand(Context* ctx, const CommandListCache* cache, const CachedCommand* cachedCmd, DrawCommand::Type::Enum type, uint16_t handle)
+{
+#if VG_CONFIG_STATIC_CACHED_GEOMETRY
+	const CachedGeometry* geometry = &cache->m_Geometry;
+	if (ctx->m_RecordClipCommands || geometry->m_IsStale) {
+		return false;
+	}
+
+	if (cachedCmd->m_NumIndices == 0) {
+		return true;
+	}
+
+	VG_CHECK(handle != UINT16_MAX, "Invalid draw command handle");
+
+	if (ctx->m_NumDrawCommands == ctx->m_DrawCommandCapacity) {
+		growDrawCommandArray(ctx, &ctx->m_DrawCommands, &ctx->m_DrawCommandCapacity);
+	}
+
+	DrawCommand* cmd = &ctx->m_DrawCommands[ctx->m_NumDrawCommands];
+	ctx->m_NumDrawCommands++;
+
+	const State* state = getState(ctx);
+	const float* scissor = state->m_ScissorRect;
+
+	cmd->m_VertexBufferID = ctx->m_NumVertexBuffers - 1;
+	cmd->m_FirstVertexID = cachedCmd->m_FirstVertexID;
+	cmd->m_FirstIndexID = cachedCmd->m_FirstIndexID;
+	cmd->m_NumVertices = cachedCmd->m_NumVertices;
+	cmd->m_NumIndices = cachedCmd->m_NumIndices;
+	cmd->m_Type = type;
+	cmd->m_HandleID = handle;
+	cmd->m_ScissorRect[0] = (uint16_t)scissor[0];
+	cmd->m_ScissorRect[1] = (uint16_t)scissor[1];
+	cmd->m_ScissorRect[2] = (uint16_t)scissor[2];
+	cmd->m_ScissorRect[3] = (uint16_t)scissor[3];
+	bx::memCopy(&cmd->m_ClipState, &ctx->m_ClipState, sizeof(ClipState));
+	cmd->m_StaticPosBufferHandle = geometry->m_PosBufferHandle;
+	cmd->m_StaticUVBufferHandle = geometry->m_UVBufferHandle;
+	cmd->m_StaticColorBufferHandle = geometry->m_ColorBufferHandle;
+	cmd->m_StaticIndexBufferHandle = geometry->m_IndexBufferHandle;
+	bx::memCopy(cmd->m_TransformMtx, state->m_TransformMtx, sizeof(float) * 6);
+
+	// Nothing can be appended to this draw command.
+	ctx->m_ForceNewDrawCommand = true;
+
+	return true;
+#else
+	BX_UNUSED(ctx, cache, cachedCmd, type, handle);
+	return false;
+#endif
+}
+
+#if VG_CONFIG_STATIC_CACHED_GEOMETRY
+// Queues the static buffers of the cache for destruction (see destroyStaleCachedGeometry()).
+static void clCacheDestroyGeometry(Context* ctx, CommandListCache* cache)
 {
-	Context* ctx = (Context*)userData;
-	releaseVertexBufferData_Vec2(ctx, (float*)ptr);
+	CachedGeometry* geometry = &cache->m_Geometry;
+	if (bgfx::isValid(geometry->m_IndexBufferHandle)) {
+		if (ctx->m_NumStaleGeometry == ctx->m_StaleGeometryCapacity) {
+			ctx->m_StaleGeometryCapacity += 8;
+			ctx->m_StaleGeometry = (CachedGeometry*)bx::realloc(ctx->m_Allocator, ctx->m_StaleGeometry, sizeof(CachedGeometry) * ctx->m_StaleGeometryCapacity);
+		}
+
+		ctx->m_StaleGeometry[ctx->m_NumStaleGeometry++] = *geometry;
+	}
+
+	geometry->m_PosBufferHandle = BGFX_INVALID_HANDLE;
+	geometry->m_UVBufferHandle = BGFX_INVALID_HANDLE;
+	geometry->m_ColorBufferHandle = BGFX_INVALID_HANDLE;
+	geometry->m_IndexBufferHandle = BGFX_INVALID_HANDLE;
+	geometry->m_NumVertices = 0;
+	geometry->m_IsStale = true;
 }
 
-static void releaseVertexBufferDataCallback_Uint32(void* ptr, void* userData)
+static void destroyStaleCachedGeometry(Context* ctx)
 {
-	Context* ctx = (Context*)userData;
-	releaseVertexBufferData_Uint32(ctx, (uint32_t*)ptr);
+	const uint32_t numStaleGeometry = ctx->m_NumStaleGeometry;
+	for (uint32_t i = 0; i < numStaleGeometry; ++i) {
+		const CachedGeometry* geometry = &ctx->m_StaleGeometry[i];
+		bgfx::destroy(geometry->m_PosBufferHandle);
+		bgfx::destroy(geometry->m_UVBufferHandle);
+		bgfx::destroy(geometry->m_ColorBufferHandle);
+		bgfx::destroy(geometry->m_IndexBufferHandle);
+	}
+	ctx->m_NumStaleGeometry = 0;
 }
 
+static bgfx::VertexBufferHandle createCachedGeometryUVBuffer(Context* ctx, uint32_t numVertices)
+{
+	const uv_t* uv = getWhitePixelUV(ctx);
+
+	const bgfx::Memory* uvMem = bgfx::alloc(sizeof(uv_t) * 2 * numVertices);
 #if VG_CONFIG_UV_INT16
-static void releaseVertexBufferDataCallback_UV(void* ptr, void* userData)
+	vgutil::memset32(uvMem->data, numVertices, &uv[0]);
+#else
+	vgutil::memset64(uvMem->data, numVertices, &uv[0]);
+#endif
+
+	return bgfx::createVertexBuffer(uvMem, ctx->m_UVVertexDecl);
+}
+
+// Uploads all cached meshes into static bgfx buffers, if they haven't been uploaded since the last
+// clCacheReset(). The buffers are also recreated when the font atlas white pixel UV changes, since
+// color fills/strokes sample it through the UV buffer.
+static void clCacheUpload(Context* ctx, CommandListCache* cache)
+{
+	CachedGeometry* geometry = &cache->m_Geometry;
+	const uv_t* whitePixelUV = getWhitePixelUV(ctx);
+
+	if (!geometry->m_IsStale) {
+		if (geometry->m_NumVertices == 0 || !bx::memCmp(geometry->m_WhitePixelUV, whitePixelUV, sizeof(uv_t) * 2)) {
+			return;
+		}
+	}
+
+	clCacheDestroyGeometry(ctx, cache);
+
+	uint32_t totalVertices = 0;
+	uint32_t totalIndices = 0;
+	const uint32_t numMeshes = cache->m_NumMeshes;
+	for (uint32_t i = 0; i < numMeshes; ++i) {
+		totalVertices += cache->m_Meshes[i].m_NumVertices;
+		totalIndices += cache->m_Meshes[i].m_NumIndices;
+	}
+
+	const uint32_t numCommands = cache->m_NumCommands;
+	if (totalIndices == 0) {
+		for (uint32_t i = 0; i < numCommands; ++i) {
+			CachedCommand* cachedCmd = &cache->m_Commands[i];
+			cachedCmd->m_FirstVertexID = cachedCmd->m_NumVertices = 0;
+			cachedCmd->m_FirstIndexID = cachedCmd->m_NumIndices = 0;
+		}
+		geometry->m_IsStale = false;
+		return;
+	}
+
+	const bgfx::Memory* posMem = bgfx::alloc(sizeof(float) * 2 * totalVertices);
+	const bgfx::Memory* colorMem = bgfx::alloc(sizeof(uint32_t) * totalVertices);
+	const bgfx::Memory* indexMem = bgfx::alloc(sizeof(uint32_t) * totalIndices);
+	float* dstPos = (float*)posMem->data;
+	uint32_t* dstColor = (uint32_t*)colorMem->data;
+	uint32_t* dstIndex = (uint32_t*)indexMem->data;
+
+	// NOTE: Indices are relative to the first vertex of each cached command (bgfx uses the start vertex
+	// of the draw call as the base vertex), so they are 32-bit only because a command can have more
+	// than 65536 vertices in total.
+	uint32_t nextVertexID = 0;
+	uint32_t nextIndexID = 0;
+	for (uint32_t iCmd = 0; iCmd < numCommands; ++iCmd) {
+		CachedCommand* cachedCmd = &cache->m_Commands[iCmd];
+		cachedCmd->m_FirstVertexID = nextVertexID;
+		cachedCmd->m_FirstIndexID = nextIndexID;
+
+		const uint32_t lastMeshID = cachedCmd->m_FirstMeshID + cachedCmd->m_NumMeshes;
+		for (uint32_t iMesh = cachedCmd->m_FirstMeshID; iMesh < lastMeshID; ++iMesh) {
+			const CachedMesh* mesh = &cache->m_Meshes[iMesh];
+			const uint32_t numVertices = mesh->m_NumVertices;
+			const uint32_t numIndices = mesh->m_NumIndices;
+
+			bx::memCopy(&dstPos[nextVertexID << 1], mesh->m_Pos, sizeof(float) * 2 * numVertices);
+			if (mesh->m_Colors) {
+				bx::memCopy(&dstColor[nextVertexID], mesh->m_Colors, sizeof(uint32_t) * numVertices);
+			} else {
+				vgutil::memset32(&dstColor[nextVertexID], numVertices, &mesh->m_Color);
+			}
+
+			vgutil::batchTransformDrawIndices(mesh->m_Indices, numIndices, &dstIndex[nextIndexID], nextVertexID - cachedCmd->m_FirstVertexID);
+
+			nextVertexID += numVertices;
+			nextIndexID += numIndices;
+		}
+
+		cachedCmd->m_NumVertices = nextVertexID - cachedCmd->m_FirstVertexID;
+		cachedCmd->m_NumIndices = nextIndexID - cachedCmd->m_FirstIndexID;
+	}
+	VG_CHECK(nextVertexID == totalVertices && nextIndexID == totalIndices, "Cached geometry size mismatch");
+
+	geometry->m_PosBufferHandle = bgfx::createVertexBuffer(posMem, ctx->m_PosVertexDecl);
+	geometry->m_ColorBufferHandle = bgfx::createVertexBuffer(colorMem, ctx->m_ColorVertexDecl);
+	geometry->m_UVBufferHandle = createCachedGeometryUVBuffer(ctx, totalVertices);
+	geometry->m_IndexBufferHandle = bgfx::createIndexBuffer(indexMem, BGFX_BUFFER_INDEX32);
+	bx::memCopy(geometry->m_WhitePixelUV, whitePixelUV, sizeof(uv_t) * 2);
+	geometry->m_NumVertices = totalVertices;
+	geometry->m_IsStale = false;
+}
+
+// u_paintMat is applied to the untransformed vertex positions of static draw commands, so the paint
+// matrix (which maps canvas space to paint space) is concatenated with the model matrix.
+static void calcStaticPaintMatrix(const float* paintMtx, const float* modelMtx, float* res)
 {
-	Context* ctx = (Context*)userData;
-	releaseVertexBufferData_UV(ctx, (int16_t*)ptr);
+	const float paint[6] = { paintMtx[0], paintMtx[1], paintMtx[3], paintMtx[4], paintMtx[6], paintMtx[7] };
+
+	float mtx[6];
+	vgutil::multiplyMatrix3(paint, modelMtx, mtx);
+
+	res[0] = mtx[0];
+	res[1] = mtx[1];
+	res[2] = 0.0f;
+	res[3] = mtx[2];
+	res[4] = mtx[3];
+	res[5] = 0.0f;
+	res[6] = mtx[4];
+	res[7] = mtx[5];
+	res[8] = 1.0f;
 }
 #endif
+#endif // VG_CONFIG_ENABLE_SHAPE_CACHING
+
+static void releaseVertexBufferDataCallback(void* ptr, void* userData)
+{
+	DataPool* pool = (DataPool*)userData;
+	dataPoolRelease(pool, ptr);
+}
 
 static void releaseIndexBufferCallback(void* ptr, void* userData)
 {
-	Context* ctx = (Context*)userData;
-	releaseIndexBuffer(ctx, (uint16_t*)ptr);
+	BX_UNUSED(ptr);
+	IndexBufferNode* node = (IndexBufferNode*)userData;
+	releaseIndexBuffer(node->m_Context, node);
 }
 }
@@ -0,0 +1,570 @@
+#include "vg_raster.h"
+
+#if VG_CONFIG_SOFTWARE_RASTERIZER
+#include <bx/allocator.h>
+#include <bx/semaphore.h>
+#include <bx/thread.h>
+#include <bgfx/bgfx.h>
+#if VG_CONFIG_ENABLE_SIMD && BX_CPU_X86
+#include <xmmintrin.h>
+#endif
+
+// Height (in pixels) of the rows of the raster target which are distributed to the
+// rasterizer threads (see rasterizerSetTarget())
+#define VG_CONFIG_RASTERIZER_TILE_HEIGHT 32
+
+namespace vg
+{
+struct RasterWorker
+{
+	Rasterizer* m_Rasterizer;
+	uint32_t m_ID;
+	bx::Thread* m_Thread;
+};
+
+struct Rasterizer
+{
+	bx::AllocatorI* m_Allocator;
+	RasterTarget m_Target;
+	uint8_t* m_Stencil;
+	uint32_t m_StencilCapacity;
+	RasterWorker* m_Workers;
+	uint32_t m_NumWorkers;
+	bx::Semaphore* m_StartSem;
+	bx::Semaphore* m_DoneSem;
+	bool m_Quit;
+
+	// Valid during rasterizerDrawCommands()
+	const RasterDrawCommand* m_DrawCommands;
+	const RasterDrawCommand* m_ClipCommands;
+	uint32_t m_NumDrawCommands;
+	float m_DevicePixelRatio;
+};
+
+struct RasterVertex
+{
+	float m_Pos[2];    // Device pixels
+	float m_UV[2];
+	float m_Color[4];
+};
+
+static void rasterDestroyWorkers(Rasterizer* rast);
+static int32_t rasterWorkerThread(bx::Thread* thread, void* userData);
+static void rasterizeTiles(Rasterizer* rast, uint32_t threadID);
+static void rasterizeTile(Rasterizer* rast, uint32_t y0, uint32_t y1);
+static void rasterizeDrawCommand(Rasterizer* rast, const RasterDrawCommand* cmd, const RasterPaint* paint, uint8_t stencilValue, uint8_t stencilTest, uint32_t y0, uint32_t y1);
+static void rasterizeTriangle(Rasterizer* rast, const RasterVertex* vertices, const RasterPaint* paint, uint8_t stencilValue, uint8_t stencilTest, const int32_t* rect);
+
+Rasterizer* createRasterizer(bx::AllocatorI* allocator)
+{
+	Rasterizer* rast = (Rasterizer*)bx::alloc(allocator, sizeof(Rasterizer));
+	bx::memSet(rast, 0, sizeof(Rasterizer));
+	rast->m_Allocator = allocator;
+
+	return rast;
+}
+
+void destroyRasterizer(Rasterizer* rast)
+{
+	bx::AllocatorI* allocator = rast->m_Allocator;
+
+	rasterDestroyWorkers(rast);
+	bx::free(allocator, rast->m_Stencil);
+	bx::free(allocator, rast);
+}
+
+void rasterizerSetTarget(Rasterizer* rast, const RasterTarget* target, uint32_t numThreads)
+{
+	bx::AllocatorI* allocator = rast->m_Allocator;
+
+	bx::memCopy(&rast->m_Target, target, sizeof(RasterTarget));
+
+	const uint32_t numPixels = (uint32_t)target->m_Width * (uint32_t)target->m_Height;
+	if (numPixels > rast->m_StencilCapacity) {
+		rast->m_StencilCapacity = numPixels;
+		rast->m_Stencil = (uint8_t*)bx::realloc(allocator, rast->m_Stencil, numPixels);
+	}
+
+	const uint32_t numWorkers = numThreads > 1 ? numThreads - 1 : 0;
+	if (numWorkers == rast->m_NumWorkers) {
+		return;
+	}
+
+	rasterDestroyWorkers(rast);
+
+	if (numWorkers != 0) {
+		rast->m_StartSem = BX_NEW(allocator, bx::Semaphore)();
+		rast->m_DoneSem = BX_NEW(allocator, bx::Semaphore)();
+		rast->m_Workers = (RasterWorker*)bx::alloc(allocator, sizeof(RasterWorker) * numWorkers);
+		rast->m_NumWorkers = numWorkers;
+		rast->m_Quit = false;
+
+		for (uint32_t i = 0; i < numWorkers; ++i) {
+			RasterWorker* worker = &rast->m_Workers[i];
+			worker->m_Rasterizer = rast;
+			worker->m_ID = i + 1;
+			worker->m_Thread = BX_NEW(allocator, bx::Thread)();
+			worker->m_Thread->init(rasterWorkerThread, worker, 0, "vg::rasterizer");
+		}
+	}
+}
+
+// The target is split into rows of VG_CONFIG_RASTERIZER_TILE_HEIGHT pixels which are distributed round-robin
+// between the calling thread and the worker threads. Each tile executes all draw commands in order, so no
+// synchronization is needed.
+void rasterizerDrawCommands(Rasterizer* rast, const RasterDrawCommand* cmds, uint32_t numCmds, const RasterDrawCommand* clipCmds, float devicePixelRatio)
+{
+	rast->m_DrawCommands = cmds;
+	rast->m_ClipCommands = clipCmds;
+	rast->m_NumDrawCommands = numCmds;
+	rast->m_DevicePixelRatio = devicePixelRatio;
+
+	const uint32_t numWorkers = rast->m_NumWorkers;
+	if (numWorkers != 0) {
+		rast->m_StartSem->post(numWorkers);
+	}
+
+	rasterizeTiles(rast, 0);
+
+	for (uint32_t i = 0; i < numWorkers; ++i) {
+		rast->m_DoneSem->wait();
+	}
+
+	rast->m_DrawCommands = nullptr;
+	rast->m_ClipCommands = nullptr;
+	rast->m_NumDrawCommands = 0;
+}
+
+static void rasterDestroyWorkers(Rasterizer* rast)
+{
+	const uint32_t numWorkers = rast->m_NumWorkers;
+	if (numWorkers == 0) {
+		return;
+	}
+
+	bx::AllocatorI* allocator = rast->m_Allocator;
+
+	rast->m_Quit = true;
+	rast->m_StartSem->post(numWorkers);
+	for (uint32_t i = 0; i < numWorkers; ++i) {
+		RasterWorker* worker = &rast->m_Workers[i];
+		worker->m_Thread->shutdown();
+		bx::deleteObject(allocator, worker->m_Thread);
+	}
+
+	bx::free(allocator, rast->m_Workers);
+	bx::deleteObject(allocator, rast->m_StartSem);
+	bx::deleteObject(allocator, rast->m_DoneSem);
+	rast->m_Workers = nullptr;
+	rast->m_StartSem = nullptr;
+	rast->m_DoneSem = nullptr;
+	rast->m_NumWorkers = 0;
+}
+
+static int32_t rasterWorkerThread(bx::Thread* thread, void* userData)
+{
+	BX_UNUSED(thread);
+
+	RasterWorker* worker = (RasterWorker*)userData;
+	Rasterizer* rast = worker->m_Rasterizer;
+	for (;;) {
+		rast->m_StartSem->wait();
+		if (rast->m_Quit) {
+			break;
+		}
+
+		rasterizeTiles(rast, worker->m_ID);
+		rast->m_DoneSem->post();
+	}
+
+	return 0;
+}
+
+static void rasterizeTiles(Rasterizer* rast, uint32_t threadID)
+{
+	const uint32_t numThreads = rast->m_NumWorkers + 1;
+	const uint32_t height = rast->m_Target.m_Height;
+
+	for (uint32_t y0 = threadID * VG_CONFIG_RASTERIZER_TILE_HEIGHT; y0 < height; y0 += numThreads * VG_CONFIG_RASTERIZER_TILE_HEIGHT) {
+		rasterizeTile(rast, y0, bx::min<uint32_t>(y0 + VG_CONFIG_RASTERIZER_TILE_HEIGHT, height));
+	}
+}
+
+static void rasterizeTile(Rasterizer* rast, uint32_t y0, uint32_t y1)
+{
+	const uint32_t width = rast->m_Target.m_Width;
+	uint8_t* stencil = rast->m_Stencil;
+	bx::memSet(&stencil[y0 * width], 0, (y1 - y0) * width);
+
+	RasterPaint clipPaint;
+	bx::memSet(&clipPaint, 0, sizeof(RasterPaint));
+	clipPaint.m_Type = RasterPaint::Type::Clip;
+
+	const uint32_t numDrawCommands = rast->m_NumDrawCommands;
+	uint32_t prevClipCmdID = UINT32_MAX;
+	uint8_t stencilTest = 0; // 0 => none, 1 => equal, 2 => not equal
+	for (uint32_t iCmd = 0; iCmd < numDrawCommands; ++iCmd) {
+		const RasterDrawCommand* cmd = &rast->m_DrawCommands[iCmd];
+
+		if (cmd->m_FirstClipCmdID != prevClipCmdID) {
+			prevClipCmdID = cmd->m_FirstClipCmdID;
+
+			const uint8_t stencilValue = cmd->m_StencilValue;
+			if (stencilValue != 0) {
+				if ((cmd->m_StencilFlags & RasterDrawCommand::StencilFlags::Clear) != 0) {
+					bx::memSet(&stencil[y0 * width], 0, (y1 - y0) * width);
+				}
+
+				if ((cmd->m_StencilFlags & RasterDrawCommand::StencilFlags::WriteClipMask) != 0) {
+					const uint32_t numClipCommands = cmd->m_NumClipCmds;
+					for (uint32_t iClip = 0; iClip < numClipCommands; ++iClip) {
+						rasterizeDrawCommand(rast, &rast->m_ClipCommands[cmd->m_FirstClipCmdID + iClip], &clipPaint, stencilValue, 0, y0, y1);
+					}
+				}
+
+				stencilTest = cmd->m_ClipRule == ClipRule::In ? 1 : 2;
+			} else {
+				stencilTest = 0;
+			}
+		}
+
+		rasterizeDrawCommand(rast, cmd, &cmd->m_Paint, cmd->m_StencilValue, stencilTest, y0, y1);
+	}
+}
+
+static inline int32_t rasterWrapCoord(int32_t i, uint32_t size, bool clamp)
+{
+	if (clamp) {
+		return bx::clamp<int32_t>(i, 0, (int32_t)size - 1);
+	}
+
+	const int32_t m = i % (int32_t)size;
+	return m < 0 ? m + (int32_t)size : m;
+}
+
+static inline void rasterFetchTexel(const RasterImage* img, int32_t x, int32_t y, float* texel)
+{
+	const uint8_t* c = (const uint8_t*)&img->m_Data[y * img->m_Width + x];
+	texel[0] = c[0] * (1.0f / 255.0f);
+	texel[1] = c[1] * (1.0f / 255.0f);
+	texel[2] = c[2] * (1.0f / 255.0f);
+	texel[3] = c[3] * (1.0f / 255.0f);
+}
+
+// Same filtering and addressing as the bgfx sampler flags of the image.
+static void rasterSampleImage(const RasterImage* img, float u, float v, float* texel)
+{
+	if (!img->m_Data) {
+		texel[0] = texel[1] = texel[2] = texel[3] = 1.0f;
+		return;
+	}
+
+	const uint32_t w = img->m_Width;
+	const uint32_t h = img->m_Height;
+	const bool clampU = (img->m_Flags & BGFX_SAMPLER_U_CLAMP) != 0;
+	const bool clampV = (img->m_Flags & BGFX_SAMPLER_V_CLAMP) != 0;
+
+	if ((img->m_Flags & BGFX_SAMPLER_MAG_POINT) != 0) {
+		const int32_t x = rasterWrapCoord((int32_t)bx::floor(u * (float)w), w, clampU);
+		const int32_t y = rasterWrapCoord((int32_t)bx::floor(v * (float)h), h, clampV);
+		rasterFetchTexel(img, x, y, texel);
+		return;
+	}
+
+	const float fx = u * (float)w - 0.5f;
+	const float fy = v * (float)h - 0.5f;
+	const float x0f = bx::floor(fx);
+	const float y0f = bx::floor(fy);
+	const float tx = fx - x0f;
+	const float ty = fy - y0f;
+
+	const int32_t x0 = rasterWrapCoord((int32_t)x0f, w, clampU);
+	const int32_t x1 = rasterWrapCoord((int32_t)x0f + 1, w, clampU);
+	const int32_t y0 = rasterWrapCoord((int32_t)y0f, h, clampV);
+	const int32_t y1 = rasterWrapCoord((int32_t)y0f + 1, h, clampV);
+
+	float t00[4], t10[4], t01[4], t11[4];
+	rasterFetchTexel(img, x0, y0, t00);
+	rasterFetchTexel(img, x1, y0, t10);
+	rasterFetchTexel(img, x0, y1, t01);
+	rasterFetchTexel(img, x1, y1, t11);
+
+	for (uint32_t i = 0; i < 4; ++i) {
+		const float top = bx::lerp(t00[i], t10[i], tx);
+		const float bottom = bx::lerp(t01[i], t11[i], tx);
+		texel[i] = bx::lerp(top, bottom, ty);
+	}
+}
+
+// fs_color_gradient.sc
+static void rasterShadeGradient(const RasterPaint* paint, float px, float py, float* color)
+{
+	const float* params = paint->m_GradientParams;
+	const float extX = params[0];
+	const float extY = params[1];
+	const float radius = params[2];
+	const float feather = params[3];
+
+	const float dx = bx::abs(px) - (extX - radius);
+	const float dy = bx::abs(py) - (extY - radius);
+	const float mx = bx::max<float>(dx, 0.0f);
+	const float my = bx::max<float>(dy, 0.0f);
+	const float sd = bx::min<float>(bx::max<float>(dx, dy), 0.0f) + bx::sqrt(mx * mx + my * my) - radius;
+	const float d = bx::clamp<float>((sd + feather * 0.5f) / feather, 0.0f, 1.0f);
+
+	for (uint32_t i = 0; i < 4; ++i) {
+		color[i] = bx::lerp(paint->m_InnerColor[i], paint->m_OuterColor[i], d);
+	}
+}
+
+static inline void rasterModulate(const float* color, const float* texel, float* res)
+{
+#if VG_CONFIG_ENABLE_SIMD && BX_CPU_X86
+	_mm_storeu_ps(res, _mm_mul_ps(_mm_loadu_ps(color), _mm_loadu_ps(texel)));
+#else
+	res[0] = color[0] * texel[0];
+	res[1] = color[1] * texel[1];
+	res[2] = color[2] * texel[2];
+	res[3] = color[3] * texel[3];
+#endif
+}
+
+// Evaluates the program of the paint for one pixel. pos is the pixel center in canvas coordinates, uv
+// and color are the interpolated vertex attributes.
+static void rasterShadePixel(const RasterPaint* paint, const float* pos, const float* uv, const float* color, float* res)
+{
+	switch (paint->m_Type) {
+	case RasterPaint::Type::Textured: {
+		float texel[4];
+		rasterSampleImage(&paint->m_Image, uv[0], uv[1], texel);
+		rasterModulate(color, texel, res);
+	} break;
+	case RasterPaint::Type::ColorGradient: {
+		const float* m = paint->m_PaintMtx;
+		rasterShadeGradient(paint, m[0] * pos[0] + m[3] * pos[1] + m[6], m[1] * pos[0] + m[4] * pos[1] + m[7], res);
+		res[3] *= color[3];
+	} break;
+	case RasterPaint::Type::ImagePattern: {
+		const float* m = paint->m_PaintMtx;
+		float texel[4];
+		rasterSampleImage(&paint->m_Image, m[0] * pos[0] + m[3] * pos[1] + m[6], m[1] * pos[0] + m[4] * pos[1] + m[7], texel);
+		rasterModulate(color, texel, res);
+	} break;
+	default:
+		VG_CHECK(false, "Unknown paint type");
+		break;
+	}
+}
+
+// BGFX_STATE_BLEND_FUNC_SEPARATE(SRC_ALPHA, INV_SRC_ALPHA, ONE, INV_SRC_ALPHA)
+static inline void rasterBlendPixel(uint8_t* dst, const float* src)
+{
+#if VG_CONFIG_ENABLE_SIMD && BX_CPU_X86
+	// All 4 channels at once. Same operations (and rounding) as the scalar version.
+	const float sa = bx::clamp<float>(src[3], 0.0f, 1.0f);
+	const __m128 srcClamped = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src), _mm_setzero_ps()), _mm_set1_ps(1.0f));
+	const __m128 srcFactor = _mm_setr_ps(sa, sa, sa, 1.0f);
+	const __m128 dstColor = _mm_setr_ps((float)dst[0], (float)dst[1], (float)dst[2], (float)dst[3]);
+	const __m128 c = _mm_add_ps(_mm_mul_ps(srcClamped, srcFactor), _mm_mul_ps(_mm_mul_ps(dstColor, _mm_set1_ps(1.0f / 255.0f)), _mm_set1_ps(1.0f - sa)));
+
+	float res[4];
+	_mm_storeu_ps(res, _mm_add_ps(_mm_mul_ps(c, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+	dst[0] = (uint8_t)res[0];
+	dst[1] = (uint8_t)res[1];
+	dst[2] = (uint8_t)res[2];
+	dst[3] = (uint8_t)res[3];
+#else
+	const float sa = bx::clamp<float>(src[3], 0.0f, 1.0f);
+	const float invSA = 1.0f - sa;
+	for (uint32_t i = 0; i < 3; ++i) {
+		const float c = bx::clamp<float>(src[i], 0.0f, 1.0f) * sa + dst[i] * (1.0f / 255.0f) * invSA;
+		dst[i] = (uint8_t)(c * 255.0f + 0.5f);
+	}
+
+	const float a = sa + dst[3] * (1.0f / 255.0f) * invSA;
+	dst[3] = (uint8_t)(a * 255.0f + 0.5f);
+#endif
+}
+
+static void rasterLoadVertex(const RasterDrawCommand* cmd, uint32_t vertexID, float dpr, RasterVertex* v)
+{
+	v->m_Pos[0] = cmd->m_Pos[vertexID * 2 + 0] * dpr;
+	v->m_Pos[1] = cmd->m_Pos[vertexID * 2 + 1] * dpr;
+
+#if VG_CONFIG_UV_INT16
+	v->m_UV[0] = bx::max<float>((float)cmd->m_UV[vertexID * 2 + 0] / 32767.0f, -1.0f);
+	v->m_UV[1] = bx::max<float>((float)cmd->m_UV[vertexID * 2 + 1] / 32767.0f, -1.0f);
+#else
+	v->m_UV[0] = cmd->m_UV[vertexID * 2 + 0];
+	v->m_UV[1] = cmd->m_UV[vertexID * 2 + 1];
+#endif
+
+	const uint8_t* c = (const uint8_t*)&cmd->m_Color[vertexID];
+	v->m_Color[0] = c[0] * (1.0f / 255.0f);
+	v->m_Color[1] = c[1] * (1.0f / 255.0f);
+	v->m_Color[2] = c[2] * (1.0f / 255.0f);
+	v->m_Color[3] = c[3] * (1.0f / 255.0f);
+}
+
+static void rasterizeDrawCommand(Rasterizer* rast, const RasterDrawCommand* cmd, const RasterPaint* paint, uint8_t stencilValue, uint8_t stencilTest, uint32_t y0, uint32_t y1)
+{
+	const float dpr = rast->m_DevicePixelRatio;
+
+	// Same conversion as bgfx::setScissor() in submitDrawCommands().
+	const uint16_t* scissor = cmd->m_ScissorRect;
+	const uint16_t sx = (uint16_t)(scissor[0] * dpr);
+	const uint16_t sy = (uint16_t)(scissor[1] * dpr);
+	const uint16_t sw = (uint16_t)(scissor[2] * dpr);
+	const uint16_t sh = (uint16_t)(scissor[3] * dpr);
+
+	int32_t rect[4] = {
+		(int32_t)sx,
+		bx::max<int32_t>((int32_t)sy, (int32_t)y0),
+		bx::min<int32_t>((int32_t)sx + (int32_t)sw, (int32_t)rast->m_Target.m_Width),
+		bx::min<int32_t>((int32_t)sy + (int32_t)sh, (int32_t)y1)
+	};
+	if (rect[0] >= rect[2] || rect[1] >= rect[3]) {
+		return;
+	}
+
+	const index_t* indices = cmd->m_Indices;
+	const uint32_t numIndices = cmd->m_NumIndices;
+	for (uint32_t i = 0; i + 2 < numIndices; i += 3) {
+		RasterVertex v[3];
+		rasterLoadVertex(cmd, indices[i + 0], dpr, &v[0]);
+		rasterLoadVertex(cmd, indices[i + 1], dpr, &v[1]);
+		rasterLoadVertex(cmd, indices[i + 2], dpr, &v[2]);
+		rasterizeTriangle(rast, v, paint, stencilValue, stencilTest, rect);
+	}
+}
+
+// Rasterizes a triangle into the pixels of rect ({ minx, miny, maxx, maxy }, exclusive max) whose centers
+// are inside it. Pixel centers exactly on an edge are assigned to only one of the triangles sharing that edge,
+// so the fringes of AA paths don't blend twice on the shared edges.
+static void rasterizeTriangle(Rasterizer* rast, const RasterVertex* vertices, const RasterPaint* paint, uint8_t stencilValue, uint8_t stencilTest, const int32_t* rect)
+{
+	const RasterVertex* v0 = &vertices[0];
+	const RasterVertex* v1 = &vertices[1];
+	const RasterVertex* v2 = &vertices[2];
+
+	float area = (v1->m_Pos[0] - v0->m_Pos[0]) * (v2->m_Pos[1] - v0->m_Pos[1]) - (v1->m_Pos[1] - v0->m_Pos[1]) * (v2->m_Pos[0] - v0->m_Pos[0]);
+	if (area == 0.0f) {
+		return;
+	} else if (area < 0.0f) {
+		bx::swap(v1, v2);
+		area = -area;
+	}
+
+	const int32_t minx = bx::max<int32_t>(rect[0], (int32_t)bx::floor(bx::min<float>(v0->m_Pos[0], bx::min<float>(v1->m_Pos[0], v2->m_Pos[0]))));
+	const int32_t miny = bx::max<int32_t>(rect[1], (int32_t)bx::floor(bx::min<float>(v0->m_Pos[1], bx::min<float>(v1->m_Pos[1], v2->m_Pos[1]))));
+	const int32_t maxx = bx::min<int32_t>(rect[2], (int32_t)bx::ceil(bx::max<float>(v0->m_Pos[0], bx::max<float>(v1->m_Pos[0], v2->m_Pos[0]))));
+	const int32_t maxy = bx::min<int32_t>(rect[3], (int32_t)bx::ceil(bx::max<float>(v0->m_Pos[1], bx::max<float>(v1->m_Pos[1], v2->m_Pos[1]))));
+	if (minx >= maxx || miny >= maxy) {
+		return;
+	}
+
+	// Edge functions w_i(x, y) = A_i * x + B_i * y + C_i, evaluated at pixel centers. w_i is the weight of
+	// the vertex opposite to edge i.
+	const RasterVertex* edges[3][2] = { { v1, v2 }, { v2, v0 }, { v0, v1 } };
+	float A[3], B[3], C[3];
+	bool inclusive[3];
+	for (uint32_t i = 0; i < 3; ++i) {
+		const float* a = edges[i][0]->m_Pos;
+		const float* b = edges[i][1]->m_Pos;
+		const float dx = b[0] - a[0];
+		const float dy = b[1] - a[1];
+		A[i] = -dy;
+		B[i] = dx;
+		C[i] = dy * a[0] - dx * a[1];
+		inclusive[i] = dy > 0.0f || (dy == 0.0f && dx < 0.0f);
+	}
+
+	const RasterTarget* target = &rast->m_Target;
+	const float invArea = 1.0f / area;
+	const float invDPR = 1.0f / rast->m_DevicePixelRatio;
+	const uint32_t width = target->m_Width;
+	uint8_t* stencil = rast->m_Stencil;
+	const bool isClip = paint->m_Type == RasterPaint::Type::Clip;
+#if VG_CONFIG_ENABLE_SIMD && BX_CPU_X86
+	const __m128 c0 = _mm_loadu_ps(v0->m_Color);
+	const __m128 c1 = _mm_loadu_ps(v1->m_Color);
+	const __m128 c2 = _mm_loadu_ps(v2->m_Color);
+#endif
+
+	for (int32_t y = miny; y < maxy; ++y) {
+		const float py = (float)y + 0.5f;
+		uint8_t* dstRow = target->m_Data + (uint32_t)y * target->m_Pitch;
+		uint8_t* stencilRow = &stencil[(uint32_t)y * width];
+
+		for (int32_t x = minx; x < maxx; x += 4) {
+			// Coverage of 4 pixels at a time.
+			float w[3][4];
+			uint32_t mask = 0x0F;
+#if VG_CONFIG_ENABLE_SIMD && BX_CPU_X86
+			const __m128 px = _mm_add_ps(_mm_set1_ps((float)x + 0.5f), _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f));
+			for (uint32_t i = 0; i < 3; ++i) {
+				const __m128 wi = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(A[i]), px), _mm_set1_ps(B[i] * py + C[i]));
+				const __m128 inside = inclusive[i] ? _mm_cmpge_ps(wi, _mm_setzero_ps()) : _mm_cmpgt_ps(wi, _mm_setzero_ps());
+				mask &= (uint32_t)_mm_movemask_ps(inside);
+				_mm_storeu_ps(w[i], wi);
+			}
+#else
+			for (uint32_t j = 0; j < 4; ++j) {
+				const float px = (float)(x + (int32_t)j) + 0.5f;
+				for (uint32_t i = 0; i < 3; ++i) {
+					w[i][j] = A[i] * px + B[i] * py + C[i];
+					const bool inside = inclusive[i] ? w[i][j] >= 0.0f : w[i][j] > 0.0f;
+					if (!inside) {
+						mask &= ~(1u << j);
+					}
+				}
+			}
+#endif
+			if (x + 4 > maxx) {
+				mask &= (1u << (maxx - x)) - 1;
+			}
+
+			for (uint32_t j = 0; mask != 0; ++j, mask >>= 1) {
+				if ((mask & 1) == 0) {
+					continue;
+				}
+
+				const uint32_t pixelX = (uint32_t)x + j;
+				uint8_t* s = &stencilRow[pixelX];
+				if (isClip) {
+					*s = stencilValue;
+					continue;
+				} else if (stencilTest == 1 && *s != stencilValue) {
+					continue;
+				} else if (stencilTest == 2 && *s == stencilValue) {
+					continue;
+				}
+
+				const float b0 = w[0][j] * invArea;
+				const float b1 = w[1][j] * invArea;
+				const float b2 = w[2][j] * invArea;
+
+				float uv[2], color[4];
+				for (uint32_t k = 0; k < 2; ++k) {
+					uv[k] = v0->m_UV[k] * b0 + v1->m_UV[k] * b1 + v2->m_UV[k] * b2;
+				}
+#if VG_CONFIG_ENABLE_SIMD && BX_CPU_X86
+				const __m128 c01 = _mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(b0)), _mm_mul_ps(c1, _mm_set1_ps(b1)));
+				_mm_storeu_ps(color, _mm_add_ps(c01, _mm_mul_ps(c2, _mm_set1_ps(b2))));
+#else
+				for (uint32_t k = 0; k < 4; ++k) {
+					color[k] = v0->m_Color[k] * b0 + v1->m_Color[k] * b1 + v2->m_Color[k] * b2;
+				}
+#endif
+
+				const float pos[2] = { ((float)pixelX + 0.5f) * invDPR, py * invDPR };
+
+				float src[4];
+				rasterShadePixel(paint, pos, uv, color, src);
+				rasterBlendPixel(&dstRow[pixelX * 4], src);
+			}
+		}
+	}
+}
+}
+#endif // VG_CONFIG_SOFTWARE_RASTERIZER
@@ -0,0 +1,82 @@
+#ifndef VG_RASTER_H
+#define VG_RASTER_H
+
+#include <vg/vg.h>
+
+#if VG_CONFIG_SOFTWARE_RASTERIZER
+namespace bx
+{
+struct AllocatorI;
+}
+
+namespace vg
+{
+struct Rasterizer;
+
+struct RasterImage
+{
+	const uint32_t* m_Data; // RGBA8 texels (nullptr => sampled as opaque white)
+	uint32_t m_Flags;       // BGFX_SAMPLER_XXX flags
+	uint16_t m_Width;
+	uint16_t m_Height;
+};
+
+struct RasterPaint
+{
+	struct Type
+	{
+		enum Enum : uint32_t
+		{
+			Textured = 0,  // Vertex color * image(UV)
+			ColorGradient, // Gradient(m_PaintMtx * pos) * vertex alpha
+			ImagePattern,  // Vertex color * image(m_PaintMtx * pos)
+			Clip,          // Writes the stencil value of the draw command which owns the clip command
+		};
+	};
+
+	Type::Enum m_Type;
+	RasterImage m_Image;          // Textured and ImagePattern
+	const float* m_PaintMtx;      // ColorGradient and ImagePattern (canvas to paint space, 3x3)
+	const float* m_GradientParams; // ColorGradient {Extent.x, Extent.y, Radius, Feather}
+	const float* m_InnerColor;    // ColorGradient
+	const float* m_OuterColor;    // ColorGradient
+};
+
+struct RasterDrawCommand
+{
+	struct StencilFlags
+	{
+		enum Enum : uint8_t
+		{
+			WriteClipMask = 1 << 0, // Render the clip commands into the stencil buffer before this command
+			Clear = 1 << 1,         // Reset the stencil buffer to 0 first
+		};
+	};
+
+	RasterPaint m_Paint;
+	const float* m_Pos;        // Canvas coordinates, 2 floats per vertex
+	const uv_t* m_UV;
+	const uint32_t* m_Color;   // RGBA8
+	const index_t* m_Indices;  // Triangle list, relative to the first vertex of the streams
+	uint32_t m_NumIndices;
+	uint16_t m_ScissorRect[4]; // Canvas coordinates
+	uint32_t m_FirstClipCmdID; // Clip commands of the clip state (their stencil values are ignored)
+	uint32_t m_NumClipCmds;
+	ClipRule::Enum m_ClipRule;
+	uint8_t m_StencilValue;    // Stencil reference value of the clip state (0 => no clip state)
+	uint8_t m_StencilFlags;    // StencilFlags::XXX
+};
+
+Rasterizer* createRasterizer(bx::AllocatorI* allocator);
+void destroyRasterizer(Rasterizer* rast);
+
+// Rasterizes into target using numThreads threads (including the one calling rasterizerDrawCommands()).
+void rasterizerSetTarget(Rasterizer* rast, const RasterTarget* target, uint32_t numThreads);
+
+// Blends the draw commands, in order, over the contents of the target. Consecutive commands with the same
+// m_FirstClipCmdID share the clip state of the first one.
+void rasterizerDrawCommands(Rasterizer* rast, const RasterDrawCommand* cmds, uint32_t numCmds, const RasterDrawCommand* clipCmds, float devicePixelRatio);
+}
+#endif // VG_CONFIG_SOFTWARE_RASTERIZER
+
+#endif
@@ -329,6 +329,16 @@ void genQuadIndices_unaligned(uint16_t* dst, uint32_t n, uint16_t firstVertexID)
 #endif
 }
 
+void genQuadIndices_unaligned(uint32_t* dst, uint32_t n, uint32_t firstVertexID)
+{
+	while (n-- > 0) {
+		dst[0] = firstVertexID; dst[1] = firstVertexID + 1; dst[2] = firstVertexID + 2;
+		dst[3] = firstVertexID; dst[4] = firstVertexID + 2; dst[5] = firstVertexID + 3;
+		dst += 6;
+		firstVertexID += 4;
+	}
+}
+
 void batchTransformTextQuads(const float* __restrict quads, uint32_t n, const float* __restrict mtx, float* __restrict transformedVertices)
 {
 #if VG_CONFIG_ENABLE_SIMD
@@ -519,6 +529,56 @@ void batchTransformDrawIndices(const uint16_t* __restrict src, uint32_t n, uint1
 #endif
 }
 
+void batchTransformDrawIndices(const uint16_t* __restrict src, uint32_t n, uint32_t* __restrict dst, uint32_t delta)
+{
+#if VG_CONFIG_ENABLE_SIMD && BX_CPU_X86
+	const __m128i xmm_zero = _mm_setzero_si128();
+	const __m128i xmm_delta = _mm_set1_epi32((int)delta);
+
+	const uint32_t iter8 = n >> 3;
+	for (uint32_t i = 0; i < iter8; ++i) {
+		const __m128i s = _mm_loadu_si128((const __m128i*)src);
+
+		const __m128i d0 = _mm_add_epi32(_mm_unpacklo_epi16(s, xmm_zero), xmm_delta);
+		const __m128i d1 = _mm_add_epi32(_mm_unpackhi_epi16(s, xmm_zero), xmm_delta);
+
+		_mm_storeu_si128((__m128i*)dst, d0);
+		_mm_storeu_si128((__m128i*)(dst + 4), d1);
+
+		src += 8;
+		dst += 8;
+	}
+
+	switch (n & 7) {
+	case 7: *dst++ = *src++ + delta;
+	case 6: *dst++ = *src++ + delta;
+	case 5: *dst++ = *src++ + delta;
+	case 4: *dst++ = *src++ + delta;
+	case 3: *dst++ = *src++ + delta;
+	case 2: *dst++ = *src++ + delta;
+	case 1: *dst = *src + delta;
+	}
+#else
+	for (uint32_t i = 0; i < n; ++i) {
+		*dst++ = *src + delta;
+		src++;
+	}
+#endif
+}
+
+void batchTransformDrawIndices(const uint32_t* __restrict src, uint32_t n, uint32_t* __restrict dst, uint32_t delta)
+{
+	if (delta == 0) {
+		bx::memCopy(dst, src, sizeof(uint32_t) * n);
+		return;
+	}
+
+	for (uint32_t i = 0; i < n; ++i) {
+		*dst++ = *src + delta;
+		src++;
+	}
+}
+
 void convertA8_to_RGBA8(uint32_t* rgba, const uint8_t* a8, uint32_t w, uint32_t h, uint32_t rgbColor)
 {
 	const uint32_t rgb0 = rgbColor & 0x00FFFFFF;